@@ -19,13 +19,98 @@
 #include <vector>
 #include <stdexcept>
 #include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
 
 #include "stb_image.h"
 #include "stb_image_write.h"
+#include "histogram.h"
+#include "window.h"
 
 
+/**
+ * @brief Enumerates the sample types an Image can hold.
+ */
+enum class PixelType {
+    UInt8,  /**< 8-bit unsigned samples, supported by every filter. */
+    UInt16, /**< 16-bit unsigned samples, e.g. CT slices stored as 16-bit PNG. */
+    Float32 /**< 32-bit float samples, e.g. Radiance HDR files (linear, nominally 0 to 1). */
+};
+
+/**
+ * @brief Maps a C++ sample type to its PixelType, a short name for kernel registries and its largest value.
+ * @tparam T unsigned char, uint16_t or float.
+ */
+template <typename T>
+struct PixelTraits;
+
+template <>
+struct PixelTraits<unsigned char> {
+    static constexpr PixelType type = PixelType::UInt8;
+    static constexpr const char* name = "u8";
+    static constexpr double max = 255.0;
+};
+
+template <>
+struct PixelTraits<uint16_t> {
+    static constexpr PixelType type = PixelType::UInt16;
+    static constexpr const char* name = "u16";
+    static constexpr double max = 65535.0;
+};
+
+template <>
+struct PixelTraits<float> {
+    static constexpr PixelType type = PixelType::Float32;
+    static constexpr const char* name = "f32";
+    static constexpr double max = std::numeric_limits<double>::infinity();
+};
+
+/**
+ * @brief Calls f with a value-initialised sample of the C++ type matching a PixelType, so generic code can be
+ * instantiated once per sample type and picked at run time.
+ * @param type The sample type.
+ * @param f A generic callable taking unsigned char, uint16_t or float.
+ * @return What f returns.
+ */
+template <typename F>
+auto visit_pixel_type(PixelType type, F&& f) {
+    switch (type) {
+        case PixelType::UInt16: return f(uint16_t{});
+        case PixelType::Float32: return f(float{});
+        case PixelType::UInt8: break;
+    }
+    return f(static_cast<unsigned char>(0));
+}
+
+/**
+ * @brief Options applied while an image or volume is decoded.
+ */
+struct LoadOptions {
+    int desiredChannels = 0;           /**< The desired number of channels in the loaded images (0 keeps the file's). */
+    std::optional<WindowLevel> window; /**< Maps the decoded samples to 8-bit and keeps only the 8-bit result. */
+    bool collapseGray = false;         /**< Stores RGB(A) images with equal colour channels as gray (if desiredChannels is 0). */
+    bool lazy = false;                 /**< Volumes only read headers and decode each slice when first accessed. */
+    size_t maxResident = 0;            /**< The decoded slices a lazy volume keeps, least recently used out (0: all, or Volume::COMPRESSED_RESIDENT if compressed). */
+    bool compressed = false;           /**< Volumes keep every slice compressed in memory and decode it on access (implies lazy); they cannot be loaded whole. */
+
+    /**
+     * @brief Gets the default options with a desired number of channels.
+     * @param desiredChannels The desired number of channels in the loaded images (0 keeps the file's).
+     * @return The options.
+     */
+    static LoadOptions with_channels(int desiredChannels) {
+        LoadOptions options;
+        options.desiredChannels = desiredChannels;
+        return options;
+    }
+};
+
 /**
  * @brief The Image class for loading, saving, and storing image data.
+ * @details The pixels are interleaved samples of pixel_type(); get_data() returns the raw bytes and pixels<T>()
+ * the typed samples. 16-bit PNGs load as PixelType::UInt16 and HDR files as PixelType::Float32.
  */
 class Image {
 public:
@@ -36,14 +121,24 @@ public:
      */
     Image(std::string const& fileName, int desiredChannels = 0);
 
+    /**
+     * @brief Constructs an Image object from the given file, applying load options while decoding.
+     * @details With a window, the decoded samples are mapped to 8-bit straight away and the decoded buffer is
+     * freed, so only the 8-bit result stays resident.
+     * @param fileName The name of the file to load the image from.
+     * @param options The decode options.
+     */
+    Image(std::string const& fileName, const LoadOptions& options);
+
     /**
      * @brief Constructs an Image object from the given data.
      * @param data The image data.
      * @param w The width of the image.
      * @param h The height of the image.
      * @param c The number of channels of the image.
+     * @param type The sample type of data (default is 8-bit).
      */
-    Image(unsigned char* data, int w, int h, int c);
+    Image(unsigned char* data, int w, int h, int c, PixelType type = PixelType::UInt8);
 
      /**
      * @brief Default constructor for Image object.
@@ -80,10 +175,60 @@ public:
     unsigned char* get_data() const;
 
     /**
-     * @brief Saves the image to the specified file.
+     * @brief Gets the image data as samples of type T, which must match pixel_type().
+     * @return Pointer to the first sample.
+     */
+    template <typename T>
+    T* pixels() const {
+        return reinterpret_cast<T*>(data);
+    }
+
+    /**
+     * @brief Gets the sample type of the image.
+     * @return The sample type.
+     */
+    PixelType pixel_type() const;
+
+    /**
+     * @brief Gets the size of one sample of the image.
+     * @return The bytes per sample.
+     */
+    int bytes_per_sample() const;
+
+    /**
+     * @brief Gets the size of one sample of a type.
+     * @param type The sample type.
+     * @return The bytes per sample.
+     */
+    static int bytes_per_sample(PixelType type);
+
+    /**
+     * @brief Converts the image to another sample type, rescaling the full range of one onto the other.
+     * @param type The sample type of the result.
+     * @return A new image with its own data.
+     */
+    Image converted(PixelType type) const;
+
+    /**
+     * @brief Replaces an RGB or RGBA image whose colour channels are equal in every pixel by one gray channel,
+     * keeping alpha as a second channel unless it is fully opaque.
+     * @return Whether the image was collapsed.
+     */
+    bool collapse_gray();
+
+    /**
+     * @brief Repeats the gray channel of a 1 or 2 channel image, the inverse of collapse_gray; a missing alpha
+     * channel is made fully opaque.
+     * @param channels The number of channels of the result, 2 to 4 (at least 4 for gray and alpha).
+     */
+    void expand_gray(int channels);
+
+    /**
+     * @brief Saves the image to the specified file; 16-bit and float images are written as 8-bit PNG.
      * @param fileName The name of the file to save the image to.
+     * @param report Whether to print where the image was saved (default is true).
      */
-    void save(std::string const& fileName);
+    void save(std::string const& fileName, bool report = true);
 
     /**
      * @brief Saves the image to the specified file (deprecated).
@@ -97,17 +242,47 @@ public:
      */
     void set_data(unsigned char* NewData);
 
+    /**
+     * @brief Sets the image data and its sample type.
+     * @param NewData The new image data.
+     * @param NewType The sample type of the new data.
+     */
+    void set_data(unsigned char* NewData, PixelType NewType);
+
     /**
      * @brief Sets the number of channels of the image.
      * @param NewChannels The new number of channels.
      */
     void set_channels(int NewChannels);
+
+    /**
+     * @brief Gets the intensity statistics of the image, computing them on first use.
+     * @details The result is cached and shared by shallow copies of the image until the data is replaced
+     * with set_data or invalidate_statistics is called, so chained operations do not rescan the pixels.
+     * 16-bit and float images are measured on their 8-bit conversion.
+     * @return The histogram, min, max and mean of the colour channels.
+     */
+    ImageStatistics statistics() const;
+
+    /**
+     * @brief Discards the cached statistics; must be called after the pixel data is modified in place.
+     */
+    void invalidate_statistics();
+
+    /**
+     * @brief Gets the revision of the pixel data, which goes up each time set_data or invalidate_statistics is
+     * called. Shallow copies share it until one of them replaces its data.
+     * @return The revision.
+     */
+    uint64_t revision() const;
     
 private:
     int w{}; /**< The width of the image. */
     int h{}; /**< The height of the image. */
     int c{}; /**< The number of channels of the image. */
     unsigned char* data; /**< The pointer to raw image data. */
+    PixelType type = PixelType::UInt8; /**< The sample type of data. */
+    std::shared_ptr<StatisticsCache> cache = std::make_shared<StatisticsCache>(); /**< The cached statistics of data. */
 };
 
 #endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_IMAGE_H
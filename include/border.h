@@ -0,0 +1,179 @@
+/**
+* @file border.h
+* @brief this header file contains the border-padded image and volume buffers used by the neighbourhood filters.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_BORDER_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_BORDER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Image.h"
+#include "scratch.h"
+#include "volume.h"
+
+/**
+ * @brief Enumerates the ways the guard border around a padded buffer is filled.
+ */
+enum class BorderMode {
+    Replicate, /**< Repeats the edge pixel (aaa|abcd|ddd), like clamping the coordinates. */
+    Mirror,    /**< Reflects about the edge pixel without repeating it (cb|abcd|cb). */
+    Constant   /**< Fills the border with a fixed value. */
+};
+
+/**
+ * @brief A copy of an image surrounded by a guard border of pixels on every side.
+ * @details A kernel of radius up to border can read any tap of any pixel without clamping its coordinates:
+ * row(y) points at pixel x = 0 of row y and is valid for x in [-border, width + border), and rows exist for
+ * y in [-border, height + border). The border is filled once per pass by fill_border instead of on every tap.
+ * The buffer is borrowed from the scratch arena, so the object can be moved but not copied.
+ */
+class BorderedImage {
+public:
+    /**
+     * @brief Allocates a buffer for a w x h image with c channels; the contents are undefined until assigned.
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param c The number of channels.
+     * @param border The width of the guard border in pixels.
+     */
+    BorderedImage(int w, int h, int c, int border);
+
+    /**
+     * @brief Copies an image into a new buffer and fills its border.
+     * @details Wider samples are treated as bytes_per_sample() byte channels, so channels() is the bytes per
+     * pixel; Replicate and Mirror copy whole pixels, while Constant fills every byte with value.
+     * @param img The image to copy.
+     * @param border The width of the guard border in pixels.
+     * @param mode How the border is filled.
+     * @param value The border value for BorderMode::Constant.
+     */
+    BorderedImage(const Image& img, int border, BorderMode mode, unsigned char value = 0);
+
+    /**
+     * @brief Copies new pixels into the interior and refills the border.
+     * @param src The w x h x c interleaved pixels.
+     * @param mode How the border is filled.
+     * @param value The border value for BorderMode::Constant.
+     */
+    void assign(const unsigned char* src, BorderMode mode, unsigned char value = 0);
+
+    /**
+     * @brief Copies the whole padded buffer of another image of the same size, border included.
+     * @param other The image to copy.
+     */
+    void assign(const BorderedImage& other);
+
+    /**
+     * @brief Refills the border from the current interior, e.g. after the interior was modified in place.
+     * @param mode How the border is filled.
+     * @param value The border value for BorderMode::Constant.
+     */
+    void fill_border(BorderMode mode, unsigned char value = 0);
+
+    int width() const;
+    int height() const;
+    int channels() const;
+    int border() const;
+
+    /**
+     * @brief Gets the distance in bytes between two padded rows.
+     * @return The row stride.
+     */
+    size_t stride() const;
+
+    /**
+     * @brief Gets pixel x = 0 of a row.
+     * @param y The row, in [-border, height + border).
+     * @return A pointer that may be indexed from -border * channels to (width + border) * channels.
+     */
+    const unsigned char* row(int y) const;
+
+    /**
+     * @brief Gets pixel x = 0 of a row.
+     * @param y The row, in [-border, height + border).
+     * @return A pointer that may be indexed from -border * channels to (width + border) * channels.
+     */
+    unsigned char* row(int y);
+
+    /**
+     * @brief Maps a coordinate outside [0, n) to the interior coordinate the border copies.
+     * @param i The coordinate.
+     * @param n The size of the dimension.
+     * @param mode The border mode.
+     * @return The interior coordinate, or -1 for BorderMode::Constant outside the interior.
+     */
+    static int source_index(int i, int n, BorderMode mode);
+
+private:
+    int w;                              /**< The width of the image. */
+    int h;                              /**< The height of the image. */
+    int c;                              /**< The number of channels. */
+    int b;                              /**< The width of the border. */
+    size_t rowStride;                   /**< The bytes per padded row. */
+    ScratchBuffer<unsigned char> buffer; /**< The padded pixels, row-major. */
+};
+
+/**
+ * @brief A copy of a volume whose slices are padded in x and y, with optional padding slices in z.
+ * @details slice(z) is valid for z in [-borderZ, depth + borderZ). Padding slices are whole copies of the
+ * interior slice the border mode maps them to (or constant slices), borders included.
+ */
+class BorderedVolume {
+public:
+    /**
+     * @brief Copies a volume and fills its borders.
+     * @param vol The volume to copy; all slices must have the same size and channels.
+     * @param border The width of the guard border of each slice in pixels.
+     * @param borderZ The number of padding slices before the first and after the last slice.
+     * @param mode How the borders are filled.
+     * @param value The border value for BorderMode::Constant.
+     */
+    BorderedVolume(const Volume& vol, int border, int borderZ, BorderMode mode, unsigned char value = 0);
+
+    /**
+     * @brief Refills the borders of every slice and the padding slices from the current interior.
+     * @param mode How the borders are filled.
+     * @param value The border value for BorderMode::Constant.
+     */
+    void fill_border(BorderMode mode, unsigned char value = 0);
+
+    int depth() const;
+    int borderZ() const;
+
+    /**
+     * @brief Gets a slice.
+     * @param z The slice, in [-borderZ, depth + borderZ).
+     * @return The padded slice.
+     */
+    const BorderedImage& slice(int z) const;
+
+    /**
+     * @brief Gets a slice.
+     * @param z The slice, in [-borderZ, depth + borderZ).
+     * @return The padded slice.
+     */
+    BorderedImage& slice(int z);
+
+private:
+    int d;                             /**< The number of interior slices. */
+    int bz;                            /**< The number of padding slices on each side. */
+    std::vector<BorderedImage> slices; /**< The padded slices, padding slices included. */
+
+    /**
+     * @brief Copies the padding slices from the interior slices they map to, or fills them with value.
+     * @param mode How the padding slices are filled.
+     * @param value The fill value for BorderMode::Constant.
+     */
+    void fill_padding_slices(BorderMode mode, unsigned char value);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_BORDER_H
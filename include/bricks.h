@@ -0,0 +1,143 @@
+/**
+* @file bricks.h
+* @brief this header file contains the grid of per-brick min, max and mean summaries of a volume.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_BRICKS_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_BRICKS_H
+
+#include <cstdint>
+#include <vector>
+
+class Volume;
+
+/**
+ * @brief The summary of the samples of one brick, in the sample units of the volume.
+ */
+struct Brick {
+    double min = 0.0;  /**< The smallest sample. */
+    double max = 0.0;  /**< The largest sample. */
+    double mean = 0.0; /**< The mean of the samples. */
+};
+
+/**
+ * @brief The BrickGrid class splits a volume into cubes of size^3 voxels and records the min, max and mean of
+ * the samples of each, over every channel.
+ * @details The grid lets a pass skip whole bricks that cannot affect its result: a threshold need not visit a
+ * brick entirely below or above it, and a maximum projection need not read a brick whose max is below what it
+ * has already found. The grid keeps the revision of every slice it summarised, so update() only rescans the
+ * layers of bricks holding slices that were modified since.
+ */
+class BrickGrid {
+public:
+    static constexpr int BRICK = 16; /**< The default edge of a brick, in voxels. */
+
+    BrickGrid() = default;
+
+    /**
+     * @brief Summarises a volume, in parallel over bricks.
+     * @param vol The volume; a lazy one is streamed one layer of bricks at a time.
+     * @param size The edge of a brick, in voxels.
+     * @throws std::invalid_argument if size is not positive.
+     */
+    explicit BrickGrid(const Volume& vol, int size = BRICK);
+
+    /**
+     * @brief Brings the grid up to date with a volume it was built from.
+     * @details The revision of each slice is compared to the one summarised; only the layers of bricks with a
+     * changed slice are rescanned. If the size of the volume changed, the grid is rebuilt. The slices of a lazy
+     * volume are reloaded from disk when evicted, so they are not checked.
+     * @param vol The volume.
+     * @return The number of layers of bricks rescanned.
+     */
+    int update(const Volume& vol);
+
+    /**
+     * @brief Gets the edge of a brick.
+     * @return The edge, in voxels.
+     */
+    int brick_size() const;
+
+    /**
+     * @brief Gets the number of bricks along x.
+     * @return The number of bricks.
+     */
+    int bricks_x() const;
+
+    /**
+     * @brief Gets the number of bricks along y.
+     * @return The number of bricks.
+     */
+    int bricks_y() const;
+
+    /**
+     * @brief Gets the number of bricks along z.
+     * @return The number of bricks.
+     */
+    int bricks_z() const;
+
+    /**
+     * @brief Gets the summary of one brick.
+     * @param bx The brick along x.
+     * @param by The brick along y.
+     * @param bz The brick along z.
+     * @return The summary.
+     */
+    const Brick& operator()(int bx, int by, int bz) const;
+
+    /**
+     * @brief Gets the smallest and largest samples of the bricks covering a box of voxels.
+     * @details The bounds are conservative: every sample of the box lies within them.
+     * @param x0 The first column.
+     * @param x1 One past the last column.
+     * @param y0 The first row.
+     * @param y1 One past the last row.
+     * @param z0 The first slice.
+     * @param z1 One past the last slice.
+     * @return The min and max over the covering bricks, as a Brick with no mean.
+     */
+    Brick bounds(int x0, int x1, int y0, int y1, int z0, int z1) const;
+
+    /**
+     * @brief Whether every sample of a brick is below a threshold.
+     * @param bx The brick along x.
+     * @param by The brick along y.
+     * @param bz The brick along z.
+     * @param threshold The threshold.
+     * @return true if the max of the brick is below threshold.
+     */
+    bool below(int bx, int by, int bz, double threshold) const;
+
+    /**
+     * @brief Whether every sample of a brick is at or above a threshold.
+     * @param bx The brick along x.
+     * @param by The brick along y.
+     * @param bz The brick along z.
+     * @param threshold The threshold.
+     * @return true if the min of the brick is at least threshold.
+     */
+    bool above(int bx, int by, int bz, double threshold) const;
+
+private:
+    int size = BRICK;                 /**< The edge of a brick. */
+    int w = 0, h = 0, d = 0;          /**< The size of the volume summarised. */
+    int nx = 0, ny = 0, nz = 0;       /**< The number of bricks along each axis. */
+    std::vector<Brick> bricks;        /**< The summaries, x fastest. */
+    std::vector<uint64_t> revisions;  /**< The revision of each slice when it was summarised. */
+
+    /**
+     * @brief Summarises the flagged layers of bricks, in parallel over their bricks.
+     * @param vol The volume.
+     * @param layers The layers to rescan, flagged by bz.
+     */
+    void scan(const Volume& vol, const std::vector<bool>& layers);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_BRICKS_H
@@ -0,0 +1,96 @@
+/**
+* @file canny.h
+* @brief this header file contains the declarations of the tiled, multithreaded Canny edge detector.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_CANNY_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_CANNY_H
+
+#include <cstdint>
+#include <vector>
+#include "gradient.h"
+
+/**
+ * @brief The Canny class produces thin, connected edges from a single channel image.
+ * @details The detector runs four stages: Gaussian smoothing, gradient with direction, non-maximum
+ * suppression and double-threshold hysteresis. The image is split into horizontal bands that are
+ * processed in parallel; gradients and magnitudes only ever exist for the band being processed.
+ */
+class Canny {
+public:
+    /**
+     * @brief Runs the Canny edge detector.
+     * @param src The source pixels (w * h bytes).
+     * @param dst The destination edge map (w * h bytes, 255 for edges and 0 otherwise), must not alias src.
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param lowThreshold The lower hysteresis threshold on the gradient magnitude.
+     * @param highThreshold The upper hysteresis threshold on the gradient magnitude.
+     * @param sigma The standard deviation of the smoothing Gaussian (0 disables smoothing).
+     * @param kernelSize The size of the smoothing kernel, must be odd.
+     * @param op The gradient operator (default is Sobel).
+     */
+    static void detect(const unsigned char* src, unsigned char* dst, int w, int h,
+                       int lowThreshold, int highThreshold, double sigma, int kernelSize,
+                       GradientOperator op = GradientOperator::Sobel);
+
+private:
+    static constexpr unsigned char NONE = 0;   /**< Label of a suppressed pixel. */
+    static constexpr unsigned char WEAK = 1;   /**< Label of a pixel between the two thresholds. */
+    static constexpr unsigned char STRONG = 2; /**< Label of a pixel above the high threshold or connected to one. */
+
+    /**
+     * @brief Smooths the rows [y0, y1) with a fixed-point separable Gaussian.
+     * @param src The source pixels (w * h bytes).
+     * @param dst The destination pixels (w * h bytes).
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param y0 The first row to smooth.
+     * @param y1 One past the last row to smooth.
+     * @param kernel The fixed-point kernel weights, summing to 1 << 14.
+     */
+    static void smooth_rows(const unsigned char* src, unsigned char* dst, int w, int h, int y0, int y1,
+                            const std::vector<int>& kernel);
+
+    /**
+     * @brief Computes the gradient and labels the rows [y0, y1) after non-maximum suppression.
+     * @param src The smoothed pixels (w * h bytes).
+     * @param labels The label map (w * h bytes).
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param y0 The first row to label.
+     * @param y1 One past the last row to label.
+     * @param low2 The squared lower threshold.
+     * @param high2 The squared upper threshold.
+     * @param op The gradient operator.
+     */
+    static void suppress_rows(const unsigned char* src, unsigned char* labels, int w, int h, int y0, int y1,
+                              int64_t low2, int64_t high2, GradientOperator op);
+
+    /**
+     * @brief Promotes weak pixels connected to strong pixels, band by band, until no band boundary changes.
+     * @param labels The label map (w * h bytes).
+     * @param w The width of the image.
+     * @param h The height of the image.
+     */
+    static void hysteresis(unsigned char* labels, int w, int h);
+
+    /**
+     * @brief Floods from the given seeds through weak pixels without leaving the rows [y0, y1).
+     * @param labels The label map (w * h bytes).
+     * @param w The width of the image.
+     * @param y0 The first row of the band.
+     * @param y1 One past the last row of the band.
+     * @param stack The seed pixel indices, consumed by the flood.
+     */
+    static void flood_band(unsigned char* labels, int w, int y0, int y1, std::vector<int64_t>& stack);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_CANNY_H
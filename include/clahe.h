@@ -0,0 +1,87 @@
+/**
+* @file clahe.h
+* @brief this header file contains the declarations of the tiled contrast limited adaptive histogram equalisation (CLAHE) in 2D and 3D.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_CLAHE_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_CLAHE_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief The Clahe class equalises the contrast of images and volumes tile by tile.
+ * @details The data is split into a grid of tiles (2D) or blocks (3D). Each tile gets a histogram whose bins
+ * are clipped at a multiple of the mean bin height, with the excess spread over all bins, and an equalising
+ * LUT built from it. Every pixel is then mapped through the LUTs of the tiles around it, blended bilinearly
+ * (trilinearly in 3D) by its distance to their centres. The per-pixel blend only reads precomputed tile
+ * offsets and weights, so the inner loops are plain table lookups and arithmetic.
+ */
+class Clahe {
+public:
+    /**
+     * @brief Applies CLAHE to one channel of an image in place.
+     * @param data The first sample of the channel.
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param stride The distance between consecutive samples of the channel (the number of channels).
+     * @param tilesX The number of tiles across.
+     * @param tilesY The number of tiles down.
+     * @param clipLimit The clip limit as a multiple of the mean bin height (0 disables clipping).
+     */
+    static void equalize(unsigned char* data, int w, int h, int stride, int tilesX, int tilesY, double clipLimit);
+
+    /**
+     * @brief Applies CLAHE to one channel of a volume in place.
+     * @details Each slice is read once while the block histograms are built: a slice only adds to the
+     * histograms of its own z block, so overlapping blocks are never histogrammed twice.
+     * @param slices The first sample of the channel in every slice.
+     * @param w The width of the slices.
+     * @param h The height of the slices.
+     * @param stride The distance between consecutive samples of the channel (the number of channels).
+     * @param tilesX The number of blocks across.
+     * @param tilesY The number of blocks down.
+     * @param tilesZ The number of blocks through the slices.
+     * @param clipLimit The clip limit as a multiple of the mean bin height (0 disables clipping).
+     */
+    static void equalize_volume(const std::vector<unsigned char*>& slices, int w, int h, int stride,
+                                int tilesX, int tilesY, int tilesZ, double clipLimit);
+
+private:
+    /**
+     * @brief Precomputed interpolation of one axis: the two neighbouring tiles of each coordinate and the weight of the second.
+     */
+    struct Axis {
+        int size = 0;            /**< The size of a tile along the axis. */
+        int tiles = 0;           /**< The number of tiles along the axis. */
+        std::vector<int> lo;     /**< The index of the tile centre at or before each coordinate. */
+        std::vector<int> hi;     /**< The index of the tile centre after each coordinate. */
+        std::vector<float> weight; /**< The weight of hi for each coordinate. */
+    };
+
+    /**
+     * @brief Splits an axis into tiles and precomputes its interpolation.
+     * @param length The length of the axis.
+     * @param tiles The requested number of tiles.
+     * @return The tiling of the axis.
+     */
+    static Axis axis(int length, int tiles);
+
+    /**
+     * @brief Clips a histogram, redistributes the excess and builds the equalising LUT.
+     * @param hist The 256 bin histogram, clipped in place.
+     * @param count The number of samples in the histogram.
+     * @param clipLimit The clip limit as a multiple of the mean bin height (0 disables clipping).
+     * @param lut The 256 entry LUT to fill.
+     */
+    static void build_lut(uint32_t* hist, uint64_t count, double clipLimit, unsigned char* lut);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_CLAHE_H
@@ -0,0 +1,121 @@
+/**
+* @file colorspace.h
+* @brief this header file contains the declarations of the branch-free colour space conversion kernels (Gray, HSV, HSL).
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_COLORSPACE_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_COLORSPACE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Enumerates the cylindrical colour models, numbered like the transform argument of the filters.
+ */
+enum class ColorModel {
+    HSV = 1,
+    HSL = 2
+};
+
+/**
+ * @brief The ColorSpace class contains vectorisable kernels that convert runs of interleaved pixels.
+ * @details Each kernel works on a contiguous run of n pixels with 3 or 4 channels (alpha is left untouched),
+ * so callers can split an image into rows and convert them in parallel. Pixels are processed in small blocks
+ * that are first split into planar float arrays; the maths on those arrays uses selects instead of branches
+ * so the compiler can evaluate several pixels per instruction. The arithmetic reproduces the original
+ * per-pixel implementations operation for operation, so the 8-bit output is identical.
+ */
+class ColorSpace {
+public:
+    /**
+     * @brief Converts n RGB(A) pixels to 8-bit luma with fixed-point Rec. 709 weights.
+     * @param src The interleaved source pixels.
+     * @param dst The destination gray pixels (n bytes).
+     * @param n The number of pixels.
+     * @param channels The number of channels of the source (3 or 4).
+     */
+    static void rgb_to_gray(const unsigned char* src, unsigned char* dst, size_t n, int channels);
+
+    /**
+     * @brief Converts n RGB(A) pixels to HSV in place.
+     * @param data The interleaved pixels.
+     * @param n The number of pixels.
+     * @param channels The number of channels (3 or 4).
+     */
+    static void rgb_to_hsv(unsigned char* data, size_t n, int channels);
+
+    /**
+     * @brief Converts n HSV(A) pixels to RGB in place.
+     * @param data The interleaved pixels.
+     * @param n The number of pixels.
+     * @param channels The number of channels (3 or 4).
+     */
+    static void hsv_to_rgb(unsigned char* data, size_t n, int channels);
+
+    /**
+     * @brief Converts n RGB(A) pixels to HSL in place.
+     * @param data The interleaved pixels.
+     * @param n The number of pixels.
+     * @param channels The number of channels (3 or 4).
+     */
+    static void rgb_to_hsl(unsigned char* data, size_t n, int channels);
+
+    /**
+     * @brief Converts n HSL(A) pixels to RGB in place.
+     * @param data The interleaved pixels.
+     * @param n The number of pixels.
+     * @param channels The number of channels (3 or 4).
+     */
+    static void hsl_to_rgb(unsigned char* data, size_t n, int channels);
+
+    /**
+     * @brief Adds the V (HSV) or L (HSL) byte of n RGB(A) pixels to a histogram, without converting them.
+     * @param data The interleaved pixels.
+     * @param n The number of pixels.
+     * @param channels The number of channels (3 or 4).
+     * @param model Which of V or L to histogram.
+     * @param hist The 256 bin histogram to add to.
+     */
+    static void value_histogram(const unsigned char* data, size_t n, int channels, ColorModel model, uint64_t* hist);
+
+    /**
+     * @brief Maps the V (HSV) or L (HSL) channel of n RGB(A) pixels through a LUT in a single pass.
+     * @details The result is identical to converting to the model, remapping the channel and converting back.
+     * @param data The interleaved pixels.
+     * @param n The number of pixels.
+     * @param channels The number of channels (3 or 4).
+     * @param model The colour model whose third channel is remapped.
+     * @param lut The 256 entry mapping.
+     */
+    static void remap_value(unsigned char* data, size_t n, int channels, ColorModel model, const unsigned char* lut);
+
+    /**
+     * @brief Extracts the V (HSV) or L (HSL) byte of n RGB(A) pixels, without converting them.
+     * @param src The interleaved pixels.
+     * @param dst The single channel output (n bytes).
+     * @param n The number of pixels.
+     * @param channels The number of channels (3 or 4).
+     * @param model Which of V or L to extract.
+     */
+    static void value_plane(const unsigned char* src, unsigned char* dst, size_t n, int channels, ColorModel model);
+
+    /**
+     * @brief Binarises n RGB(A) pixels on their V (HSV) or L (HSL) byte.
+     * @param src The interleaved pixels.
+     * @param dst The single channel output (n bytes), 255 where the value is above the threshold and 0 otherwise.
+     * @param n The number of pixels.
+     * @param channels The number of channels (3 or 4).
+     * @param model Which of V or L to threshold.
+     * @param threshold The threshold value.
+     */
+    static void value_threshold(const unsigned char* src, unsigned char* dst, size_t n, int channels, ColorModel model, int threshold);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_COLORSPACE_H
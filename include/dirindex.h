@@ -0,0 +1,117 @@
+/**
+* @file dirindex.h
+* @brief this header file contains the sorted, cached index of the image files in a volume directory.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_DIRINDEX_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_DIRINDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief One file of a directory index, with the header fields read from it.
+ */
+struct IndexEntry {
+    std::filesystem::path path; /**< The full path of the file. */
+    std::string name;           /**< The file name, the sort key. */
+    uintmax_t size = 0;         /**< The size of the file in bytes. */
+    int64_t mtime = 0;          /**< The last modification time of the file, in file clock ticks. */
+    bool image = false;         /**< Whether stb recognised the header; the fields below are only valid if so. */
+    int width = 0;              /**< The width of the image. */
+    int height = 0;             /**< The height of the image. */
+    int channels = 0;           /**< The channels stored in the file. */
+    bool is16Bit = false;       /**< Whether the file holds 16-bit samples. */
+    bool isHdr = false;         /**< Whether the file holds float samples. */
+};
+
+/**
+ * @brief The DirectoryIndex class lists the regular files of a directory once, in natural order, with a
+ * manifest of their sizes, modification times and image headers.
+ * @details Indexes are cached per directory for the life of the process, so the interactive flow, the whole
+ * volume and any slab of it share one listing. A cached index is reused while the modification time of the
+ * directory is unchanged and every file still has the size and modification time recorded in the manifest;
+ * otherwise the directory is listed again, and headers are only re-read for files that changed.
+ */
+class DirectoryIndex {
+public:
+    /**
+     * @brief Gets the index of a directory, from the cache when it is still valid.
+     * @param directoryPath The directory.
+     * @return The index, shared with other users of the same directory.
+     * @throws std::filesystem::filesystem_error if the directory cannot be listed.
+     */
+    static std::shared_ptr<const DirectoryIndex> open(const std::string& directoryPath);
+
+    /**
+     * @brief Drops every cached index.
+     */
+    static void clear_cache();
+
+    /**
+     * @brief Compares two names in natural order: runs of digits compare by numeric value, so "slice2" sorts
+     * before "slice10"; other characters compare by byte. Numbers equal in value sort by their leading zeros.
+     * @param a The first name.
+     * @param b The second name.
+     * @return Whether a sorts before b.
+     */
+    static bool natural_less(std::string_view a, std::string_view b);
+
+    /**
+     * @brief Gets the number of files.
+     * @return The number of files.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Gets a file.
+     * @param i The position of the file in natural order.
+     * @return The entry.
+     */
+    const IndexEntry& operator[](size_t i) const;
+
+    /**
+     * @brief Gets all the files.
+     * @return The entries in natural order.
+     */
+    const std::vector<IndexEntry>& entries() const;
+
+    /**
+     * @brief Gets the directory the index lists.
+     * @return The directory.
+     */
+    const std::filesystem::path& directory() const;
+
+private:
+    std::filesystem::path dir;       /**< The directory. */
+    int64_t dirMtime = 0;            /**< The modification time of the directory when it was listed. */
+    std::vector<IndexEntry> files;   /**< The files in natural order. */
+
+    /**
+     * @brief Lists a directory, reusing the headers of unchanged files from a previous index.
+     * @param directory The directory.
+     * @param previous The previous index of the directory, or nullptr.
+     * @return The new index.
+     */
+    static std::shared_ptr<const DirectoryIndex> build(const std::filesystem::path& directory,
+                                                       const DirectoryIndex* previous);
+
+    /**
+     * @brief Checks that the directory and every file still match the manifest.
+     * @return Whether the index can be reused.
+     */
+    bool current() const;
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_DIRINDEX_H
@@ -0,0 +1,169 @@
+/**
+* @file dispatch.h
+* @brief this header file contains the runtime CPU feature detection and the registry that binds each hot kernel to its best variant.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_DISPATCH_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_DISPATCH_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Enumerates the instruction set levels a kernel can be compiled for, from the portable baseline upwards.
+ */
+enum class CpuLevel {
+    Scalar = 0, /**< Plain scalar code, the reference every other variant must match. */
+    SSE42 = 1,  /**< SSE4.2 (with POPCNT). */
+    AVX2 = 2,   /**< AVX2 (with BMI1/BMI2). */
+    AVX512 = 3  /**< AVX-512 F/BW/VL/DQ. */
+};
+
+/**
+ * @brief Forces a kernel body to be inlined into each variant, so every copy is compiled for that variant's target.
+ */
+#if defined(__GNUC__)
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE inline
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISPATCH_X86 1
+#if defined(__clang__)
+#define DISPATCH_SCALAR_ATTR
+#define DISPATCH_TARGET(isa) __attribute__((target(isa)))
+#else
+// Contraction is disabled so that FMA-capable targets round exactly like the scalar reference
+#define DISPATCH_SCALAR_ATTR __attribute__((optimize("no-tree-vectorize", "fp-contract=off")))
+#define DISPATCH_TARGET(isa) __attribute__((target(isa), optimize("fp-contract=off")))
+#endif
+#else
+#define DISPATCH_X86 0
+#endif
+
+/**
+ * @brief The four compiled variants of one kernel.
+ * @tparam Fn The function pointer type of the kernel.
+ */
+template <typename Fn>
+struct KernelSet {
+    Fn variants[4]; /**< The variants, indexed by CpuLevel. */
+};
+
+namespace KernelVariant {
+
+/**
+ * @brief The scalar reference variant: the kernel body with auto-vectorisation turned off.
+ */
+template <auto Impl, typename... Args>
+#if DISPATCH_X86
+DISPATCH_SCALAR_ATTR
+#endif
+void scalar(Args... args) {
+    Impl(args...);
+}
+
+#if DISPATCH_X86
+template <auto Impl, typename... Args>
+DISPATCH_TARGET("sse4.2,popcnt") void sse42(Args... args) {
+    Impl(args...);
+}
+
+template <auto Impl, typename... Args>
+DISPATCH_TARGET("avx2,bmi,bmi2") void avx2(Args... args) {
+    Impl(args...);
+}
+
+template <auto Impl, typename... Args>
+DISPATCH_TARGET("avx512f,avx512bw,avx512vl,avx512dq") void avx512(Args... args) {
+    Impl(args...);
+}
+#endif
+
+template <auto Impl, typename... Args>
+constexpr KernelSet<void (*)(Args...)> make(void (*)(Args...)) {
+#if DISPATCH_X86
+    return {{&scalar<Impl, Args...>, &sse42<Impl, Args...>, &avx2<Impl, Args...>, &avx512<Impl, Args...>}};
+#else
+    return {{&scalar<Impl, Args...>, &scalar<Impl, Args...>, &scalar<Impl, Args...>, &scalar<Impl, Args...>}};
+#endif
+}
+
+} // namespace KernelVariant
+
+/**
+ * @brief Compiles a kernel body (a KERNEL_INLINE function returning void) once per CpuLevel.
+ * @tparam Impl The kernel body.
+ * @return The set of variants, ready to be bound with Dispatch::bind().
+ */
+template <auto Impl>
+constexpr auto kernel_set() {
+    return KernelVariant::make<Impl>(Impl);
+}
+
+/**
+ * @brief The Dispatch class detects the CPU once and binds kernels to the variant for the active level.
+ * @details The active level is the best level the CPU supports, lowered by the IMAGE_CPU_LEVEL environment
+ * variable (scalar, sse4.2, avx2 or avx512) when it is set, so every path can be exercised on one machine.
+ * A request above what the CPU supports is clamped to the detected level. Kernels are bound once, typically
+ * into a function-local static, and every binding is recorded in a registry that can be listed.
+ */
+class Dispatch {
+public:
+    /**
+     * @brief Gets the best level supported by this CPU.
+     * @return The detected level.
+     */
+    static CpuLevel detected();
+
+    /**
+     * @brief Gets the level kernels are bound to, after the environment override.
+     * @return The active level.
+     */
+    static CpuLevel level();
+
+    /**
+     * @brief Gets the printable name of a level, as accepted by IMAGE_CPU_LEVEL.
+     * @param level The level.
+     * @return The name of the level.
+     */
+    static const char* name(CpuLevel level);
+
+    /**
+     * @brief Picks the variant of a kernel for the active level and records the binding.
+     * @param kernel The name of the kernel, for the registry.
+     * @param set The variants of the kernel.
+     * @return The variant to call.
+     */
+    template <typename Fn>
+    static Fn bind(const std::string& kernel, const KernelSet<Fn>& set) {
+        CpuLevel active = level();
+        record(kernel, active);
+        return set.variants[static_cast<int>(active)];
+    }
+
+    /**
+     * @brief Lists the kernels bound so far and the level each was bound to.
+     * @return The (kernel name, level) pairs in binding order.
+     */
+    static std::vector<std::pair<std::string, CpuLevel>> bound();
+
+private:
+    /**
+     * @brief Adds a binding to the registry.
+     * @param kernel The name of the kernel.
+     * @param level The level it was bound to.
+     */
+    static void record(const std::string& kernel, CpuLevel level);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_DISPATCH_H
@@ -22,6 +22,10 @@
 #include <unordered_set>
 #include "Image.h"
 #include "volume.h"
+#include "sparse.h"
+#include "gradient.h"
+#include "threshold.h"
+#include "clahe.h"
 
 
 /**
@@ -100,6 +104,15 @@ public:
      */
     static void HistogramEqualization(Image& img, int transform); //applies histogram equalization to the image
 
+    /**
+     * @brief Applies contrast limited adaptive histogram equalization (CLAHE) to the image.
+     * @param img The image to equalize.
+     * @param tiles The number of tiles along each axis (default is 8).
+     * @param clipLimit The clip limit as a multiple of the mean bin height (default is 2, 0 disables clipping).
+     * @param transform The type of transformation to apply (1 equalizes V of HSV, 2 equalizes L of HSL).
+     */
+    static void clahe(Image& img, int tiles = 8, double clipLimit = 2.0, int transform = 1); //applies CLAHE to the image
+
     /**
      * @brief Applies thresholding to the image.
      * @param img The image to threshold.
@@ -108,6 +121,25 @@ public:
      */
     static void Tresholding(Image& img, int threshold, int transform); //applies thresholding to the image
 
+    /**
+     * @brief Applies thresholding with a threshold picked automatically from the histogram.
+     * @param img The image to threshold.
+     * @param method The global threshold method (Otsu or triangle).
+     * @param transform The type of transformation to apply (1 thresholds V of HSV, 2 thresholds L of HSL).
+     * @return The threshold that was applied.
+     */
+    static int automatic_thresholding(Image& img, GlobalThreshold method, int transform); //applies otsu or triangle thresholding
+
+    /**
+     * @brief Applies local adaptive thresholding, comparing each pixel with the statistics of its neighbourhood.
+     * @param img The image to threshold.
+     * @param method The adaptive threshold method (Bradley or Sauvola).
+     * @param windowSize The side of the neighbourhood window.
+     * @param k The sensitivity of the method.
+     * @param transform The type of transformation to apply (1 thresholds V of HSV, 2 thresholds L of HSL).
+     */
+    static void adaptive_thresholding(Image& img, AdaptiveThreshold method, int windowSize, double k, int transform); //applies bradley or sauvola thresholding
+
     /**
      * @brief Adds salt and pepper noise to the image.
      * @param img The image to add noise to.
@@ -118,20 +150,33 @@ public:
     /**
      * @brief Applies Sobel edge detection to the image.
      * @param img The image to apply edge detection to.
+     * @param mode The gradient magnitude mode (default is exact L2).
      */
-    static void apply_sobel_edge_detection(Image& img); //applies sobel edge detection to the image
+    static void apply_sobel_edge_detection(Image& img, GradientMagnitude mode = GradientMagnitude::L2); //applies sobel edge detection to the image
 
     /**
      * @brief Applies Prewitt edge detection to the image.
      * @param img The image to apply edge detection to.
+     * @param mode The gradient magnitude mode (default is exact L2).
      */
-    static void apply_prewitt_edge_detection(Image& img); //applies prewitt edge detection to the image
+    static void apply_prewitt_edge_detection(Image& img, GradientMagnitude mode = GradientMagnitude::L2); //applies prewitt edge detection to the image
 
     /**
      * @brief Applies Scharr edge detection to the image.
      * @param img The image to apply edge detection to.
+     * @param mode The gradient magnitude mode (default is exact L2).
      */
-    static void apply_scharr_edge_detection(Image& img); //applies scharr edge detection to the image
+    static void apply_scharr_edge_detection(Image& img, GradientMagnitude mode = GradientMagnitude::L2); //applies scharr edge detection to the image
+
+    /**
+     * @brief Applies Canny edge detection to the image, producing thin binary edges.
+     * @param img The image to apply edge detection to.
+     * @param lowThreshold The lower hysteresis threshold on the Sobel gradient magnitude.
+     * @param highThreshold The upper hysteresis threshold on the Sobel gradient magnitude.
+     * @param sigma The standard deviation of the smoothing Gaussian (default is 1.4).
+     * @param kernelSize The size of the smoothing kernel (default is 5).
+     */
+    static void apply_canny_edge_detection(Image& img, int lowThreshold, int highThreshold, double sigma = 1.4, int kernelSize = 5); //applies canny edge detection to the image
 
     /**
      * @brief Applies Roberts edge detection to the image.
@@ -140,7 +185,9 @@ public:
     static void apply_roberts_edge_detection(Image& img); //applies roberts edge detection to the image
 
     /**
-     * @brief Applies 3D median blur to the volume.
+     * @brief Applies 3D median blur to the volume, of any sample type.
+     * @details The volume is filtered slice by slice in place, keeping padded copies of only the kernelSize
+     * slices around the current one; the alpha channel of RGBA volumes is kept.
      * @param vol The volume to blur.
      * @param kernelSize The size of the kernel for 3D median blur.
      */
@@ -153,6 +200,41 @@ public:
      */
     static void gaussian_blur_3d(Volume &vol, int kernelSize, double sigma=2.0);
 
+    /**
+     * @brief Applies 3D median blur to a sparse volume, tile by tile.
+     * @details The colour channels match median_blur_3d on the dense volume; the alpha channel of RGBA volumes
+     * is kept. A tile whose whole neighbourhood is one constant tile is left as it is.
+     * @param vol The volume to blur.
+     * @param kernelSize The size of the kernel for 3D median blur.
+     */
+    static void median_blur_3d(SparseVolume &vol, int kernelSize);
+
+    /**
+     * @brief Applies 3D Gaussian blur to a sparse volume, tile by tile.
+     * @details The x and y passes match gaussian_blur_3d on the dense volume, and the z pass truncates like the
+     * dense one. The results are not identical, though: the dense z pass runs in place in slice order, so each
+     * slice is blurred with the already blurred slices before it, where the sparse pass reads the x and y
+     * results only. Wherever the volume varies along z the dense result is smoother, by up to about 20 levels on
+     * a noisy 8-bit scan with a kernel of 5. A tile whose whole neighbourhood is one constant tile is left as it
+     * is, and filtered tiles are collapsed at the volume's background level, if any.
+     * @param vol The volume to blur.
+     * @param kernelSize The size of the kernel for 3D Gaussian blur.
+     * @param sigma The standard deviation of the Gaussian kernel (default is 2.0).
+     */
+    static void gaussian_blur_3d(SparseVolume &vol, int kernelSize, double sigma=2.0);
+
+    /**
+     * @brief Applies 3D contrast limited adaptive histogram equalization (CLAHE) to the volume.
+     * @details Only 8-bit volumes are supported, as the tiles are equalized over 256-bin histograms; load a
+     * 16-bit or float stack with LoadOptions::window to equalize it.
+     * @param vol The volume to equalize.
+     * @throws std::invalid_argument if the volume is not 8-bit.
+     * @param tiles The number of blocks along x and y (default is 8).
+     * @param tilesZ The number of blocks along z (default is 8).
+     * @param clipLimit The clip limit as a multiple of the mean bin height (default is 2, 0 disables clipping).
+     */
+    static void clahe_3d(Volume &vol, int tiles = 8, int tilesZ = 8, double clipLimit = 2.0);
+
 private:
     /**
      * @brief Returns a 1D array of the Gaussian kernel.
@@ -189,10 +271,10 @@ private:
     /**
      * @brief Applies edge detection to the image.
      * @param img The image to apply edge detection to.
-     * @param horizontal_kernel The horizontal 3x3 kernel for edge detection.
-     * @param vertical_kernel The vertical 3x3 kernel for edge detection.
+     * @param op The 3x3 gradient operator for edge detection.
+     * @param mode The gradient magnitude mode.
      */
-    static void apply_edge_detection(Image& img, const int horizontal_kernel[3][3], const int vertical_kernel[3][3]); //applies edge detection to the image
+    static void apply_edge_detection(Image& img, GradientOperator op, GradientMagnitude mode); //applies edge detection to the image
 
     /**
      * @brief Performs quick selection algorithm to find the k-th smallest element in the given array.
@@ -0,0 +1,116 @@
+/**
+* @file gradient.h
+* @brief this header file contains the declarations of the fused integer gradient engine used by the Sobel, Prewitt and Scharr edge detectors.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_GRADIENT_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_GRADIENT_H
+
+#include <cstdint>
+
+/**
+ * @brief Enumerates the supported 3x3 gradient operators.
+ */
+enum class GradientOperator {
+    Sobel,
+    Prewitt,
+    Scharr
+};
+
+/**
+ * @brief Enumerates the ways the gradient magnitude can be reduced to 8 bits.
+ */
+enum class GradientMagnitude {
+    L2, /**< Exact sqrt(gx^2 + gy^2), identical to the original double precision output. */
+    L1, /**< |gx| + |gy|, cheaper but overestimates diagonal edges. */
+    LUT /**< Exact L2 through a square root lookup table on the clamped squared magnitude. */
+};
+
+/**
+ * @brief The Gradient class computes 3x3 image gradients in 16-bit integer arithmetic.
+ * @details Every supported operator is separable into a smoothing vector (a, b, a) and the
+ * central difference (-1, 0, 1), so Gx and Gy share one vertical pass over three row pointers.
+ * Only the first and last column are treated specially, every other column runs branch free.
+ */
+class Gradient {
+public:
+    /**
+     * @brief Computes the clamped gradient magnitude of a single channel image.
+     * @param src The source pixels (w * h bytes).
+     * @param dst The destination pixels (w * h bytes), must not alias src.
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param op The gradient operator to use.
+     * @param mode The magnitude reduction to use (default is exact L2).
+     */
+    static void magnitude(const unsigned char* src, unsigned char* dst, int w, int h,
+                          GradientOperator op, GradientMagnitude mode = GradientMagnitude::L2);
+
+    /**
+     * @brief Computes the magnitude for the rows [y0, y1) only, reading neighbours from the full image.
+     * @param src The source pixels (w * h bytes).
+     * @param dst The destination rows, dst[0] is row y0.
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param y0 The first row to compute.
+     * @param y1 One past the last row to compute.
+     * @param op The gradient operator to use.
+     * @param mode The magnitude reduction to use.
+     */
+    static void magnitude_rows(const unsigned char* src, unsigned char* dst, int w, int h, int y0, int y1,
+                               GradientOperator op, GradientMagnitude mode);
+
+    /**
+     * @brief Computes the signed x and y derivatives for the rows [y0, y1).
+     * @param src The source pixels (w * h bytes).
+     * @param gx The x derivative for the requested rows, gx[0] is row y0.
+     * @param gy The y derivative for the requested rows, gy[0] is row y0.
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param y0 The first row to compute.
+     * @param y1 One past the last row to compute.
+     * @param op The gradient operator to use.
+     */
+    static void derivative_rows(const unsigned char* src, int16_t* gx, int16_t* gy, int w, int h, int y0, int y1,
+                                GradientOperator op);
+
+private:
+    /**
+     * @brief The signature of a row kernel, which computes Gx and Gy for one row from its three (border
+     * replicated) source rows: (up, mid, dn, w, vs, vd, gx, gy), where vs and vd are scratch rows.
+     */
+    using RowKernel = void (*)(const unsigned char*, const unsigned char*, const unsigned char*, int,
+                               int16_t*, int16_t*, int16_t*, int16_t*);
+
+    /**
+     * @brief Gets the row kernel of an operator, specialised on its constant weights and bound for this CPU.
+     * @param op The gradient operator.
+     * @return The row kernel.
+     */
+    static RowKernel row_kernel(GradientOperator op);
+
+    /**
+     * @brief Reduces one row of derivatives to clamped 8-bit magnitudes.
+     * @param gx The x derivative row.
+     * @param gy The y derivative row.
+     * @param dst The destination row.
+     * @param w The width of the row.
+     * @param mode The magnitude reduction to use.
+     */
+    static void reduce(const int16_t* gx, const int16_t* gy, unsigned char* dst, int w, GradientMagnitude mode);
+
+    /**
+     * @brief Returns the lookup table mapping a squared magnitude (clamped to 255^2) to its 8-bit square root.
+     * @return Pointer to the 65026 entry table.
+     */
+    static const unsigned char* sqrt_table();
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_GRADIENT_H
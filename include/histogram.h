@@ -0,0 +1,99 @@
+/**
+* @file histogram.h
+* @brief this header file contains the declarations of the parallel histogram and statistics engine shared by Image and Volume.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_HISTOGRAM_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_HISTOGRAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @brief The intensity statistics of an 8-bit buffer, all derived from a single 256 bin histogram.
+ * @details Every colour sample is counted; the alpha channel of 4 channel images is skipped.
+ */
+struct ImageStatistics {
+    std::array<uint64_t, 256> histogram{}; /**< The number of samples of each value. */
+    uint64_t count = 0;                    /**< The number of samples. */
+    uint64_t sum = 0;                      /**< The sum of all samples. */
+    unsigned char min = 0;                 /**< The smallest sample (0 if there are none). */
+    unsigned char max = 0;                 /**< The largest sample (0 if there are none). */
+
+    /**
+     * @brief Gets the mean of the samples.
+     * @return The mean, or 0 if there are no samples.
+     */
+    double mean() const;
+
+    /**
+     * @brief Gets the smallest value with at least the given percentage of the samples at or below it.
+     * @param percent The percentage, between 0 and 100.
+     * @return The percentile value, or 0 if there are no samples.
+     */
+    unsigned char percentile(double percent) const;
+};
+
+/**
+ * @brief The lazily computed statistics of a pixel buffer, shared by every shallow copy of an Image.
+ */
+struct StatisticsCache {
+    std::mutex lock;       /**< Serialises the computation of the statistics. */
+    bool valid = false;    /**< Whether stats describes the current pixel data. */
+    ImageStatistics stats; /**< The cached statistics. */
+    uint64_t revision = 0; /**< Counts the changes to the pixel data, so summaries can tell they are stale. */
+};
+
+/**
+ * @brief The Histogram class builds histograms and statistics of 8-bit buffers in parallel.
+ * @details The rows are split across the threads; each thread counts into its own privatised bins
+ * (four interleaved copies, so repeated values do not serialise on one counter) and the per-thread
+ * histograms are merged at the end. Min, max, sum and percentiles all come from the merged histogram,
+ * so the buffer is read exactly once.
+ */
+class Histogram {
+public:
+    /**
+     * @brief Computes the statistics of an interleaved buffer.
+     * @param data The interleaved samples.
+     * @param w The width of the buffer.
+     * @param h The height of the buffer.
+     * @param channels The number of channels (the alpha of 4 channel buffers is skipped).
+     * @return The statistics of the buffer.
+     */
+    static ImageStatistics compute(const unsigned char* data, int w, int h, int channels);
+
+    /**
+     * @brief Adds the statistics of one buffer to another, e.g. to combine the slices of a volume.
+     * @param into The statistics to add to.
+     * @param other The statistics to add.
+     */
+    static void merge(ImageStatistics& into, const ImageStatistics& other);
+
+private:
+    /**
+     * @brief Counts a run of interleaved pixels into a histogram.
+     * @param data The interleaved samples.
+     * @param n The number of pixels.
+     * @param channels The number of channels.
+     * @param hist The 256 bin histogram to add to.
+     */
+    static void accumulate(const unsigned char* data, size_t n, int channels, uint64_t* hist);
+
+    /**
+     * @brief Fills in count, sum, min and max from the histogram.
+     * @param stats The statistics to complete.
+     */
+    static void summarise(ImageStatistics& stats);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_HISTOGRAM_H
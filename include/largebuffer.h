@@ -0,0 +1,114 @@
+/**
+* @file largebuffer.h
+* @brief this header file contains the huge-page aware allocator used for image and volume pixel buffers.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_LARGEBUFFER_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_LARGEBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Counters of the large-buffer allocator since the last reset.
+ * @details Faults are only counted for buffers touched by the allocator. The measured count is the minor page
+ * faults of the whole process during first touch, so work running concurrently on other threads inflates it.
+ */
+struct LargeBufferStatistics {
+    uint64_t allocations = 0;     /**< The buffers at or above the threshold. */
+    uint64_t hugeAllocations = 0; /**< The buffers advised to use transparent huge pages. */
+    size_t bytes = 0;             /**< The bytes of all large buffers. */
+    size_t hugeBytes = 0;         /**< The bytes advised to use transparent huge pages. */
+    uint64_t faultsExpected = 0;  /**< The 4 KiB pages the touched buffers span, one fault each without huge pages. */
+    uint64_t faultsMeasured = 0;  /**< The minor faults observed while touching them. */
+    uint64_t faultsAvoided = 0;   /**< faultsExpected - faultsMeasured, where positive. */
+};
+
+/**
+ * @brief The LargeBuffer class allocates the pixel buffers of images and volumes.
+ * @details Buffers of at least threshold() bytes are aligned to 2 MiB and, when huge pages are enabled, advised
+ * with madvise(MADV_HUGEPAGE) so the kernel can back them with transparent huge pages. When first touch is
+ * enabled, the pages are then written in parallel, split by rows like Parallel::for_range splits the filters,
+ * so each page is faulted in by the thread that will later process it rather than by the first serial writer.
+ * Smaller buffers come straight from malloc. Decoded images are moved into large buffers with copy(), which
+ * touches the pages by copying the rows in parallel instead of zeroing them first. Every buffer can be released with free() (and so with
+ * stbi_image_free and Image::set_data). Both features can be switched at run time, or with the
+ * IMAGE_HUGE_PAGES and IMAGE_FIRST_TOUCH environment variables (0 or 1), to compare timings.
+ */
+class LargeBuffer {
+public:
+    /**
+     * @brief Allocates an uninitialised buffer of rows rows of rowBytes bytes.
+     * @param rows The number of rows, the unit first touch is split on.
+     * @param rowBytes The bytes per row.
+     * @return The buffer, to be released with free().
+     */
+    static unsigned char* allocate(size_t rows, size_t rowBytes);
+
+    /**
+     * @brief Copies rows into a new buffer; for a large buffer the parallel copy is its first touch.
+     * @details Used to move decoded images, which stb allocates with malloc, into large buffers once decoding
+     * is done, so the decoder's own temporaries stay on malloc.
+     * @param src The rows to copy.
+     * @param rows The number of rows, the unit the copy is split on.
+     * @param rowBytes The bytes per row.
+     * @return The buffer, to be released with free().
+     */
+    static unsigned char* copy(const unsigned char* src, size_t rows, size_t rowBytes);
+
+    /**
+     * @brief Enables or disables madvise(MADV_HUGEPAGE) on large buffers.
+     * @param enabled Whether to request huge pages.
+     */
+    static void set_huge_pages(bool enabled);
+
+    /**
+     * @brief Gets whether large buffers request huge pages.
+     * @return Whether huge pages are enabled.
+     */
+    static bool huge_pages();
+
+    /**
+     * @brief Enables or disables the parallel first touch of large buffers.
+     * @param enabled Whether to touch large buffers in parallel.
+     */
+    static void set_first_touch(bool enabled);
+
+    /**
+     * @brief Gets whether large buffers are touched in parallel.
+     * @return Whether first touch is enabled.
+     */
+    static bool first_touch();
+
+    /**
+     * @brief Sets the size from which buffers are treated as large.
+     * @param bytes The threshold in bytes.
+     */
+    static void set_threshold(size_t bytes);
+
+    /**
+     * @brief Gets the size from which buffers are treated as large (2 MiB by default).
+     * @return The threshold in bytes.
+     */
+    static size_t threshold();
+
+    /**
+     * @brief Gets the counters of the allocator.
+     * @return The statistics since the last reset.
+     */
+    static LargeBufferStatistics statistics();
+
+    /**
+     * @brief Resets the counters.
+     */
+    static void reset_statistics();
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_LARGEBUFFER_H
@@ -0,0 +1,110 @@
+/**
+* @file lut.h
+* @brief this header file contains the declaration of the LutChain class that composes pointwise 8-bit operations into lookup tables.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_LUT_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_LUT_H
+
+#include <array>
+#include <cstddef>
+#include "Image.h"
+#include "volume.h"
+
+/**
+ * @brief The LutChain class collapses a sequence of pointwise 8-bit operations into one LUT per colour channel.
+ * @details Every operation maps the 256 possible values of a channel to 256 values, so any chain of them is
+ * itself such a map. Each call composes its operation onto the current tables in 256 steps, and apply() then
+ * makes a single pass over the pixels, whatever the length of the chain. The alpha channel of 4 channel
+ * images is never touched.
+ */
+class LutChain {
+public:
+    static constexpr int CHANNELS = 3; /**< The number of colour channels with their own LUT. */
+
+    /**
+     * @brief Constructs the identity chain.
+     */
+    LutChain();
+
+    /**
+     * @brief Adds a constant to every colour channel, clamping to [0, 255].
+     * @param delta The amount to add (may be negative).
+     * @return This chain.
+     */
+    LutChain& brightness(int delta);
+
+    /**
+     * @brief Maps values above the threshold to 255 and the rest to 0.
+     * @param threshold The threshold value.
+     * @return This chain.
+     */
+    LutChain& threshold(int threshold);
+
+    /**
+     * @brief Replaces every value v by 255 - v.
+     * @return This chain.
+     */
+    LutChain& invert();
+
+    /**
+     * @brief Applies the power law 255 * (v / 255) ^ gamma, rounded to the nearest value.
+     * @param gamma The exponent (below 1 brightens, above 1 darkens).
+     * @return This chain.
+     */
+    LutChain& gamma(double gamma);
+
+    /**
+     * @brief Maps every colour channel through an arbitrary table, e.g. a histogram equalization mapping.
+     * @param table The 256 entry table.
+     * @return This chain.
+     */
+    LutChain& map(const unsigned char* table);
+
+    /**
+     * @brief Maps a single colour channel through an arbitrary table.
+     * @param channel The channel (0 to 2).
+     * @param table The 256 entry table.
+     * @return This chain.
+     */
+    LutChain& map(int channel, const unsigned char* table);
+
+    /**
+     * @brief Gets the composed table of a colour channel.
+     * @param channel The channel (0 to 2).
+     * @return The 256 entry table.
+     */
+    const unsigned char* table(int channel) const;
+
+    /**
+     * @brief Applies the chain to an interleaved buffer in one pass.
+     * @param data The pixels.
+     * @param n The number of pixels.
+     * @param channels The number of channels (the alpha of 4 channel buffers is left untouched).
+     */
+    void apply(unsigned char* data, size_t n, int channels) const;
+
+    /**
+     * @brief Applies the chain to an image in place, splitting the rows across threads.
+     * @param img The image.
+     */
+    void apply(Image& img) const;
+
+    /**
+     * @brief Applies the chain to every slice of a volume in place, splitting the slices across threads.
+     * @param vol The volume.
+     */
+    void apply(Volume& vol) const;
+
+private:
+    std::array<std::array<unsigned char, 256>, CHANNELS> luts; /**< The composed table of each colour channel. */
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_LUT_H
@@ -0,0 +1,91 @@
+/**
+* @file parallel.h
+* @brief this header file contains the declarations of the Parallel class that splits pixel loops across the available cores.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PARALLEL_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PARALLEL_H
+
+#include <functional>
+
+/**
+ * @brief The Parallel class runs loops over 1D, 2D and 3D index ranges on a persistent work-stealing thread pool.
+ * @details The pool is created on first use and kept for the lifetime of the program. A loop is cut into chunks
+ * that are dealt round-robin onto per-thread queues; a thread that runs out of work steals chunks from the back of
+ * the other queues, so uneven rows (e.g. near borders or early exits) do not leave cores idle. The calling thread
+ * works on the loop too. A loop started from inside another loop's body runs serially on the calling thread, so
+ * nesting never oversubscribes the cores.
+ */
+class Parallel {
+public:
+    /**
+     * @brief Gets the number of threads used by parallel loops.
+     * @return The number of threads (at least 1).
+     */
+    static int num_threads();
+
+    /**
+     * @brief Sets the number of threads used by parallel loops, restarting the pool.
+     * @details The default is the IMAGE_NUM_THREADS environment variable if set, otherwise one thread per core.
+     * Must not be called while a parallel loop is running.
+     * @param threads The number of threads (values below 1 restore the default).
+     */
+    static void set_num_threads(int threads);
+
+    /**
+     * @brief Selects deterministic chunking.
+     * @details When enabled, every loop is split into exactly num_threads() equal contiguous chunks and chunk i
+     * always runs on thread i, without stealing, so the partition and its assignment are reproducible run to run.
+     * @param deterministic Whether to use deterministic chunking (default is false).
+     */
+    static void set_deterministic(bool deterministic);
+
+    /**
+     * @brief Runs body over [begin, end) split into contiguous chunks spread across the threads.
+     * @param begin The first index of the range.
+     * @param end One past the last index of the range.
+     * @param body The function called with the [chunkBegin, chunkEnd) of each chunk.
+     * @param grain The minimum number of indices per chunk (default is 1).
+     */
+    static void for_range(int begin, int end, const std::function<void(int, int)>& body, int grain = 1);
+
+    /**
+     * @brief Runs body over the 2D range [y0, y1) x [x0, x1) split into rectangular blocks.
+     * @param y0 The first row.
+     * @param y1 One past the last row.
+     * @param x0 The first column.
+     * @param x1 One past the last column.
+     * @param body The function called with the (rowBegin, rowEnd, colBegin, colEnd) of each block.
+     * @param grainY The number of rows per block (default is 1).
+     * @param grainX The number of columns per block (default is the whole row).
+     */
+    static void for_range_2d(int y0, int y1, int x0, int x1,
+                             const std::function<void(int, int, int, int)>& body,
+                             int grainY = 1, int grainX = 0);
+
+    /**
+     * @brief Runs body over the 3D range [z0, z1) x [y0, y1) x [x0, x1) split into boxes.
+     * @param z0 The first slice.
+     * @param z1 One past the last slice.
+     * @param y0 The first row.
+     * @param y1 One past the last row.
+     * @param x0 The first column.
+     * @param x1 One past the last column.
+     * @param body The function called with the (sliceBegin, sliceEnd, rowBegin, rowEnd, colBegin, colEnd) of each box.
+     * @param grainZ The number of slices per box (default is 1).
+     * @param grainY The number of rows per box (default is all rows).
+     * @param grainX The number of columns per box (default is the whole row).
+     */
+    static void for_range_3d(int z0, int z1, int y0, int y1, int x0, int x1,
+                             const std::function<void(int, int, int, int, int, int)>& body,
+                             int grainZ = 1, int grainY = 0, int grainX = 0);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PARALLEL_H
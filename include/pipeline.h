@@ -0,0 +1,136 @@
+/**
+* @file pipeline.h
+* @brief this header file contains the declaration of the Pipeline class that runs chains of local filters tile by tile.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PIPELINE_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PIPELINE_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "Image.h"
+#include "gradient.h"
+#include "lut.h"
+
+/**
+ * @brief The Pipeline class executes a chain of Filter stages tile by tile instead of stage by stage.
+ * @details Every stage is local: an output pixel only depends on input pixels within the stage's halo.
+ * The image is cut into tiles sized to fit the L2 cache; each tile is copied out together with the sum of the
+ * halos of all stages, the whole chain runs on that small image, and only the core of the result is written
+ * back. Pixels near a cut are computed from real neighbours, so the output is identical to running the stages
+ * one after another on the full image, while the full-size intermediates between stages are never created.
+ * Stages that need the whole image (histograms, global statistics, connectivity) must not be added; run the
+ * pipeline first and apply them to the result.
+ */
+class Pipeline {
+public:
+    /**
+     * @brief Adds a custom stage.
+     * @param stage The filter to apply to each tile.
+     * @param halo How far (in pixels) an output pixel of the stage can depend on its input.
+     * @return This pipeline.
+     */
+    Pipeline& add(std::function<void(Image&)> stage, int halo);
+
+    /**
+     * @brief Adds a median blur stage.
+     * @param kernelSize The size of the kernel.
+     * @return This pipeline.
+     */
+    Pipeline& median_blur(int kernelSize);
+
+    /**
+     * @brief Adds a box blur stage.
+     * @param kernelSize The size of the kernel.
+     * @return This pipeline.
+     */
+    Pipeline& box_blur(int kernelSize);
+
+    /**
+     * @brief Adds a Gaussian blur stage.
+     * @param kernelSize The size of the kernel.
+     * @param sigma The standard deviation of the Gaussian.
+     * @return This pipeline.
+     */
+    Pipeline& gaussian_blur(int kernelSize, double sigma = 2.0);
+
+    /**
+     * @brief Adds a grayscale conversion stage.
+     * @return This pipeline.
+     */
+    Pipeline& gray();
+
+    /**
+     * @brief Adds a brightness adjustment stage.
+     * @param brightness The amount of brightness adjustment.
+     * @return This pipeline.
+     */
+    Pipeline& brightness(int brightness);
+
+    /**
+     * @brief Adds a composed pointwise stage.
+     * @param chain The LUT chain to apply.
+     * @return This pipeline.
+     */
+    Pipeline& lut(const LutChain& chain);
+
+    /**
+     * @brief Adds a gradient edge detection stage (the tile is converted to grayscale first).
+     * @param op The gradient operator.
+     * @param mode The gradient magnitude mode.
+     * @return This pipeline.
+     */
+    Pipeline& edge_detection(GradientOperator op, GradientMagnitude mode = GradientMagnitude::L2);
+
+    /**
+     * @brief Gets the number of pending stages.
+     * @return The number of stages.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Gets the total halo of the pending stages, i.e. how far each tile is extended on every side.
+     * @return The halo in pixels.
+     */
+    int halo() const;
+
+    /**
+     * @brief Runs all pending stages on the image and clears the pipeline.
+     * @param img The image to process; its data and channels are replaced by the result.
+     */
+    void run(Image& img);
+
+    /**
+     * @brief Drops all pending stages.
+     */
+    void clear();
+
+private:
+    /**
+     * @brief A pending stage.
+     */
+    struct Stage {
+        std::function<void(Image&)> apply; /**< The filter to apply to a tile. */
+        int halo;                          /**< How far an output pixel depends on the input. */
+    };
+
+    std::vector<Stage> stages; /**< The pending stages, in order. */
+
+    /**
+     * @brief Chooses the side of the tile cores so that a tile with its halo and intermediates fits in L2.
+     * @param pixelBytes The bytes per pixel of the input.
+     * @param halo The total halo.
+     * @return The side of the tile cores in pixels.
+     */
+    static int tile_size(int pixelBytes, int halo);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PIPELINE_H
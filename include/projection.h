@@ -15,6 +15,7 @@
 
 #include "Image.h"
 #include "volume.h"
+#include "sparse.h"
 
 /**
  * @brief The Projection class provides functions for generating projections from a Volume.
@@ -24,29 +25,77 @@ public:
     /**
      * @brief Computes the Maximum Intensity Projection (MIP) from the given Volume.
      * @param vol The Volume object from which to generate the MIP.
-     * @param filter_method The method used for filtering (default is 3).
+     * @param filter_method The method used for filtering: 1 Gaussian, 2 median, 3 none, 4 CLAHE, 8-bit volumes
+     * only (default is 3).
      * @param kernelSize The size of the kernel used for filtering (default is 7).
-     * @return The MIP image.
+     * @param sigma The standard deviation of the Gaussian filter (default is 2.0).
+     * @param level The pyramid level to project, see Volume::build_pyramid; a reduced level is filtered as a
+     * copy, leaving the pyramid as built (default is 0, the full resolution, which is filtered in place).
+     * @return The MIP image, of the size of the level.
      */
-    static Image MIP(Volume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0);
+    static Image MIP(Volume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0,
+                     int level = 0);
 
     /**
      * @brief Computes the Minimum Intensity Projection (MinIP) from the given Volume.
      * @param vol The Volume object from which to generate the MinIP.
-     * @param filter_method The method used for filtering (default is 3).
+     * @param filter_method The method used for filtering: 1 Gaussian, 2 median, 3 none, 4 CLAHE, 8-bit volumes
+     * only (default is 3).
      * @param kernelSize The size of the kernel used for filtering (default is 7).
-     * @return The MinIP image.
+     * @param sigma The standard deviation of the Gaussian filter (default is 2.0).
+     * @param level The pyramid level to project, see Volume::build_pyramid; a reduced level is filtered as a
+     * copy, leaving the pyramid as built (default is 0, the full resolution, which is filtered in place).
+     * @return The MinIP image, of the size of the level.
      */
-    static Image MinIP(Volume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0);
+    static Image MinIP(Volume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0,
+                       int level = 0);
 
     /**
      * @brief Computes the Average Intensity Projection (AIP) from the given Volume.
      * @param vol The Volume object from which to generate the AIP.
-     * @param filter_method The method used for filtering (default is 3).
+     * @param filter_method The method used for filtering: 1 Gaussian, 2 median, 3 none, 4 CLAHE, 8-bit volumes
+     * only (default is 3).
+     * @param kernelSize The size of the kernel used for filtering (default is 7).
+     * @param sigma The standard deviation of the Gaussian filter (default is 2.0).
+     * @param level The pyramid level to project, see Volume::build_pyramid; a reduced level is filtered as a
+     * copy, leaving the pyramid as built (default is 0, the full resolution, which is filtered in place).
+     * @return The AIP image, of the size of the level.
+     */
+    static Image AIP(Volume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0,
+                     int level = 0);
+
+    /**
+     * @brief Computes the Maximum Intensity Projection (MIP) of a sparse volume, reading each constant tile once.
+     * @param vol The SparseVolume object from which to generate the MIP.
+     * @param filter_method The method used for filtering: 1 Gaussian, 2 median, 3 none (default is 3).
+     * @param kernelSize The size of the kernel used for filtering (default is 7).
+     * @param sigma The standard deviation of the Gaussian filter (default is 2.0).
+     * @return The MIP image.
+     * @throws std::invalid_argument for CLAHE (4), which has no sparse form.
+     */
+    static Image MIP(SparseVolume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0);
+
+    /**
+     * @brief Computes the Minimum Intensity Projection (MinIP) of a sparse volume, reading each constant tile once.
+     * @param vol The SparseVolume object from which to generate the MinIP.
+     * @param filter_method The method used for filtering: 1 Gaussian, 2 median, 3 none (default is 3).
+     * @param kernelSize The size of the kernel used for filtering (default is 7).
+     * @param sigma The standard deviation of the Gaussian filter (default is 2.0).
+     * @return The MinIP image.
+     * @throws std::invalid_argument for CLAHE (4), which has no sparse form.
+     */
+    static Image MinIP(SparseVolume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0);
+
+    /**
+     * @brief Computes the Average Intensity Projection (AIP) of a sparse volume, reading each constant tile once.
+     * @param vol The SparseVolume object from which to generate the AIP.
+     * @param filter_method The method used for filtering: 1 Gaussian, 2 median, 3 none (default is 3).
      * @param kernelSize The size of the kernel used for filtering (default is 7).
+     * @param sigma The standard deviation of the Gaussian filter (default is 2.0).
      * @return The AIP image.
+     * @throws std::invalid_argument for CLAHE (4), which has no sparse form.
      */
-    static Image AIP(Volume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0);
+    static Image AIP(SparseVolume &vol, const int& filter_method=3, int kernelSize=7, double sigma = 2.0);
 };
 
 #endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PROJECTION_H
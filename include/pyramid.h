@@ -0,0 +1,47 @@
+/**
+* @file pyramid.h
+* @brief this header file contains the 2x downsampling that builds the resolution levels of a volume.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PYRAMID_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PYRAMID_H
+
+#include <vector>
+#include "Image.h"
+
+class Volume;
+
+/**
+ * @brief The averaging used to make each level of a pyramid from the one above it.
+ */
+enum class PyramidFilter {
+    Box,     /**< The mean of each 2x2x2 block. */
+    Gaussian /**< The binomial weights 1 3 3 1 along each axis, centred on the same 2x2x2 block. */
+};
+
+/**
+ * @brief The Pyramid class halves volumes along x, y and z.
+ */
+class Pyramid {
+public:
+    /**
+     * @brief Makes the next level of a pyramid.
+     * @details Each axis longer than 1 is halved, rounding up; samples past an odd edge repeat the last one.
+     * An axis of length 1 is kept as it is, so a single slice is only reduced in x and y. The slices are read
+     * through Volume::at, so a lazy volume is streamed, and are made in parallel over output rows. Integer
+     * samples are rounded to the nearest level.
+     * @param vol The volume to reduce.
+     * @param filter The averaging to use.
+     * @return The slices of the reduced volume, each with its own data, of the same sample type and channels.
+     */
+    static std::vector<Image> downsample(const Volume& vol, PyramidFilter filter);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_PYRAMID_H
@@ -0,0 +1,140 @@
+/**
+* @file scratch.h
+* @brief this header file contains the thread-local arena the filters draw their temporary buffers from.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SCRATCH_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SCRATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Counters of the scratch arena, summed over all threads.
+ */
+struct ScratchStatistics {
+    uint64_t requests = 0;  /**< The number of buffers handed out. */
+    uint64_t hits = 0;      /**< The requests served from a cached block instead of the heap. */
+    size_t bytesInUse = 0;  /**< The bytes currently handed out. */
+    size_t peakBytes = 0;   /**< The most bytes handed out at once since the last reset. */
+    size_t bytesCached = 0; /**< The bytes held in the free lists of all threads. */
+};
+
+/**
+ * @brief The Scratch class hands out temporary blocks from a per-thread cache of freed blocks.
+ * @details Requests are rounded up to a power of two (at least 64 bytes), or past 64 MiB to the next eighth of
+ * a power of two, and each size has its own free list, so a filter called over and over on same-sized images
+ * reuses the same blocks instead of going back to the heap and faulting fresh pages. Blocks are 64 byte
+ * aligned. A block returns to the free list of the thread that releases it; each thread caches at most
+ * cache_limit() bytes and frees anything beyond that, except that a thread with an empty cache keeps one block
+ * of any size.
+ */
+class Scratch {
+public:
+    /**
+     * @brief A block handed out by the arena.
+     */
+    struct Block {
+        void* ptr = nullptr; /**< The start of the block, or nullptr for an empty request. */
+        int bucket = -1;     /**< The size class of the block. */
+    };
+
+    /**
+     * @brief Takes a block of at least bytes bytes, reusing a cached one when possible.
+     * @param bytes The size needed.
+     * @return The block; its contents are undefined.
+     */
+    static Block acquire(size_t bytes);
+
+    /**
+     * @brief Returns a block to the calling thread's cache.
+     * @param block The block; empty blocks are ignored.
+     */
+    static void release(Block block);
+
+    /**
+     * @brief Gets the counters of the arena.
+     * @return The statistics over all threads.
+     */
+    static ScratchStatistics statistics();
+
+    /**
+     * @brief Resets the request and hit counters, and the peak to the bytes currently in use.
+     */
+    static void reset_statistics();
+
+    /**
+     * @brief Frees every block cached by the calling thread.
+     */
+    static void trim();
+
+    /**
+     * @brief Sets how many bytes each thread may keep cached.
+     * @param bytes The limit per thread; 0 disables caching.
+     */
+    static void set_cache_limit(size_t bytes);
+
+    /**
+     * @brief Gets how many bytes each thread may keep cached.
+     * @return The limit per thread.
+     */
+    static size_t cache_limit();
+};
+
+/**
+ * @brief An uninitialised array of count elements borrowed from the scratch arena for the lifetime of the object.
+ * @tparam T A trivially copyable element type.
+ */
+template <typename T>
+class ScratchBuffer {
+    static_assert(std::is_trivially_copyable_v<T>, "Scratch buffers hold raw memory");
+
+public:
+    ScratchBuffer() = default;
+
+    /**
+     * @brief Borrows room for count elements.
+     * @param count The number of elements.
+     */
+    explicit ScratchBuffer(size_t count) : n(count), block(Scratch::acquire(count * sizeof(T))) {}
+
+    ScratchBuffer(const ScratchBuffer&) = delete;
+    ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+    ScratchBuffer(ScratchBuffer&& other) noexcept
+        : n(std::exchange(other.n, 0)), block(std::exchange(other.block, Scratch::Block{})) {}
+
+    ScratchBuffer& operator=(ScratchBuffer&& other) noexcept {
+        if (this != &other) {
+            Scratch::release(block);
+            n = std::exchange(other.n, 0);
+            block = std::exchange(other.block, Scratch::Block{});
+        }
+        return *this;
+    }
+
+    ~ScratchBuffer() {
+        Scratch::release(block);
+    }
+
+    T* data() { return static_cast<T*>(block.ptr); }
+    const T* data() const { return static_cast<const T*>(block.ptr); }
+    size_t size() const { return n; }
+    T& operator[](size_t i) { return data()[i]; }
+    const T& operator[](size_t i) const { return data()[i]; }
+
+private:
+    size_t n = 0;         /**< The number of elements. */
+    Scratch::Block block; /**< The borrowed block. */
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SCRATCH_H
@@ -13,6 +13,7 @@
 # pragma once
 
 #include "volume.h"
+#include "sparse.h"
 #include "Image.h"
 
 /**
@@ -31,9 +32,38 @@ public:
     /**
      * @brief Generates a slice from the given volume for any plane.
      * @param volume The Volume object from which to generate the slice.
+     * @param n The index of the slice, in full resolution coordinates at every level.
+     * @param type The type of slice (XZ or YZ).
+     * @param level The pyramid level to slice, see Volume::build_pyramid (default is 0, the full resolution).
+     * @return The generated slice image, of the size of the level.
+     */
+    static Image slice(const Volume& volume, int n, SliceType type, int level = 0);
+
+    /**
+     * @brief Generates a slice from a sparse volume for any plane, reading its tiles directly.
+     * @param volume The SparseVolume object from which to generate the slice.
      * @param n The index of the slice.
      * @param type The type of slice (XZ or YZ).
      * @return The generated slice image.
      */
-    static Image slice(const Volume& volume, int n, SliceType type);
+    static Image slice(const SparseVolume& volume, int n, SliceType type);
+
+    /**
+     * @brief Transposes a volume so that its slices are the XZ or YZ planes, in one cache-blocked parallel pass.
+     * @details Slice n of the result equals slice(volume, n, type): an XZ reorientation has one slice per row,
+     * each w by depth, and a YZ reorientation one slice per column, each h by depth. Use it instead of calling
+     * slice() for every plane, which for YZ planes rereads the whole volume once per column.
+     * @param volume The volume to reorient; a lazy one is streamed one source slice per task.
+     * @param type The planes that become slices (XZ or YZ).
+     * @return A fully loaded volume holding a copy of every voxel.
+     */
+    static Volume reorient(const Volume& volume, SliceType type);
+
+    /**
+     * @brief Saves every XZ or YZ plane of a volume, reoriented once and encoded in parallel.
+     * @param volume The volume to export.
+     * @param type The planes to save (XZ or YZ).
+     * @param directoryPath The directory to save the planes to, as xz0.png, xz1.png, ... or yz0.png, yz1.png, ...
+     */
+    static void save_all(const Volume& volume, SliceType type, const std::string& directoryPath);
 };
\ No newline at end of file
@@ -0,0 +1,49 @@
+/**
+* @file slicecodec.h
+* @brief this header file contains the lossless codec that keeps the slices of a volume compressed in memory.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SLICECODEC_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SLICECODEC_H
+
+#include <cstddef>
+#include <vector>
+
+class Image;
+
+/**
+ * @brief The SliceCodec class compresses images losslessly with a delta predictor and a run-length coder.
+ * @details Each sample is replaced by its difference from the sample above it (or, in the first row, from the
+ * same channel of the pixel to its left), computed in the integer width of the sample so it wraps exactly; float
+ * samples are differenced as their bit patterns. Predicting from the row above keeps decoding a plain add of
+ * two rows, which vectorises. For samples wider than a byte the differences are split into byte planes, so the
+ * high bytes, which are nearly always 0 or 255, form long runs of their own. The bytes are then coded as runs
+ * and literals, which decode with memset and memcpy: flat regions such as the air around a specimen shrink to a
+ * few bytes per row, and a slice decodes many times faster than from PNG.
+ */
+class SliceCodec {
+public:
+    /**
+     * @brief Compresses an image.
+     * @param img The image.
+     * @return The packed bytes; the size, channels and sample type are not stored.
+     */
+    static std::vector<unsigned char> encode(const Image& img);
+
+    /**
+     * @brief Decompresses an image packed by encode.
+     * @param packed The packed bytes.
+     * @param img An image of the size, channels and sample type that was encoded, whose data is overwritten.
+     * @throws std::runtime_error if the packed bytes do not decode to the size of img.
+     */
+    static void decode(const std::vector<unsigned char>& packed, Image& img);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SLICECODEC_H
@@ -0,0 +1,188 @@
+/**
+* @file sparse.h
+* @brief this header file contains the sparse, tiled representation of mostly empty volumes.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SPARSE_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SPARSE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "Image.h"
+
+class Volume;
+
+/**
+ * @brief One tile of a sparse volume: either every voxel has the same value, or all voxels are stored.
+ */
+struct SparseTile {
+    bool constant = false;            /**< Whether bytes holds the single pixel shared by every voxel. */
+    std::vector<unsigned char> bytes; /**< One pixel for a constant tile, otherwise the voxels, x fastest, then y, then z. */
+};
+
+/**
+ * @brief The SparseVolume class stores a volume as a two-level map: a directory of tiles of size^3 voxels,
+ * where only tiles with varying voxels keep their data.
+ * @details A tile whose voxels are all equal is replaced by a constant tile holding one pixel, and constant
+ * tiles of the same value are shared by every directory entry that uses them. Only exactly constant tiles are
+ * collapsed by default; the air of a real scan is noisy, so a background level can be given instead, and every
+ * tile whose colour samples are at or below it is stored as background, zero in the colour channels. Tiles on
+ * the far edges are clipped to the volume. Tiles are immutable once stored, so operations build new tiles and
+ * swap them in with set_tiles().
+ */
+class SparseVolume {
+public:
+    static constexpr int TILE = 16; /**< The default edge of a tile, in voxels. */
+
+    /**
+     * @brief Converts a dense volume, in parallel over tiles.
+     * @param vol The volume; a lazy one is streamed one layer of tiles at a time.
+     * @param size The edge of a tile, in voxels.
+     * @param background The sample value at or below which a whole tile is stored as background, in the units
+     * of the pixel type, or none to collapse only exactly constant tiles. The alpha of a background tile must
+     * still be constant.
+     * @throws std::invalid_argument if size is not positive.
+     */
+    explicit SparseVolume(const Volume& vol, int size = TILE, std::optional<double> background = std::nullopt);
+
+    SparseVolume(const SparseVolume&) = delete;
+    SparseVolume& operator=(const SparseVolume&) = delete;
+
+    /**
+     * @brief Converts back to a dense volume, in parallel over slices.
+     * @return A fully loaded volume with the same voxels.
+     */
+    Volume dense() const;
+
+    int width() const;
+    int height() const;
+    int depth() const;
+    int channels() const;
+    PixelType pixel_type() const;
+
+    /**
+     * @brief Gets the background level tiles are collapsed at.
+     * @return The level, or none if only exactly constant tiles are collapsed.
+     */
+    std::optional<double> background_level() const;
+
+    /**
+     * @brief Gets the edge of a tile.
+     * @return The edge, in voxels.
+     */
+    int tile_size() const;
+
+    /**
+     * @brief Gets the number of tiles along x.
+     * @return The number of tiles.
+     */
+    int tiles_x() const;
+
+    /**
+     * @brief Gets the number of tiles along y.
+     * @return The number of tiles.
+     */
+    int tiles_y() const;
+
+    /**
+     * @brief Gets the number of tiles along z.
+     * @return The number of tiles.
+     */
+    int tiles_z() const;
+
+    /**
+     * @brief Gets the bytes of one pixel.
+     * @return channels() times the bytes per sample.
+     */
+    int pixel_bytes() const;
+
+    /**
+     * @brief Gets one tile.
+     * @param tx The tile along x.
+     * @param ty The tile along y.
+     * @param tz The tile along z.
+     * @return The tile, shared with every entry of the same constant value.
+     */
+    const std::shared_ptr<const SparseTile>& tile(int tx, int ty, int tz) const;
+
+    /**
+     * @brief Gets the size of one tile, clipped to the volume.
+     * @param tx The tile along x.
+     * @param ty The tile along y.
+     * @param tz The tile along z.
+     * @param ex Set to the width of the tile.
+     * @param ey Set to the height of the tile.
+     * @param ez Set to the depth of the tile.
+     */
+    void tile_extent(int tx, int ty, int tz, int& ex, int& ey, int& ez) const;
+
+    /**
+     * @brief Makes a tile from its voxels, replacing it with the shared constant tile if they are all equal,
+     * or with the background tile if they are at or below the background level.
+     * @details Safe to call from several threads. The filters store their tiles through here too, so a
+     * filtered tile that falls to the background level is collapsed as well.
+     * @param voxels The voxels of a tile, x fastest, then y, then z.
+     * @return The tile to store.
+     */
+    std::shared_ptr<const SparseTile> make_tile(std::vector<unsigned char> voxels);
+
+    /**
+     * @brief Replaces every tile, and forgets the constant tiles no longer used.
+     * @param replacement The new directory, one tile per entry, x fastest, then y, then z.
+     */
+    void set_tiles(std::vector<std::shared_ptr<const SparseTile>> replacement);
+
+    /**
+     * @brief Copies a box of voxels into a dense buffer.
+     * @param x0 The first column.
+     * @param x1 One past the last column.
+     * @param y0 The first row.
+     * @param y1 One past the last row.
+     * @param z0 The first slice.
+     * @param z1 One past the last slice.
+     * @param dst The buffer, x fastest, then y, then z.
+     */
+    void gather(int x0, int x1, int y0, int y1, int z0, int z1, unsigned char* dst) const;
+
+    /**
+     * @brief Gets the number of tiles that keep their voxels.
+     * @return The number of stored tiles.
+     */
+    size_t stored_tiles() const;
+
+    /**
+     * @brief Gets the memory held by the tiles and the directory.
+     * @return The bytes, counting each shared constant tile once.
+     */
+    size_t resident_bytes() const;
+
+    /**
+     * @brief Gets the memory the same volume takes when dense.
+     * @return The bytes of every voxel.
+     */
+    size_t dense_bytes() const;
+
+private:
+    int w = 0, h = 0, d = 0, c = 0;               /**< The size and channels of the volume. */
+    PixelType type = PixelType::UInt8;            /**< The sample type. */
+    int size = TILE;                              /**< The edge of a tile. */
+    std::optional<double> background;             /**< The level tiles are collapsed at, if any. */
+    int nx = 0, ny = 0, nz = 0;                   /**< The number of tiles along each axis. */
+    std::vector<std::shared_ptr<const SparseTile>> tiles; /**< The directory, x fastest. */
+
+    std::mutex constantsLock;                     /**< Guards constants. */
+    std::map<std::string, std::shared_ptr<const SparseTile>> constants; /**< The constant tiles by pixel bytes. */
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_SPARSE_H
@@ -0,0 +1,91 @@
+/**
+* @file threshold.h
+* @brief this header file contains the declarations of the automatic global and local adaptive threshold selection.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_THRESHOLD_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_THRESHOLD_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Enumerates the methods that pick a single global threshold from the histogram.
+ */
+enum class GlobalThreshold {
+    Otsu,    /**< Maximises the between-class variance. */
+    Triangle /**< Maximises the distance to the line from the histogram peak to its far tail. */
+};
+
+/**
+ * @brief Enumerates the methods that threshold each pixel against statistics of its neighbourhood.
+ */
+enum class AdaptiveThreshold {
+    Bradley, /**< Foreground if the pixel is above (1 - k) times the local mean. */
+    Sauvola  /**< Foreground if the pixel is above mean * (1 + k * (stddev / 128 - 1)). */
+};
+
+/**
+ * @brief The Threshold class selects thresholds and binarises single channel images.
+ * @details Global thresholds only need the 256 bin histogram, so they cost one pass over the image
+ * (or none, if the histogram is cached). Adaptive thresholds use an integral image of the pixels and,
+ * for Sauvola, of their squares, so each window sum costs four lookups whatever the window size.
+ */
+class Threshold {
+public:
+    /**
+     * @brief Computes Otsu's threshold.
+     * @param histogram The 256 bin histogram.
+     * @return The threshold; values above it are foreground.
+     */
+    static int otsu(const std::array<uint64_t, 256>& histogram);
+
+    /**
+     * @brief Computes the triangle threshold.
+     * @param histogram The 256 bin histogram.
+     * @return The threshold; values above it are foreground.
+     */
+    static int triangle(const std::array<uint64_t, 256>& histogram);
+
+    /**
+     * @brief Computes a global threshold with the given method.
+     * @param histogram The 256 bin histogram.
+     * @param method The method.
+     * @return The threshold; values above it are foreground.
+     */
+    static int global(const std::array<uint64_t, 256>& histogram, GlobalThreshold method);
+
+    /**
+     * @brief Binarises a single channel image against the statistics of a square window around each pixel.
+     * @param src The source pixels (w * h bytes).
+     * @param dst The destination pixels (w * h bytes, 255 for foreground and 0 otherwise), may alias src.
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param windowSize The side of the window, clipped at the image border.
+     * @param k The sensitivity (around 0.15 for Bradley, 0.2 for Sauvola).
+     * @param method The method.
+     */
+    static void adaptive(const unsigned char* src, unsigned char* dst, int w, int h,
+                         int windowSize, double k, AdaptiveThreshold method);
+
+private:
+    /**
+     * @brief Builds the (w + 1) * (h + 1) summed area table of the pixels, or of their squares.
+     * @param src The source pixels (w * h bytes).
+     * @param w The width of the image.
+     * @param h The height of the image.
+     * @param squares Whether to sum the squares of the pixels.
+     * @return The table, with a zero first row and column.
+     */
+    static std::vector<uint64_t> integral(const unsigned char* src, int w, int h, bool squares);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_THRESHOLD_H
@@ -15,6 +15,7 @@
 #include "filter.h"
 #include "projection.h"
 #include "slice.h"
+#include "pipeline.h"
 
 /**
  * @brief The Utility class provides methods for building the UI interface in main.
@@ -73,9 +74,9 @@ private:
 
     /**
      * @brief Allows the user to choose between median, guassian, and box blur.
-     * @param img The image to apply blur.
+     * @param pipeline The pipeline the blur is queued on; it runs tile by tile together with the following local filters.
      */
-    static void apply_blur(Image& img);
+    static void apply_blur(Pipeline& pipeline);
 
     /**
      * @brief Allows the user to add salt and pepper noise to the image.
@@ -92,8 +93,9 @@ private:
     /**
      * @brief Allows the user to choose between sobel, prewitt, scharr, and roberts edge detection.
      * @param img The image to apply edge detection.
+     * @param pipeline The pending local filters; gradient operators are queued on it, the others run it first.
      */
-    static void apply_edge_detection(Image& img);
+    static void apply_edge_detection(Image& img, Pipeline& pipeline);
 
     /**
      * @brief Allows the user to choose between dilation and erosion.
@@ -117,7 +119,7 @@ private:
      * @brief Allows the user to choose between different slice method to use.
      * @param vol The volume to apply slice.
      */
-    static Image take_a_slice(Volume vol);
+    static Image take_a_slice(const Volume& vol);
 
     /**
      * @brief Displays a message and prompts the user to try again.
@@ -16,11 +16,16 @@
 #include "stb_image.h"
 #include "stb_image_write.h"
 #include "Image.h"
+#include "dirindex.h"
+#include "pyramid.h"
+#include "bricks.h"
 
 #include <vector>
 #include <string>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 namespace fs = std::filesystem;
 
@@ -46,53 +51,332 @@ public:
      */
     Volume(const std::string& directoryPath, int z1, int z2, int desiredChannels = 0);
 
+    /**
+     * @brief Constructs a Volume object from the images in the specified directory, applying load options.
+     * @details An automatic window is shared by every slice: it is resolved from the histogram of up to
+     * WINDOW_SAMPLES evenly spaced slices, then the other slices are mapped as they are decoded.
+     * With options.lazy, only the image headers are read (from the directory index), so the size of the volume
+     * is known at once; see at(). collapseGray is ignored in lazy mode, as it depends on every slice.
+     * With options.compressed, every slice is decoded once, in parallel, and kept compressed in memory with
+     * SliceCodec; at() then decompresses slices instead of reading the files, keeping options.maxResident of them,
+     * or COMPRESSED_RESIDENT if that is 0. Such a volume is never loaded whole, see getImages().
+     * Slices must share one bit depth: a directory mixing 8-bit, 16-bit and float images is reported as an
+     * error and gives an empty volume.
+     * @param directoryPath The path to the directory containing the images.
+     * @param options The decode options.
+     */
+    Volume(const std::string& directoryPath, const LoadOptions& options);
+
+    /**
+     * @brief Constructs a Volume object from the images within the specified range, applying load options.
+     * @param directoryPath The path to the directory containing the images.
+     * @param z1 The starting index of images to include in the volume.
+     * @param z2 The ending index of images to include in the volume.
+     * @param options The decode options.
+     */
+    Volume(const std::string& directoryPath, int z1, int z2, const LoadOptions& options);
+
+    static constexpr int WINDOW_SAMPLES = 16; /**< The slices an automatic window of a volume is taken from. */
+    static constexpr size_t COMPRESSED_RESIDENT = 16; /**< The decoded slices a compressed volume keeps by default. */
+
     ~Volume();
 
+    /**
+     * @brief Volumes are not copied implicitly: the slices are freed by the volume that owns them, and a lazy
+     * volume's decode state belongs to it alone. Pass volumes by reference, or see copy().
+     */
+    Volume(const Volume&) = delete;
+    Volume& operator=(const Volume&) = delete;
+
+    /**
+     * @brief Takes over the slices, lazy state, pyramid and bricks of another volume, leaving it empty.
+     * @param other The volume to move from.
+     */
+    Volume(Volume&& other) noexcept;
+
+    /**
+     * @brief Frees the slices of this volume and takes over those of another, leaving it empty.
+     * @param other The volume to move from.
+     * @return This volume.
+     */
+    Volume& operator=(Volume&& other) noexcept;
+
     // ~Volume();
 
     /**
-     * @brief Saves the volume to the specified directory.
+     * @brief Saves the volume to the specified directory, encoding the slices in parallel.
      * @param directoryPath The path to the directory to save the volume.
+     * @param prefix The start of each file name, followed by the slice index (default is "image").
      */
-    void save(const std::string& directoryPath);
+    void save(const std::string& directoryPath, const std::string& prefix = "image");
 
     /**
      * @brief Retrieves the images in the volume.
+     * @details A lazy volume decodes all its remaining slices first and stays fully loaded from then on, so the
+     * filters that modify the images in place keep working on it. Use at() to read slices without loading.
      * @return A vector containing the images in the volume.
+     * @throws std::runtime_error if the volume was loaded with LoadOptions::compressed: decoding it whole is what
+     * that mode avoids, so the filters that work on every slice in place (the 3D filters and lookup tables)
+     * reject it. Projections, slices and pyramids stream it through at(); copy() makes an explicit full copy.
+     */
+    std::vector<Image> getImages();
+
+    /**
+     * @brief Makes a fully loaded copy of the volume with its own slices; the pyramid and bricks are not copied.
+     * @details A lazy volume stays lazy, its slices are fetched through at().
+     * @return The copy.
+     */
+    Volume copy() const;
+
+    /**
+     * @brief Gets one slice, decoding it first if the volume is lazy and the slice is not resident.
+     * @details Safe to call from several threads. The returned handle keeps the pixels alive even if the slice
+     * is evicted meanwhile; for a fully loaded volume it shares the pixels owned by the volume.
+     * @param z The slice, in [0, depth()).
+     * @return The slice.
+     */
+    std::shared_ptr<Image> at(int z) const;
+
+    /**
+     * @brief Gets the number of slices.
+     * @return The depth of the volume.
+     */
+    int depth() const;
+
+    /**
+     * @brief Gets the width of the slices.
+     * @return The width.
+     */
+    int width() const;
+
+    /**
+     * @brief Gets the height of the slices.
+     * @return The height.
+     */
+    int height() const;
+
+    /**
+     * @brief Gets the number of channels of the slices.
+     * @return The channels.
+     */
+    int channels() const;
+
+    /**
+     * @brief Gets the sample type of the slices.
+     * @return The sample type.
+     */
+    PixelType pixel_type() const;
+
+    /**
+     * @brief Whether slices are still decoded on demand.
+     * @return true until the volume is fully loaded.
+     */
+    bool lazy() const;
+
+    /**
+     * @brief Gets how many decoded slices a lazy volume keeps.
+     * @return The limit, or 0 if all slices are kept (always 0 once fully loaded).
+     */
+    size_t resident_limit() const;
+
+    /**
+     * @brief Gets how many decoded slices a lazy volume currently keeps.
+     * @return The resident slices, or depth() once fully loaded.
+     */
+    size_t resident() const;
+
+    /**
+     * @brief Gets the memory held by the compressed slices of a volume loaded with LoadOptions::compressed.
+     * @return The bytes, or 0 if the slices are not kept compressed.
+     */
+    size_t compressed_bytes() const;
+
+    /**
+     * @brief Gets the intensity statistics of the whole volume.
+     * @details Each slice keeps its own cached statistics, so only slices modified since the last call are rescanned.
+     * @return The histogram, min, max and mean over all slices.
+     */
+    ImageStatistics statistics() const;
+
+    /**
+     * @brief Builds reduced copies of the volume, each half the size of the one before in x, y and z.
+     * @details Level 0 is the volume itself; level k + 1 is made from level k in parallel. The levels are kept
+     * in memory alongside the volume, with the revision of every slice they were made from: level() rebuilds
+     * them once any slice has been modified since. A lazy volume stays lazy, its slices are streamed once to
+     * make level 1.
+     * Any level a previous call made is dropped, along with references to it.
+     * @param levels The number of reduced levels to build, or 0 to halve until the slices are 1 by 1.
+     * @param filter The averaging used for each level.
+     */
+    void build_pyramid(int levels = 0, PyramidFilter filter = PyramidFilter::Box);
+
+    /**
+     * @brief Drops the reduced levels; references to them are no longer valid.
+     */
+    void clear_pyramid();
+
+    /**
+     * @brief Gets the number of levels, counting the volume itself.
+     * @return 1 plus the number of reduced levels built.
+     */
+    int levels() const;
+
+    /**
+     * @brief Gets one level of the pyramid, first rebuilding the levels if a slice was modified since they were made.
+     * @details The levels are rebuilt in place, so a reference returned earlier stays valid and shows the new
+     * level; only build_pyramid() and clear_pyramid() drop the levels. Safe to call from several threads, but
+     * not while another thread modifies the volume or reads a level that may be rebuilt.
+     * @param k The level, 0 for the volume itself.
+     * @return The level.
+     * @throws std::out_of_range if level k has not been built.
+     */
+    Volume& level(int k);
+
+    /**
+     * @brief Gets one level of the pyramid, first rebuilding the levels if a slice was modified since they were made.
+     * @details The levels are rebuilt in place, so a reference returned earlier stays valid and shows the new
+     * level; only build_pyramid() and clear_pyramid() drop the levels. Safe to call from several threads, but
+     * not while another thread modifies the volume or reads a level that may be rebuilt.
+     * @param k The level, 0 for the volume itself.
+     * @return The level.
+     * @throws std::out_of_range if level k has not been built.
+     */
+    const Volume& level(int k) const;
+
+    /**
+     * @brief Builds the min/max/mean summary of every brick of the volume, see BrickGrid.
+     * @param size The edge of a brick, in voxels.
+     */
+    void build_bricks(int size = BrickGrid::BRICK);
+
+    /**
+     * @brief Drops the brick summaries.
+     */
+    void clear_bricks();
+
+    /**
+     * @brief Gets the brick summaries, first rescanning the bricks of any slice modified since they were made.
+     * @details Not safe to call while another thread modifies the volume.
+     * @return The grid, or nullptr if build_bricks has not been called.
      */
-    std::vector<Image> getImages() const;
+    const BrickGrid* bricks() const;
 
     /**
-     * @brief Retrieves the filenames in a directory.
-     * @return A vector containing the filenames in the directory.
+     * @brief Retrieves the files in a directory in natural order, from the cached directory index.
+     * @return A vector containing the files in the directory.
      */
     static std::vector<fs::directory_entry> getFileEntries(const std::string& directoryPath);
 
 private:
-    std::vector<Image> images; /**< Vector to hold loaded images. */
+    friend class SparseVolume;
+    friend class Slice;
+
+    std::vector<Image> images; /**< Vector to hold loaded images; filled on demand for a lazy volume. */
+
+    std::vector<std::shared_ptr<Volume>> pyramid;     /**< The reduced levels, level 1 first. */
+    int pyramidLevels = 0;                            /**< The levels asked of build_pyramid. */
+    PyramidFilter pyramidFilter = PyramidFilter::Box; /**< The averaging the levels were made with. */
+    mutable std::vector<uint64_t> pyramidRevisions;   /**< The revision of each slice the levels were made from. */
+    mutable std::mutex pyramidLock;                   /**< Guards pyramid and pyramidRevisions; taken before lazyLock. */
+    mutable std::shared_ptr<BrickGrid> brickGrid; /**< The brick summaries, or nullptr if not built. */
+
+    /**
+     * @brief Constructs a fully loaded Volume object that owns the given slices.
+     * @param slices The slices, all of the same size, channels and sample type.
+     */
+    explicit Volume(std::vector<Image> slices);
+
+    struct LazySlices;
+    std::shared_ptr<LazySlices> lazySlices; /**< The decode-on-demand state, or nullptr once loaded. */
+    mutable std::mutex lazyLock;            /**< Guards lazySlices, which materialise() drops while at() reads it. */
+
+    /**
+     * @brief Gets the decode-on-demand state under lazyLock.
+     * @return The state, or nullptr once the volume is fully loaded.
+     */
+    std::shared_ptr<LazySlices> lazyState() const;
+
+    /**
+     * @brief Sets up lazy loading of the image entries [first, last) of an index.
+     * @param index The directory index.
+     * @param first The position of the first entry.
+     * @param last One past the position of the last entry.
+     * @param options The decode options.
+     */
+    void openLazy(const std::shared_ptr<const DirectoryIndex>& index, size_t first, size_t last,
+                  const LoadOptions& options);
+
+    /**
+     * @brief Makes the reduced levels from the slices as they are now, recording their revisions.
+     * @details Called with pyramidLock held.
+     */
+    void buildLevels();
+
+    /**
+     * @brief Remakes the existing levels from the slices as they are now, into the same Volume objects.
+     * @details Called with pyramidLock held.
+     */
+    void refreshLevels() const;
+
+    /**
+     * @brief Gets the revision of every slice; the slices of a lazy volume cannot be modified and count as 0.
+     * @return The revisions, one per slice.
+     */
+    std::vector<uint64_t> sliceRevisions() const;
+
+    /**
+     * @brief Decodes one slice of a lazy volume, from its compressed copy if it has one or else from its file.
+     * @param state The lazy state.
+     * @param z The slice.
+     * @return The slice, with its own data.
+     */
+    static Image decodeSlice(const LazySlices& state, int z);
+
+    /**
+     * @brief Decodes every slice of a lazy volume into images and leaves lazy mode.
+     */
+    void materialise();
+
+    /**
+     * @brief The outcome of loading one directory entry.
+     */
+    struct LoadedEntry {
+        Image image;        /**< The loaded image, valid when loaded is true. */
+        bool loaded = false; /**< Whether the entry was a file that loaded successfully. */
+        std::string error;  /**< The reason the entry failed to load, empty otherwise. */
+    };
 
     /**
-     * @brief Partitions the directory entries for quicksort.
-     * @param entries The vector of directory entries to partition.
-     * @param low The lower index of the partition.
-     * @param high The higher index of the partition.
-     * @return The index of the pivot element.
+     * @brief Loads the entries [first, last) in parallel.
+     * @param entries The files of the directory index.
+     * @param first The index of the first entry to load.
+     * @param last One past the index of the last entry to load.
+     * @param options The decode options.
+     * @return One result per entry, in entry order.
      */
-    size_t partition(std::vector<fs::directory_entry>& entries, size_t low, size_t high);
+    static std::vector<LoadedEntry> loadEntries(const std::vector<IndexEntry>& entries,
+                                                size_t first, size_t last, const LoadOptions& options);
 
     /**
-     * @brief Sorts the filenames of directory entries.
-     * @param entries The vector of directory entries to sort.
+     * @brief Loads the entries [first, last) in parallel with the given options, skipping those marked done.
+     * @param entries The files of the directory index.
+     * @param first The index of the first entry to load.
+     * @param options The decode options.
+     * @param loaded The results, one per entry from first.
+     * @param done The entries to skip, or empty to load all.
      */
-    void sortFilenames(std::vector<fs::directory_entry>& entries);
+    static void decodeEntries(const std::vector<IndexEntry>& entries, size_t first,
+                              const LoadOptions& options, std::vector<LoadedEntry>& loaded,
+                              const std::vector<bool>& done);
 
     /**
-     * @brief Sorts the directory entries using quicksort algorithm.
-     * @param entries The vector of directory entries to sort.
-     * @param low The lower index of the partition.
-     * @param high The higher index of the partition.
+     * @brief Expands collapsed gray slices so every loaded slice has the same number of channels.
+     * @param entries The directory entries that were loaded.
+     * @param first The index of the first entry loaded.
+     * @param loaded The results of loading the entries.
+     * @throws std::runtime_error If a slice cannot be expanded; every loaded slice is freed first.
      */
-    void quicksort(std::vector<fs::directory_entry>& entries, size_t low, size_t high);
+    static void matchChannels(const std::vector<IndexEntry>& entries, size_t first, std::vector<LoadedEntry>& loaded);
 };
 
 #endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_VOLUME_H
@@ -0,0 +1,104 @@
+/**
+* @file window.h
+* @brief this header file contains the window/level mapping of 16-bit and float images down to 8-bit.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#ifndef ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_WINDOW_H
+#define ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_WINDOW_H
+
+#include <cstdint>
+#include <vector>
+
+class Image;
+enum class PixelType;
+
+/**
+ * @brief A window/level transform: the sample range [center - width / 2, center + width / 2] is stretched
+ * linearly onto [0, 255], values outside it saturate.
+ * @details center and width are in the sample units of the image (0 to 65535 for 16-bit, 0 to 255 for 8-bit,
+ * nominally 0 to 1 for float). A width of 0 or less asks for an automatic window spanning the lowPercentile
+ * to highPercentile of the colour samples instead.
+ */
+struct WindowLevel {
+    double center = 0.0;          /**< The level, the sample value mapped to mid grey. */
+    double width = 0.0;           /**< The width of the window; 0 or less for an automatic window. */
+    double lowPercentile = 0.5;   /**< The percentile mapped to 0 by an automatic window. */
+    double highPercentile = 99.5; /**< The percentile mapped to 255 by an automatic window. */
+
+    /**
+     * @brief Whether the window is derived from the histogram of the samples.
+     * @return true for an automatic window.
+     */
+    bool automatic() const { return width <= 0.0; }
+
+    /**
+     * @brief Makes an explicit window.
+     * @param center The level.
+     * @param width The width of the window.
+     * @return The window.
+     */
+    static WindowLevel manual(double center, double width);
+
+    /**
+     * @brief Makes an automatic window between two percentiles of the samples.
+     * @param low The percentile mapped to 0.
+     * @param high The percentile mapped to 255.
+     * @return The window.
+     */
+    static WindowLevel percentile(double low = 0.5, double high = 99.5);
+};
+
+/**
+ * @brief The Window class maps images of any sample type to 8-bit through a window/level transform.
+ * @details Integer samples go through a lookup table with one entry per possible value (64 KiB for 16-bit, so it
+ * stays in L2), and the mapping costs one load per sample. Float samples are
+ * mapped arithmetically. The alpha channel of 2 and 4 channel images is rescaled over its full range, not
+ * windowed.
+ */
+class Window {
+public:
+    static constexpr int BINS = 65536; /**< The bins of the histograms automatic windows are taken from. */
+
+    /**
+     * @brief Adds the colour samples of an image to a histogram of BINS bins.
+     * @details 16-bit samples fill one bin each, 8-bit samples the first 256 bins and float samples are
+     * quantised over [0, 1].
+     * @param img The image.
+     * @param histogram The histogram to add to, resized to BINS bins if needed.
+     */
+    static void accumulate(const Image& img, std::vector<uint64_t>& histogram);
+
+    /**
+     * @brief Turns an automatic window into an explicit one from a histogram built by accumulate.
+     * @param window The window; explicit windows are returned unchanged.
+     * @param histogram The histogram of the samples.
+     * @param type The sample type the histogram was built from.
+     * @return The explicit window.
+     */
+    static WindowLevel resolve(const WindowLevel& window, const std::vector<uint64_t>& histogram, PixelType type);
+
+    /**
+     * @brief Builds the lookup table of an explicit window for an integer sample type.
+     * @param window The explicit window.
+     * @param type PixelType::UInt8 (256 entries) or PixelType::UInt16 (65536 entries).
+     * @return The table.
+     */
+    static std::vector<unsigned char> lut(const WindowLevel& window, PixelType type);
+
+    /**
+     * @brief Maps an image to 8-bit, in parallel over rows.
+     * @param img The image to map.
+     * @param window The window; an automatic one is resolved from the histogram of img.
+     * @return A new 8-bit image with its own data.
+     */
+    static Image apply(const Image& img, const WindowLevel& window);
+};
+
+#endif //ADVANCED_PROGRAMMING_GROUP_LINEAR_REGRESSION_WINDOW_H
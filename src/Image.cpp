@@ -10,26 +10,111 @@
 * @date 19/03/2024
 */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
 #include "Image.h"
+#include "largebuffer.h"
+#include "parallel.h"
+
+/**
+ * @brief Reads sample i of a buffer as a fraction of the full range of its type.
+ */
+static double to_unit(const unsigned char* data, PixelType type, size_t i) {
+    switch (type) {
+        case PixelType::UInt8: return data[i] / 255.0;
+        case PixelType::UInt16: return reinterpret_cast<const uint16_t*>(data)[i] / 65535.0;
+        case PixelType::Float32: return reinterpret_cast<const float*>(data)[i];
+    }
+    return 0.0;
+}
+
+/**
+ * @brief Writes a fraction of the full range as sample i of a buffer, clamping and rounding for integer types.
+ */
+static void from_unit(unsigned char* data, PixelType type, size_t i, double v) {
+    switch (type) {
+        case PixelType::UInt8:
+            data[i] = static_cast<unsigned char>(std::round(std::clamp(v, 0.0, 1.0) * 255.0));
+            break;
+        case PixelType::UInt16:
+            reinterpret_cast<uint16_t*>(data)[i] = static_cast<uint16_t>(std::round(std::clamp(v, 0.0, 1.0) * 65535.0));
+            break;
+        case PixelType::Float32:
+            reinterpret_cast<float*>(data)[i] = static_cast<float>(v);
+            break;
+    }
+}
 
 /**
  * @brief Constructs an Image object from the given file.
  * @author Shengzhi Tian
  */
-Image::Image(std::string const& fileName, int desiredChannels) {
-    data = stbi_load(fileName.c_str(), &w, &h, &c, 0);
+Image::Image(std::string const& fileName, int desiredChannels) : Image(fileName, LoadOptions::with_channels(desiredChannels)) {
+}
+
+/**
+ * @brief Constructs an Image object from the given file, applying load options while decoding.
+ * @author Shengzhi Tian
+ * @author Zhikang Dong
+ */
+Image::Image(std::string const& fileName, const LoadOptions& options) {
+    const int desired = options.desiredChannels;
+    if (desired < 0 || desired > 4) {
+        throw std::invalid_argument("The desired number of channels must be between 0 and 4.");
+    }
+    // 16-bit PNGs keep their precision and HDR files their float samples; everything else loads as 8-bit.
+    // stb converts to the desired channel count while decoding, so the wider buffer never exists
+    if (stbi_is_16_bit(fileName.c_str())) {
+        data = reinterpret_cast<unsigned char*>(stbi_load_16(fileName.c_str(), &w, &h, &c, desired));
+        type = PixelType::UInt16;
+    } else if (stbi_is_hdr(fileName.c_str())) {
+        data = reinterpret_cast<unsigned char*>(stbi_loadf(fileName.c_str(), &w, &h, &c, desired));
+        type = PixelType::Float32;
+    } else {
+        data = stbi_load(fileName.c_str(), &w, &h, &c, desired);
+    }
     if (data == nullptr) {
         throw std::runtime_error("Failed to load image: " + fileName);
     }
+    // stb reports the channels of the file, not of the buffer it returned
+    if (desired != 0) c = desired;
     assert(c > 0 && "The number of channels should be greater than 0.");
-    std::cout << "Image loaded with size " << w << " x " << h << " with " << c << " channel(s)." << std::endl;
+
+    bool replaced = false;
+    if (options.window) {
+        // Map while the decoded slice is still warm and drop the wide buffer right away
+        Image windowed = Window::apply(*this, *options.window);
+        stbi_image_free(data);
+        data = windowed.data;
+        type = PixelType::UInt8;
+        replaced = true;
+    }
+    if (options.collapseGray && desired == 0) {
+        replaced = collapse_gray() || replaced;
+    }
+    // stb decodes into malloc'd memory; a large result still in it moves to a large buffer, once
+    const size_t row = static_cast<size_t>(w) * c * bytes_per_sample();
+    if (!replaced && row * h >= LargeBuffer::threshold()) {
+        unsigned char* large = LargeBuffer::copy(data, h, row);
+        stbi_image_free(data);
+        data = large;
+    }
+
+    std::cout << "Image loaded with size " << w << " x " << h << " with " << c << " channel(s)";
+    if (type != PixelType::UInt8) {
+        std::cout << " of " << (type == PixelType::UInt16 ? "16-bit" : "float") << " samples";
+    }
+    std::cout << "." << std::endl;
 }
 
 /**
  * @brief Constructs an Image object from the given data.
  * @author Shengzhi Tian
  */
-Image::Image(unsigned char* data, int w, int h, int c) : data(data), w(w), h(h), c(c) {
+Image::Image(unsigned char* data, int w, int h, int c, PixelType type) : data(data), w(w), h(h), c(c), type(type) {
     if (data == nullptr) {
         throw std::runtime_error("Invalid image data.");
     }
@@ -60,15 +145,134 @@ unsigned char* Image::get_data() const {
     return data;
 }
 
+PixelType Image::pixel_type() const {
+    return type;
+}
+
+int Image::bytes_per_sample() const {
+    return bytes_per_sample(type);
+}
+
+int Image::bytes_per_sample(PixelType type) {
+    switch (type) {
+        case PixelType::UInt8: return 1;
+        case PixelType::UInt16: return 2;
+        case PixelType::Float32: return 4;
+    }
+    return 1;
+}
+
+/**
+ * @brief Converts the image to another sample type.
+ * @details Integer ranges map onto each other and onto [0, 1] for float; conversions to integer types clamp
+ * and round. Rows are converted in parallel.
+ * @author Zhikang Dong
+ */
+Image Image::converted(PixelType target) const {
+    const size_t row = static_cast<size_t>(w) * c;
+    unsigned char* out = LargeBuffer::allocate(h, row * bytes_per_sample(target));
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        for (size_t i = y0 * row; i < y1 * row; ++i) {
+            from_unit(out, target, i, to_unit(data, type, i));
+        }
+    }, 16);
+    return {out, w, h, c, target};
+}
+
+/**
+ * @brief Collapses an RGB or RGBA image whose colour channels are all equal to gray (and alpha).
+ * @details The rows are checked in parallel and the check stops as soon as any thread finds a colour pixel.
+ * Alpha is dropped when it is fully opaque everywhere.
+ * @author Zhikang Dong
+ */
+bool Image::collapse_gray() {
+    if (c != 3 && c != 4) return false;
+    std::atomic<bool> gray{true}, opaque{true};
+    const size_t row = static_cast<size_t>(w) * c;
+    visit_pixel_type(type, [&](auto sample) {
+        using T = decltype(sample);
+        const T* src = pixels<T>();
+        const T full = std::is_floating_point_v<T> ? T(1) : static_cast<T>(PixelTraits<T>::max);
+        Parallel::for_range(0, h, [&](int y0, int y1) {
+            bool rowOpaque = true;
+            for (int y = y0; y < y1 && gray.load(std::memory_order_relaxed); ++y) {
+                const T* p = src + y * row;
+                bool same = true;
+                for (int x = 0; x < w; ++x, p += c) {
+                    same &= (p[0] == p[1]) & (p[1] == p[2]);
+                    if (c == 4) rowOpaque &= (p[3] == full);
+                }
+                if (!same) gray = false;
+            }
+            if (!rowOpaque) opaque = false;
+        }, 16);
+    });
+    if (!gray) return false;
+
+    const int keep = (c == 4 && !opaque) ? 2 : 1;
+    const int bytes = bytes_per_sample();
+    unsigned char* out = LargeBuffer::allocate(h, static_cast<size_t>(w) * keep * bytes);
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        for (size_t p = static_cast<size_t>(y0) * w; p < static_cast<size_t>(y1) * w; ++p) {
+            std::memcpy(out + p * keep * bytes, data + p * c * bytes, bytes);
+            if (keep == 2) std::memcpy(out + (p * keep + 1) * bytes, data + (p * c + 3) * bytes, bytes);
+        }
+    }, 16);
+    set_data(out);
+    c = keep;
+    return true;
+}
+
+/**
+ * @brief Expands a gray (and alpha) image by repeating the gray channel.
+ * @author Zhikang Dong
+ */
+void Image::expand_gray(int channels) {
+    if (c == channels) return;
+    if (!((c == 1 && channels >= 2 && channels <= 4) || (c == 2 && channels == 4))) {
+        throw std::invalid_argument("Only gray images can be expanded to RGB or RGBA.");
+    }
+    const bool alphaOut = (channels == 2 || channels == 4);
+    const int colours = alphaOut ? channels - 1 : channels;
+    const int bytes = bytes_per_sample();
+    unsigned char* out = LargeBuffer::allocate(h, static_cast<size_t>(w) * channels * bytes);
+    visit_pixel_type(type, [&](auto sample) {
+        using T = decltype(sample);
+        const T* src = pixels<T>();
+        T* dst = reinterpret_cast<T*>(out);
+        const T full = std::is_floating_point_v<T> ? T(1) : static_cast<T>(PixelTraits<T>::max);
+        Parallel::for_range(0, h, [&](int y0, int y1) {
+            for (size_t p = static_cast<size_t>(y0) * w; p < static_cast<size_t>(y1) * w; ++p) {
+                const T v = src[p * c];
+                for (int k = 0; k < colours; ++k) dst[p * channels + k] = v;
+                if (alphaOut) dst[p * channels + colours] = (c == 2) ? src[p * c + 1] : full;
+            }
+        }, 16);
+    });
+    set_data(out);
+    c = channels;
+}
+
 /**
  * @brief Saves the image to the specified file.
  * @author Shengzhi Tian
  */
-void Image::save(std::string const& fileName) {
+void Image::save(std::string const& fileName, bool report) {
+    if (type != PixelType::UInt8) {
+        // PNG output is 8-bit, so wider samples are written through a temporary conversion
+        Image bytes = converted(PixelType::UInt8);
+        int written = stbi_write_png(fileName.c_str(), w, h, c, bytes.data, w * c);
+        stbi_image_free(bytes.data);
+        if (!written) {
+            throw std::runtime_error("Failed to save image: " + fileName);
+        }
+        if (report) std::cout << "Image saved to " << fileName << std::endl;
+        return;
+    }
     if (!stbi_write_png(fileName.c_str(), w, h, c, data, w * c)) {
         throw std::runtime_error("Failed to save image: " + fileName);
     }
-    std::cout << "Image saved to " << fileName << std::endl;
+    if (report) std::cout << "Image saved to " << fileName << std::endl;
 }
 
 /**
@@ -78,6 +282,18 @@ void Image::save(std::string const& fileName) {
 void Image::set_data(unsigned char* NewData) {
     stbi_image_free(data);
     data = NewData;
+    const uint64_t previous = revision();
+    cache = std::make_shared<StatisticsCache>();
+    cache->revision = previous + 1;
+}
+
+/**
+ * @brief Sets the image data and its sample type.
+ * @author Zhikang Dong
+ */
+void Image::set_data(unsigned char* NewData, PixelType NewType) {
+    set_data(NewData);
+    type = NewType;
 }
 
 /**
@@ -86,6 +302,45 @@ void Image::set_data(unsigned char* NewData) {
  */
 void Image::set_channels(int NewChannels) {
     c = NewChannels;
+    invalidate_statistics();
+}
+
+/**
+ * @brief Gets the intensity statistics of the image, computing them on first use.
+ * @author Zhikang Dong
+ */
+ImageStatistics Image::statistics() const {
+    std::lock_guard<std::mutex> guard(cache->lock);
+    if (!cache->valid) {
+        if (type == PixelType::UInt8) {
+            cache->stats = Histogram::compute(data, w, h, c);
+        } else {
+            Image bytes = converted(PixelType::UInt8);
+            cache->stats = Histogram::compute(bytes.data, w, h, c);
+            stbi_image_free(bytes.data);
+        }
+        cache->valid = true;
+    }
+    return cache->stats;
+}
+
+/**
+ * @brief Discards the cached statistics.
+ * @author Zhikang Dong
+ */
+void Image::invalidate_statistics() {
+    std::lock_guard<std::mutex> guard(cache->lock);
+    cache->valid = false;
+    cache->revision++;
+}
+
+/**
+ * @brief Gets the revision of the pixel data.
+ * @author Zhikang Dong
+ */
+uint64_t Image::revision() const {
+    std::lock_guard<std::mutex> guard(cache->lock);
+    return cache->revision;
 }
 
 /**
@@ -111,4 +366,4 @@ void Image::save_old(std::string const& fileName) {
     else {
         std::cout << "Image saved successfully to file: " << fileName << std::endl;
     }
-}
\ No newline at end of file
+}
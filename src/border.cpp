@@ -0,0 +1,204 @@
+/**
+* @file border.cpp
+* @brief this file contains the implementation of the border-padded image and volume buffers.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "border.h"
+#include "parallel.h"
+
+BorderedImage::BorderedImage(int w, int h, int c, int border)
+    : w(w), h(h), c(c), b(std::max(border, 0)) {
+    if (w <= 0 || h <= 0 || c <= 0) {
+        throw std::runtime_error("Invalid size for a bordered image.");
+    }
+    rowStride = static_cast<size_t>(w + 2 * b) * c;
+    buffer = ScratchBuffer<unsigned char>(rowStride * (h + 2 * b));
+}
+
+BorderedImage::BorderedImage(const Image& img, int border, BorderMode mode, unsigned char value)
+    : BorderedImage(img.width(), img.height(), img.channels() * img.bytes_per_sample(), border) {
+    assign(img.get_data(), mode, value);
+}
+
+/**
+ * @details Rows are copied in parallel; the border is refilled afterwards.
+ * @author Zhikang Dong
+ */
+void BorderedImage::assign(const unsigned char* src, BorderMode mode, unsigned char value) {
+    const size_t bytes = static_cast<size_t>(w) * c;
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            std::memcpy(row(y), src + y * bytes, bytes);
+        }
+    }, 64);
+    fill_border(mode, value);
+}
+
+void BorderedImage::assign(const BorderedImage& other) {
+    if (other.w != w || other.h != h || other.c != c || other.b != b) {
+        throw std::runtime_error("Bordered images must have the same size to be copied.");
+    }
+    std::memcpy(buffer.data(), other.buffer.data(), buffer.size());
+}
+
+/**
+ * @details The left and right columns of each interior row are filled first, then whole padded rows are
+ * copied above and below, so the corners follow the same rule as the edges.
+ * @author Zhikang Dong
+ */
+void BorderedImage::fill_border(BorderMode mode, unsigned char value) {
+    if (b == 0) return;
+    for (int y = 0; y < h; ++y) {
+        unsigned char* r = row(y);
+        for (int x = -b; x < 0; ++x) {
+            int s = source_index(x, w, mode);
+            if (s < 0) std::memset(r + x * c, value, c);
+            else std::memcpy(r + x * c, r + s * c, c);
+        }
+        for (int x = w; x < w + b; ++x) {
+            int s = source_index(x, w, mode);
+            if (s < 0) std::memset(r + x * c, value, c);
+            else std::memcpy(r + x * c, r + s * c, c);
+        }
+    }
+
+    auto fill_row = [&](int y) {
+        int s = source_index(y, h, mode);
+        unsigned char* dst = row(y) - static_cast<size_t>(b) * c;
+        if (s < 0) std::memset(dst, value, rowStride);
+        else std::memcpy(dst, row(s) - static_cast<size_t>(b) * c, rowStride);
+    };
+    for (int y = -b; y < 0; ++y) fill_row(y);
+    for (int y = h; y < h + b; ++y) fill_row(y);
+}
+
+int BorderedImage::width() const {
+    return w;
+}
+
+int BorderedImage::height() const {
+    return h;
+}
+
+int BorderedImage::channels() const {
+    return c;
+}
+
+int BorderedImage::border() const {
+    return b;
+}
+
+size_t BorderedImage::stride() const {
+    return rowStride;
+}
+
+const unsigned char* BorderedImage::row(int y) const {
+    return buffer.data() + static_cast<size_t>(y + b) * rowStride + static_cast<size_t>(b) * c;
+}
+
+unsigned char* BorderedImage::row(int y) {
+    return buffer.data() + static_cast<size_t>(y + b) * rowStride + static_cast<size_t>(b) * c;
+}
+
+/**
+ * @details Mirroring folds repeatedly, so a border wider than the image still maps inside it.
+ * @author Zhikang Dong
+ */
+int BorderedImage::source_index(int i, int n, BorderMode mode) {
+    if (i >= 0 && i < n) return i;
+    switch (mode) {
+        case BorderMode::Replicate:
+            return std::min(std::max(i, 0), n - 1);
+        case BorderMode::Mirror: {
+            if (n == 1) return 0;
+            const int period = 2 * (n - 1);
+            i %= period;
+            if (i < 0) i += period;
+            return i < n ? i : period - i;
+        }
+        case BorderMode::Constant:
+            break;
+    }
+    return -1;
+}
+
+/**
+ * @details Slices are fetched through at(), so a lazy volume stays lazy, and copied and padded in parallel.
+ * @author Zhikang Dong
+ */
+BorderedVolume::BorderedVolume(const Volume& vol, int border, int borderZ, BorderMode mode, unsigned char value)
+    : bz(std::max(borderZ, 0)) {
+    d = vol.depth();
+    if (d == 0) {
+        throw std::runtime_error("Cannot pad an empty volume.");
+    }
+    const int w = vol.width(), h = vol.height(), c = vol.channels() * Image::bytes_per_sample(vol.pixel_type());
+
+    slices.reserve(d + 2 * bz);
+    for (int z = 0; z < d + 2 * bz; ++z) {
+        slices.emplace_back(w, h, c, border);
+    }
+    Parallel::for_range(0, d, [&](int z0, int z1) {
+        for (int z = z0; z < z1; ++z) {
+            std::shared_ptr<Image> img = vol.at(z);
+            if (img->width() != w || img->height() != h || img->channels() * img->bytes_per_sample() != c) {
+                throw std::runtime_error("All slices of a bordered volume must have the same size.");
+            }
+            slice(z).assign(img->get_data(), mode, value);
+        }
+    });
+    fill_padding_slices(mode, value);
+}
+
+/**
+ * @details Slice borders are refilled in parallel before the padding slices copy them.
+ * @author Zhikang Dong
+ */
+void BorderedVolume::fill_border(BorderMode mode, unsigned char value) {
+    Parallel::for_range(0, d, [&](int z0, int z1) {
+        for (int z = z0; z < z1; ++z) {
+            slice(z).fill_border(mode, value);
+        }
+    });
+    fill_padding_slices(mode, value);
+}
+
+void BorderedVolume::fill_padding_slices(BorderMode mode, unsigned char value) {
+    for (int z = -bz; z < d + bz; ++z) {
+        if (z >= 0 && z < d) continue;
+        int s = BorderedImage::source_index(z, d, mode);
+        if (s < 0) {
+            BorderedImage& pad = slice(z);
+            std::memset(pad.row(-pad.border()) - static_cast<size_t>(pad.border()) * pad.channels(), value,
+                        pad.stride() * (pad.height() + 2 * pad.border()));
+        } else {
+            slice(z).assign(slice(s));
+        }
+    }
+}
+
+int BorderedVolume::depth() const {
+    return d;
+}
+
+int BorderedVolume::borderZ() const {
+    return bz;
+}
+
+const BorderedImage& BorderedVolume::slice(int z) const {
+    return slices[z + bz];
+}
+
+BorderedImage& BorderedVolume::slice(int z) {
+    return slices[z + bz];
+}
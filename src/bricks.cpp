@@ -0,0 +1,155 @@
+/**
+* @file bricks.cpp
+* @brief this file contains the implementation of the grid of per-brick min, max and mean summaries of a volume.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include "bricks.h"
+#include "volume.h"
+#include "parallel.h"
+
+/**
+ * @details Records the size of the volume, then scans every layer of bricks.
+ * @author Zhikang Dong
+ */
+BrickGrid::BrickGrid(const Volume& vol, int size) : size(size) {
+    if (size <= 0) {
+        throw std::invalid_argument("The brick size must be positive");
+    }
+    w = vol.width();
+    h = vol.height();
+    d = vol.depth();
+    nx = (w + size - 1) / size;
+    ny = (h + size - 1) / size;
+    nz = (d + size - 1) / size;
+    bricks.assign(static_cast<size_t>(nx) * ny * nz, Brick{});
+    revisions.assign(d, 0);
+    scan(vol, std::vector<bool>(nz, true));
+}
+
+/**
+ * @details Checking a revision is one lock per slice, so an unchanged volume costs almost nothing.
+ * @author Zhikang Dong
+ */
+int BrickGrid::update(const Volume& vol) {
+    if (vol.width() != w || vol.height() != h || vol.depth() != d) {
+        *this = BrickGrid(vol, size);
+        return nz;
+    }
+    if (vol.lazy()) return 0;
+
+    std::vector<bool> layers(nz, false);
+    for (int z = 0; z < d; ++z) {
+        if (vol.at(z)->revision() != revisions[z]) layers[z / size] = true;
+    }
+    const int stale = static_cast<int>(std::count(layers.begin(), layers.end(), true));
+    if (stale > 0) scan(vol, layers);
+    return stale;
+}
+
+/**
+ * @details The slices of a layer are fetched together, then its bricks are reduced in parallel, each brick
+ * walking its rows slice by slice.
+ * @author Zhikang Dong
+ */
+void BrickGrid::scan(const Volume& vol, const std::vector<bool>& layers) {
+    const int c = vol.channels();
+    const size_t row = static_cast<size_t>(w) * c;
+    for (int bz = 0; bz < nz; ++bz) {
+        if (!layers[bz]) continue;
+        const int z0 = bz * size, z1 = std::min(z0 + size, d);
+        std::vector<std::shared_ptr<Image>> slices(z1 - z0);
+        Parallel::for_range(z0, z1, [&](int a, int b) {
+            for (int z = a; z < b; ++z) slices[z - z0] = vol.at(z);
+        }, 1);
+        for (int z = z0; z < z1; ++z) revisions[z] = slices[z - z0]->revision();
+
+        visit_pixel_type(vol.pixel_type(), [&](auto sample) {
+            using T = decltype(sample);
+            Parallel::for_range_2d(0, ny, 0, nx, [&](int by0, int by1, int bx0, int bx1) {
+                for (int by = by0; by < by1; ++by) {
+                    for (int bx = bx0; bx < bx1; ++bx) {
+                        const int y0 = by * size, y1 = std::min(y0 + size, h);
+                        const size_t i0 = static_cast<size_t>(bx) * size * c;
+                        const size_t i1 = std::min(static_cast<size_t>(bx + 1) * size, static_cast<size_t>(w)) * c;
+                        T lo = std::numeric_limits<T>::max(), hi = std::numeric_limits<T>::lowest();
+                        double sum = 0.0;
+                        for (const auto& slice : slices) {
+                            const T* data = slice->template pixels<T>();
+                            for (int y = y0; y < y1; ++y) {
+                                const T* src = data + y * row;
+                                for (size_t i = i0; i < i1; ++i) {
+                                    lo = std::min(lo, src[i]);
+                                    hi = std::max(hi, src[i]);
+                                    sum += src[i];
+                                }
+                            }
+                        }
+                        Brick& brick = bricks[(static_cast<size_t>(bz) * ny + by) * nx + bx];
+                        brick.min = lo;
+                        brick.max = hi;
+                        brick.mean = sum / (static_cast<double>(slices.size()) * (y1 - y0) * (i1 - i0));
+                    }
+                }
+            }, 1, 4);
+        });
+    }
+}
+
+int BrickGrid::brick_size() const {
+    return size;
+}
+
+int BrickGrid::bricks_x() const {
+    return nx;
+}
+
+int BrickGrid::bricks_y() const {
+    return ny;
+}
+
+int BrickGrid::bricks_z() const {
+    return nz;
+}
+
+const Brick& BrickGrid::operator()(int bx, int by, int bz) const {
+    return bricks[(static_cast<size_t>(bz) * ny + by) * nx + bx];
+}
+
+/**
+ * @details Reduces the summaries of the bricks the box touches.
+ * @author Zhikang Dong
+ */
+Brick BrickGrid::bounds(int x0, int x1, int y0, int y1, int z0, int z1) const {
+    Brick range;
+    range.min = std::numeric_limits<double>::infinity();
+    range.max = -std::numeric_limits<double>::infinity();
+    for (int bz = z0 / size; bz <= (z1 - 1) / size; ++bz) {
+        for (int by = y0 / size; by <= (y1 - 1) / size; ++by) {
+            for (int bx = x0 / size; bx <= (x1 - 1) / size; ++bx) {
+                const Brick& brick = (*this)(bx, by, bz);
+                range.min = std::min(range.min, brick.min);
+                range.max = std::max(range.max, brick.max);
+            }
+        }
+    }
+    return range;
+}
+
+bool BrickGrid::below(int bx, int by, int bz, double threshold) const {
+    return (*this)(bx, by, bz).max < threshold;
+}
+
+bool BrickGrid::above(int bx, int by, int bz, double threshold) const {
+    return (*this)(bx, by, bz).min >= threshold;
+}
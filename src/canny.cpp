@@ -0,0 +1,287 @@
+/**
+* @file canny.cpp
+* @brief this file contains the implementation of the tiled, multithreaded Canny edge detector.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "canny.h"
+#include "parallel.h"
+#include "scratch.h"
+
+/**
+ * @details Helper function that builds a 1D Gaussian kernel in 14-bit fixed point.
+ * The centre tap absorbs the rounding error so the weights always sum to exactly 1 << 14.
+ * @author Zhikang Dong
+ */
+static std::vector<int> fixed_point_gaussian(int kernelSize, double sigma) {
+    int center = kernelSize / 2;
+    std::vector<double> weights(kernelSize);
+    double sum = 0.0;
+    for (int i = 0; i < kernelSize; ++i) {
+        weights[i] = std::exp(-((i - center) * (i - center)) / (2.0 * sigma * sigma));
+        sum += weights[i];
+    }
+
+    std::vector<int> kernel(kernelSize);
+    int total = 0;
+    for (int i = 0; i < kernelSize; ++i) {
+        kernel[i] = static_cast<int>(std::lround(weights[i] / sum * (1 << 14)));
+        total += kernel[i];
+    }
+    kernel[center] += (1 << 14) - total;
+    return kernel;
+}
+
+/**
+ * @details The horizontal pass is computed for the band plus a halo of kernelSize / 2 rows on each side
+ * (border rows replicated), then the vertical pass accumulates whole rows so the inner loop vectorises.
+ * @author Zhikang Dong
+ */
+void Canny::smooth_rows(const unsigned char* src, unsigned char* dst, int w, int h, int y0, int y1,
+                        const std::vector<int>& kernel) {
+    const int r = static_cast<int>(kernel.size()) / 2;
+    const int k = static_cast<int>(kernel.size());
+    const int rows = y1 - y0 + 2 * r;
+    ScratchBuffer<unsigned char> tmp(static_cast<size_t>(rows) * w);
+    ScratchBuffer<int> acc(w);
+
+    // Horizontal pass, one output row per (clamped) source row of the band and its halo
+    for (int t = 0; t < rows; ++t) {
+        const unsigned char* in = src + static_cast<size_t>(std::clamp(y0 - r + t, 0, h - 1)) * w;
+        unsigned char* out = tmp.data() + static_cast<size_t>(t) * w;
+        for (int x = 0; x < w; ++x) {
+            if (x == r && w - r > r) {
+                // Branch-free interior
+                for (; x < w - r; ++x) {
+                    int sum = 0;
+                    for (int i = 0; i < k; ++i) sum += kernel[i] * in[x + i - r];
+                    out[x] = static_cast<unsigned char>((sum + (1 << 13)) >> 14);
+                }
+                if (x >= w) break;
+            }
+            int sum = 0;
+            for (int i = 0; i < k; ++i) sum += kernel[i] * in[std::clamp(x + i - r, 0, w - 1)];
+            out[x] = static_cast<unsigned char>((sum + (1 << 13)) >> 14);
+        }
+    }
+
+    // Vertical pass
+    for (int y = y0; y < y1; ++y) {
+        std::fill(acc.data(), acc.data() + w, 1 << 13);
+        for (int i = 0; i < k; ++i) {
+            const unsigned char* in = tmp.data() + static_cast<size_t>(y - y0 + i) * w;
+            const int weight = kernel[i];
+            for (int x = 0; x < w; ++x) acc[x] += weight * in[x];
+        }
+        unsigned char* out = dst + static_cast<size_t>(y) * w;
+        for (int x = 0; x < w; ++x) out[x] = static_cast<unsigned char>(acc[x] >> 14);
+    }
+}
+
+/**
+ * @details The derivatives and squared magnitudes only exist for the band and one halo row on either side.
+ * The magnitude rows are padded with a zero column on each side and zero rows outside the image, so the
+ * suppression loop never clamps. Directions are quantised to four sectors with integer tangent tests
+ * (tan 22.5 degrees ~ 27146 / 65536), and ties are broken towards the left/upper neighbour.
+ * @author Zhikang Dong
+ */
+void Canny::suppress_rows(const unsigned char* src, unsigned char* labels, int w, int h, int y0, int y1,
+                          int64_t low2, int64_t high2, GradientOperator op) {
+    const int g0 = std::max(y0 - 1, 0);
+    const int g1 = std::min(y1 + 1, h);
+    const size_t band = static_cast<size_t>(y1 - y0);
+    const int W = w + 2;
+
+    ScratchBuffer<int16_t> gx(static_cast<size_t>(g1 - g0) * w), gy(static_cast<size_t>(g1 - g0) * w);
+    ScratchBuffer<int32_t> mag((band + 2) * W);
+    std::fill(mag.data(), mag.data() + mag.size(), 0);
+
+    Gradient::derivative_rows(src, gx.data(), gy.data(), w, h, g0, g1, op);
+    for (int y = g0; y < g1; ++y) {
+        const int16_t* rx = gx.data() + static_cast<size_t>(y - g0) * w;
+        const int16_t* ry = gy.data() + static_cast<size_t>(y - g0) * w;
+        int32_t* m = mag.data() + static_cast<size_t>(y - y0 + 1) * W + 1;
+        for (int x = 0; x < w; ++x) m[x] = rx[x] * rx[x] + ry[x] * ry[x];
+    }
+
+    for (int y = y0; y < y1; ++y) {
+        const int16_t* rx = gx.data() + static_cast<size_t>(y - g0) * w;
+        const int16_t* ry = gy.data() + static_cast<size_t>(y - g0) * w;
+        const int32_t* mUp = mag.data() + static_cast<size_t>(y - y0) * W + 1;
+        const int32_t* mMid = mUp + W;
+        const int32_t* mDn = mMid + W;
+        unsigned char* out = labels + static_cast<size_t>(y) * w;
+
+        for (int x = 0; x < w; ++x) {
+            const int32_t m = mMid[x];
+            if (m <= low2) {
+                out[x] = NONE;
+                continue;
+            }
+            const int ax = std::abs(rx[x]);
+            const int ay = std::abs(ry[x]);
+            int32_t before, after;
+            if (ay * 65536 <= ax * 27146) {           // Horizontal gradient: compare left and right
+                before = mMid[x - 1];
+                after = mMid[x + 1];
+            } else if (ay * 27146 > ax * 65536) {     // Vertical gradient: compare up and down
+                before = mUp[x];
+                after = mDn[x];
+            } else if ((rx[x] > 0) == (ry[x] > 0)) {  // Gradient along the main diagonal
+                before = mUp[x - 1];
+                after = mDn[x + 1];
+            } else {                                  // Gradient along the anti-diagonal
+                before = mUp[x + 1];
+                after = mDn[x - 1];
+            }
+            if (m > before && m >= after) {
+                out[x] = (m > high2) ? STRONG : WEAK;
+            } else {
+                out[x] = NONE;
+            }
+        }
+    }
+}
+
+/**
+ * @details Depth-first flood through weak pixels, restricted to the rows of one band so that bands can be
+ * flooded concurrently without sharing any writes.
+ * @author Zhikang Dong
+ */
+void Canny::flood_band(unsigned char* labels, int w, int y0, int y1, std::vector<int64_t>& stack) {
+    while (!stack.empty()) {
+        int64_t idx = stack.back();
+        stack.pop_back();
+        int y = static_cast<int>(idx / w);
+        int x = static_cast<int>(idx % w);
+        for (int ny = std::max(y - 1, y0); ny <= std::min(y + 1, y1 - 1); ++ny) {
+            for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, w - 1); ++nx) {
+                int64_t n = static_cast<int64_t>(ny) * w + nx;
+                if (labels[n] == WEAK) {
+                    labels[n] = STRONG;
+                    stack.push_back(n);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @details Frontier-based parallel hysteresis. Every band first floods from its own strong pixels. Then, in
+ * a read-only pass, each band collects the weak pixels on its first and last row that touch a strong pixel
+ * in the neighbouring band; those become the seeds of the next flood round. Rounds repeat until no band
+ * boundary produces a seed, which is usually after one or two rounds.
+ * @author Zhikang Dong
+ */
+void Canny::hysteresis(unsigned char* labels, int w, int h) {
+    const int bands = std::min(h, Parallel::num_threads());
+    std::vector<int> bounds(bands + 1);
+    for (int i = 0; i <= bands; ++i) {
+        bounds[i] = static_cast<int>(static_cast<long long>(h) * i / bands);
+    }
+    std::vector<std::vector<int64_t>> seeds(bands);
+
+    // Round 0: every strong pixel is a seed of its own band
+    Parallel::for_range(0, bands, [&](int b0, int b1) {
+        for (int b = b0; b < b1; ++b) {
+            std::vector<int64_t> stack;
+            for (int64_t i = static_cast<int64_t>(bounds[b]) * w; i < static_cast<int64_t>(bounds[b + 1]) * w; ++i) {
+                if (labels[i] == STRONG) stack.push_back(i);
+            }
+            flood_band(labels, w, bounds[b], bounds[b + 1], stack);
+        }
+    });
+
+    // Helper that looks for strong pixels in row y around column x
+    auto touches_strong = [&](int y, int x) {
+        const unsigned char* row = labels + static_cast<size_t>(y) * w;
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, w - 1); ++nx) {
+            if (row[nx] == STRONG) return true;
+        }
+        return false;
+    };
+
+    while (true) {
+        Parallel::for_range(0, bands, [&](int b0, int b1) {
+            for (int b = b0; b < b1; ++b) {
+                seeds[b].clear();
+                int top = bounds[b];
+                int bottom = bounds[b + 1] - 1;
+                for (int x = 0; x < w; ++x) {
+                    if (b > 0 && labels[static_cast<size_t>(top) * w + x] == WEAK && touches_strong(top - 1, x)) {
+                        seeds[b].push_back(static_cast<int64_t>(top) * w + x);
+                    }
+                    if (b < bands - 1 && labels[static_cast<size_t>(bottom) * w + x] == WEAK && touches_strong(bottom + 1, x)) {
+                        seeds[b].push_back(static_cast<int64_t>(bottom) * w + x);
+                    }
+                }
+            }
+        });
+
+        size_t total = 0;
+        for (const auto& s : seeds) total += s.size();
+        if (total == 0) break;
+
+        Parallel::for_range(0, bands, [&](int b0, int b1) {
+            for (int b = b0; b < b1; ++b) {
+                for (int64_t i : seeds[b]) labels[i] = STRONG;
+                flood_band(labels, w, bounds[b], bounds[b + 1], seeds[b]);
+            }
+        });
+    }
+}
+
+/**
+ * @details Runs the four Canny stages. Smoothing and suppression run over row bands in parallel, the label map
+ * is written straight into dst and finally mapped to 0/255 in place.
+ * @author Zhikang Dong
+ */
+void Canny::detect(const unsigned char* src, unsigned char* dst, int w, int h,
+                   int lowThreshold, int highThreshold, double sigma, int kernelSize, GradientOperator op) {
+    if (w <= 0 || h <= 0) return;
+    if (lowThreshold > highThreshold) std::swap(lowThreshold, highThreshold);
+    // Rows per strip: a thread walks its chunk strip by strip so the band buffers stay cache sized
+    const int grain = 16;
+    const int strip = 64;
+
+    // Stage 1: Gaussian smoothing
+    std::vector<unsigned char> smoothed;
+    const unsigned char* input = src;
+    if (sigma > 0.0 && kernelSize > 1) {
+        std::vector<int> kernel = fixed_point_gaussian(kernelSize | 1, sigma);
+        smoothed.resize(static_cast<size_t>(w) * h);
+        Parallel::for_range(0, h, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y += strip) {
+                smooth_rows(src, smoothed.data(), w, h, y, std::min(y + strip, y1), kernel);
+            }
+        }, grain);
+        input = smoothed.data();
+    }
+
+    // Stages 2 and 3: gradient with direction and non-maximum suppression, fused per band
+    const int64_t low2 = static_cast<int64_t>(lowThreshold) * lowThreshold;
+    const int64_t high2 = static_cast<int64_t>(highThreshold) * highThreshold;
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y += strip) {
+            suppress_rows(input, dst, w, h, y, std::min(y + strip, y1), low2, high2, op);
+        }
+    }, grain);
+
+    // Stage 4: double-threshold hysteresis
+    hysteresis(dst, w, h);
+
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        for (size_t i = static_cast<size_t>(y0) * w; i < static_cast<size_t>(y1) * w; ++i) {
+            dst[i] = (dst[i] == STRONG) ? 255 : 0;
+        }
+    }, grain);
+}
@@ -0,0 +1,228 @@
+/**
+* @file clahe.cpp
+* @brief this file contains the implementation of the tiled contrast limited adaptive histogram equalisation (CLAHE) in 2D and 3D.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cmath>
+#include "clahe.h"
+#include "parallel.h"
+
+/**
+ * @details Tiles are ceil(length / tiles) long, so only the last one can be shorter. Coordinates before the first
+ * centre or after the last one use that tile alone.
+ * @author Zhikang Dong
+ */
+Clahe::Axis Clahe::axis(int length, int tiles) {
+    Axis a;
+    tiles = std::min(std::max(tiles, 1), length);
+    a.size = (length + tiles - 1) / tiles;
+    a.tiles = (length + a.size - 1) / a.size;
+    a.lo.resize(length);
+    a.hi.resize(length);
+    a.weight.resize(length);
+
+    for (int i = 0; i < length; ++i) {
+        float f = (i + 0.5f) / a.size - 0.5f;
+        int lo = static_cast<int>(std::floor(f));
+        if (lo < 0) {
+            a.lo[i] = a.hi[i] = 0;
+            a.weight[i] = 0.0f;
+        } else if (lo >= a.tiles - 1) {
+            a.lo[i] = a.hi[i] = a.tiles - 1;
+            a.weight[i] = 0.0f;
+        } else {
+            a.lo[i] = lo;
+            a.hi[i] = lo + 1;
+            a.weight[i] = f - lo;
+        }
+    }
+    return a;
+}
+
+/**
+ * @details Bins above the limit are cut and the excess is added evenly to every bin, with the remainder spread
+ * at a regular step; the LUT is the scaled cumulative histogram.
+ * @author Zhikang Dong
+ */
+void Clahe::build_lut(uint32_t* hist, uint64_t count, double clipLimit, unsigned char* lut) {
+    if (count == 0) {
+        for (int v = 0; v < 256; ++v) lut[v] = static_cast<unsigned char>(v);
+        return;
+    }
+
+    if (clipLimit > 0) {
+        uint64_t limit = std::max<uint64_t>(1, static_cast<uint64_t>(clipLimit * count / 256));
+        uint64_t excess = 0;
+        for (int v = 0; v < 256; ++v) {
+            if (hist[v] > limit) {
+                excess += hist[v] - limit;
+                hist[v] = static_cast<uint32_t>(limit);
+            }
+        }
+
+        uint32_t add = static_cast<uint32_t>(excess / 256);
+        uint32_t residual = static_cast<uint32_t>(excess % 256);
+        for (int v = 0; v < 256; ++v) {
+            hist[v] += add;
+        }
+        if (residual > 0) {
+            int step = std::max(256 / static_cast<int>(residual), 1);
+            for (int v = 0; v < 256 && residual > 0; v += step, --residual) {
+                hist[v]++;
+            }
+        }
+    }
+
+    const double scale = 255.0 / static_cast<double>(count);
+    uint64_t cdf = 0;
+    for (int v = 0; v < 256; ++v) {
+        cdf += hist[v];
+        lut[v] = static_cast<unsigned char>(std::min(255.0, cdf * scale + 0.5));
+    }
+}
+
+/**
+ * @details Histograms are built a row of tiles at a time in parallel, reading the image row by row; the blend
+ * then runs over rows in parallel. All LUTs exist before the first write, so the image is updated in place.
+ * @author Zhikang Dong
+ */
+void Clahe::equalize(unsigned char* data, int w, int h, int stride, int tilesX, int tilesY, double clipLimit) {
+    if (w <= 0 || h <= 0) return;
+    const Axis ax = axis(w, tilesX);
+    const Axis ay = axis(h, tilesY);
+    std::vector<unsigned char> luts(static_cast<size_t>(ax.tiles) * ay.tiles * 256);
+
+    Parallel::for_range(0, ay.tiles, [&](int j0, int j1) {
+        std::vector<uint32_t> hist(static_cast<size_t>(ax.tiles) * 256);
+        for (int j = j0; j < j1; ++j) {
+            std::fill(hist.begin(), hist.end(), 0u);
+            const int y0 = j * ay.size;
+            const int y1 = std::min(y0 + ay.size, h);
+            for (int y = y0; y < y1; ++y) {
+                const unsigned char* row = data + static_cast<size_t>(y) * w * stride;
+                for (int i = 0; i < ax.tiles; ++i) {
+                    uint32_t* bins = hist.data() + i * 256;
+                    const int x1 = std::min((i + 1) * ax.size, w);
+                    for (int x = i * ax.size; x < x1; ++x) {
+                        bins[row[static_cast<size_t>(x) * stride]]++;
+                    }
+                }
+            }
+            for (int i = 0; i < ax.tiles; ++i) {
+                const uint64_t count = static_cast<uint64_t>(std::min((i + 1) * ax.size, w) - i * ax.size) * (y1 - y0);
+                build_lut(hist.data() + i * 256, count, clipLimit, luts.data() + (static_cast<size_t>(j) * ax.tiles + i) * 256);
+            }
+        }
+    });
+
+    // Column offsets into a row of LUTs, shared by every row
+    std::vector<int> left(w), right(w);
+    for (int x = 0; x < w; ++x) {
+        left[x] = ax.lo[x] * 256;
+        right[x] = ax.hi[x] * 256;
+    }
+
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            const unsigned char* top = luts.data() + static_cast<size_t>(ay.lo[y]) * ax.tiles * 256;
+            const unsigned char* bottom = luts.data() + static_cast<size_t>(ay.hi[y]) * ax.tiles * 256;
+            const float wy = ay.weight[y];
+            unsigned char* row = data + static_cast<size_t>(y) * w * stride;
+            for (int x = 0; x < w; ++x) {
+                const int v = row[static_cast<size_t>(x) * stride];
+                const float wx = ax.weight[x];
+                const float t = top[left[x] + v] + wx * (top[right[x] + v] - top[left[x] + v]);
+                const float b = bottom[left[x] + v] + wx * (bottom[right[x] + v] - bottom[left[x] + v]);
+                row[static_cast<size_t>(x) * stride] = static_cast<unsigned char>(t + wy * (b - t) + 0.5f);
+            }
+        }
+    }, 16);
+}
+
+/**
+ * @details Each task owns one (z block, row of tiles) pair and streams the slices of its block into that pair's
+ * histograms, so every voxel is read once and no two tasks share a histogram. The blend runs over slices in parallel:
+ * the LUTs of the two nearest z blocks are mixed once per slice, then each voxel is interpolated bilinearly.
+ * @author Zhikang Dong
+ */
+void Clahe::equalize_volume(const std::vector<unsigned char*>& slices, int w, int h, int stride,
+                            int tilesX, int tilesY, int tilesZ, double clipLimit) {
+    const int depth = static_cast<int>(slices.size());
+    if (w <= 0 || h <= 0 || depth == 0) return;
+    const Axis ax = axis(w, tilesX);
+    const Axis ay = axis(h, tilesY);
+    const Axis az = axis(depth, tilesZ);
+    const size_t plane = static_cast<size_t>(ax.tiles) * ay.tiles;
+    std::vector<unsigned char> luts(plane * az.tiles * 256);
+
+    Parallel::for_range(0, az.tiles * ay.tiles, [&](int t0, int t1) {
+        std::vector<uint32_t> hist(static_cast<size_t>(ax.tiles) * 256);
+        for (int t = t0; t < t1; ++t) {
+            const int k = t / ay.tiles;
+            const int j = t % ay.tiles;
+            const int z0 = k * az.size, z1 = std::min(z0 + az.size, depth);
+            const int y0 = j * ay.size, y1 = std::min(y0 + ay.size, h);
+            std::fill(hist.begin(), hist.end(), 0u);
+
+            for (int z = z0; z < z1; ++z) {
+                for (int y = y0; y < y1; ++y) {
+                    const unsigned char* row = slices[z] + static_cast<size_t>(y) * w * stride;
+                    for (int i = 0; i < ax.tiles; ++i) {
+                        uint32_t* bins = hist.data() + i * 256;
+                        const int x1 = std::min((i + 1) * ax.size, w);
+                        for (int x = i * ax.size; x < x1; ++x) {
+                            bins[row[static_cast<size_t>(x) * stride]]++;
+                        }
+                    }
+                }
+            }
+            for (int i = 0; i < ax.tiles; ++i) {
+                const uint64_t count = static_cast<uint64_t>(std::min((i + 1) * ax.size, w) - i * ax.size) * (y1 - y0) * (z1 - z0);
+                build_lut(hist.data() + i * 256, count, clipLimit,
+                          luts.data() + ((static_cast<size_t>(k) * ay.tiles + j) * ax.tiles + i) * 256);
+            }
+        }
+    });
+
+    std::vector<int> left(w), right(w);
+    for (int x = 0; x < w; ++x) {
+        left[x] = ax.lo[x] * 256;
+        right[x] = ax.hi[x] * 256;
+    }
+
+    Parallel::for_range(0, depth, [&](int s0, int s1) {
+        std::vector<float> blended(plane * 256);
+        for (int z = s0; z < s1; ++z) {
+            // Blend the two z blocks once per slice, leaving a bilinear blend per pixel
+            const unsigned char* front = luts.data() + static_cast<size_t>(az.lo[z]) * plane * 256;
+            const unsigned char* back = luts.data() + static_cast<size_t>(az.hi[z]) * plane * 256;
+            const float wz = az.weight[z];
+            for (size_t i = 0; i < plane * 256; ++i) {
+                blended[i] = front[i] + wz * (back[i] - front[i]);
+            }
+
+            for (int y = 0; y < h; ++y) {
+                const float* top = blended.data() + static_cast<size_t>(ay.lo[y]) * ax.tiles * 256;
+                const float* bottom = blended.data() + static_cast<size_t>(ay.hi[y]) * ax.tiles * 256;
+                const float wy = ay.weight[y];
+                unsigned char* row = slices[z] + static_cast<size_t>(y) * w * stride;
+                for (int x = 0; x < w; ++x) {
+                    const int v = row[static_cast<size_t>(x) * stride];
+                    const int l = left[x] + v, r = right[x] + v;
+                    const float wx = ax.weight[x];
+                    const float t = top[l] + wx * (top[r] - top[l]);
+                    const float b = bottom[l] + wx * (bottom[r] - bottom[l]);
+                    row[static_cast<size_t>(x) * stride] = static_cast<unsigned char>(t + wy * (b - t) + 0.5f);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,412 @@
+/**
+* @file colorspace.cpp
+* @brief this file contains the implementation of the branch-free colour space conversion kernels (Gray, HSV, HSL).
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cmath>
+#include "colorspace.h"
+#include "dispatch.h"
+
+/**
+ * @brief Number of pixels converted per planar block, small enough for the block to stay in L1.
+ */
+static constexpr size_t BLOCK = 64;
+
+/**
+ * @details Helper that narrows a float the way the original static_cast<unsigned char> did on x86:
+ * truncate towards zero to a 32-bit integer and keep the low byte (so small negative hues wrap).
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE unsigned char to_byte(float v) {
+    return static_cast<unsigned char>(static_cast<int>(v));
+}
+
+/**
+ * @details Helper that computes 1 - |fmod(v, 2) - 1| for v >= 0 exactly, without library calls.
+ * fmod(v, 2) = v - 2 * trunc(v / 2) is exact, and 1 - |f - 1| is either f or 2 - f, both exact as well,
+ * so the result equals the original double precision expression bit for bit.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static KERNEL_INLINE T triangle(T v) {
+    T f = v - T(2) * static_cast<T>(static_cast<int>(v * T(0.5)));
+    return (f < T(1)) ? f : T(2) - f;
+}
+
+/**
+ * @details Splits a block of interleaved pixels into three planar float arrays.
+ * @author Zhikang Dong
+ */
+template <int C>
+static KERNEL_INLINE void load_block(const unsigned char* px, size_t n, float* a, float* b, float* c) {
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = px[i * C];
+        b[i] = px[i * C + 1];
+        c[i] = px[i * C + 2];
+    }
+}
+
+/**
+ * @details Writes three planar byte arrays back into a block of interleaved pixels, leaving alpha untouched.
+ * @author Zhikang Dong
+ */
+template <int C>
+static KERNEL_INLINE void store_block(unsigned char* px, size_t n, const unsigned char* a, const unsigned char* b, const unsigned char* c) {
+    for (size_t i = 0; i < n; ++i) {
+        px[i * C] = a[i];
+        px[i * C + 1] = b[i];
+        px[i * C + 2] = c[i];
+    }
+}
+
+/**
+ * @details Fixed-point luma. N = 2126 r + 7152 g + 722 b is the exact luma times 10000, so N / 10000 is the exact
+ * floor. The original double expression only disagrees when N is a multiple of 10000 (the double sum can land
+ * just below the integer), so blocks that contain such a pixel re-evaluate those pixels with the original formula.
+ * @author Zhikang Dong
+ */
+template <int C>
+static KERNEL_INLINE void gray_kernel(const unsigned char* src, unsigned char* dst, size_t n) {
+    for (size_t start = 0; start < n; start += BLOCK) {
+        const size_t len = std::min(BLOCK, n - start);
+        const unsigned char* px = src + start * C;
+        unsigned char* out = dst + start;
+
+        int exact = 0;
+        for (size_t i = 0; i < len; ++i) {
+            int N = 2126 * px[i * C] + 7152 * px[i * C + 1] + 722 * px[i * C + 2];
+            int q = N / 10000;
+            out[i] = static_cast<unsigned char>(q);
+            exact |= (q * 10000 == N);
+        }
+        if (!exact) continue;
+
+        for (size_t i = 0; i < len; ++i) {
+            unsigned char r = px[i * C], g = px[i * C + 1], b = px[i * C + 2];
+            if ((2126 * r + 7152 * g + 722 * b) % 10000 == 0) {
+                out[i] = static_cast<unsigned char>(0.2126 * r + 0.7152 * g + 0.0722 * b);
+            }
+        }
+    }
+}
+
+/**
+ * @details Computes the hue (in degrees) shared by HSV and HSL from normalised channels, with selects instead of
+ * the original if/else chain. Denominators are replaced by 1 where the original would not have divided.
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE float hue(float R, float G, float B, float Cmax, float delta) {
+    float d = (delta == 0) ? 1.0f : delta;
+    float hR = 60 * ((G - B) / d);
+    float hG = 60 * ((B - R) / d + 2);
+    float hB = 60 * ((R - G) / d + 4);
+    float H = (Cmax == R) ? hR : ((Cmax == G) ? hG : hB);
+    return (delta == 0) ? 0.0f : H;
+}
+
+/**
+ * @details RGB to HSV on one block of planar channels.
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE void hsv_forward(size_t len, const float* r, const float* g, const float* b,
+                               unsigned char* h8, unsigned char* s8, unsigned char* v8) {
+    for (size_t i = 0; i < len; ++i) {
+        float R = r[i] / 255.0f;
+        float G = g[i] / 255.0f;
+        float B = b[i] / 255.0f;
+        float Cmax = std::max(std::max(R, G), B);
+        float Cmin = std::min(std::min(R, G), B);
+        float delta = Cmax - Cmin;
+        float H = hue(R, G, B, Cmax, delta);
+        float S = (Cmax == 0) ? 0.0f : delta / ((Cmax == 0) ? 1.0f : Cmax);
+        h8[i] = to_byte(H / 360 * 255);
+        s8[i] = to_byte(S * 255);
+        v8[i] = to_byte(Cmax * 255);
+    }
+}
+
+/**
+ * @details Picks the (R, G, B) permutation of (C, X, 0) for the 60 degree sector of the hue without branches.
+ * Hues at or above top fall in no sector and give zero, which matches the HSL2RGB chain for H == 360;
+ * HSV2RGB passes an unreachable top so that H == 360 stays in the last sector like its else branch.
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE void sector_select(float H, float top, float C, float X, float& R, float& G, float& B) {
+    bool s0 = H < 60;
+    bool s1 = H >= 60 && H < 120;
+    bool s2 = H >= 120 && H < 180;
+    bool s3 = H >= 180 && H < 240;
+    bool s4 = H >= 240 && H < 300;
+    bool s5 = H >= 300 && H < top;
+    R = (s0 || s5) ? C : ((s1 || s4) ? X : 0.0f);
+    G = (s1 || s2) ? C : ((s0 || s3) ? X : 0.0f);
+    B = (s3 || s4) ? C : ((s2 || s5) ? X : 0.0f);
+}
+
+/**
+ * @details HSV to RGB on one block of planar channels.
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE void hsv_inverse(size_t len, const float* h, const float* s, const float* v,
+                               unsigned char* r8, unsigned char* g8, unsigned char* b8) {
+    for (size_t i = 0; i < len; ++i) {
+        float H = h[i] / 255.0f * 360;
+        float S = s[i] / 255.0f;
+        float V = v[i] / 255.0f;
+        float Cc = V * S;
+        float X = Cc * triangle(H / 60);
+        float m = V - Cc;
+        float R, G, B;
+        sector_select(H, 1000.0f, Cc, X, R, G, B);
+        r8[i] = to_byte((R + m) * 255);
+        g8[i] = to_byte((G + m) * 255);
+        b8[i] = to_byte((B + m) * 255);
+    }
+}
+
+/**
+ * @details RGB to HSL on one block of planar channels.
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE void hsl_forward(size_t len, const float* r, const float* g, const float* b,
+                               unsigned char* h8, unsigned char* s8, unsigned char* l8) {
+    for (size_t i = 0; i < len; ++i) {
+        float R = r[i] / 255.0f;
+        float G = g[i] / 255.0f;
+        float B = b[i] / 255.0f;
+        float max = std::max(std::max(R, G), B);
+        float min = std::min(std::min(R, G), B);
+        float delta = max - min;
+        float L = (max + min) / 2;
+        float low = (delta == 0) ? 1.0f : (max + min);
+        float high = (delta == 0) ? 1.0f : (2 - max - min);
+        float S = (delta == 0) ? 0.0f : ((L < 0.5) ? (delta / low) : (delta / high));
+        float H = hue(R, G, B, max, delta);
+        h8[i] = to_byte((H / 360) * 255);
+        s8[i] = to_byte(S * 255);
+        l8[i] = to_byte(L * 255);
+    }
+}
+
+/**
+ * @details HSL to RGB on one block of planar channels.
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE void hsl_inverse(size_t len, const float* h, const float* s, const float* l,
+                               unsigned char* r8, unsigned char* g8, unsigned char* b8) {
+    for (size_t i = 0; i < len; ++i) {
+        float H = h[i] / 255.0f * 360;
+        float S = s[i] / 255.0f;
+        float L = l[i] / 255.0f;
+        float Cc = (1 - std::fabs(2 * L - 1)) * S;
+        float X = static_cast<float>(Cc * triangle(H / 60.0));
+        float m = L - Cc / 2;
+        float R, G, B;
+        sector_select(H, 360.0f, Cc, X, R, G, B);
+        r8[i] = to_byte((R + m) * 255);
+        g8[i] = to_byte((G + m) * 255);
+        b8[i] = to_byte((B + m) * 255);
+    }
+}
+
+/**
+ * @brief Signature shared by the four planar block conversions.
+ */
+using BlockConversion = void (*)(size_t, const float*, const float*, const float*,
+                                 unsigned char*, unsigned char*, unsigned char*);
+
+/**
+ * @details Converts a run of interleaved pixels in place, one planar block at a time.
+ * @author Zhikang Dong
+ */
+template <int C, BlockConversion F>
+static KERNEL_INLINE void convert_kernel(unsigned char* data, size_t n) {
+    float a[BLOCK], b[BLOCK], c[BLOCK];
+    unsigned char a8[BLOCK], b8[BLOCK], c8[BLOCK];
+    for (size_t start = 0; start < n; start += BLOCK) {
+        const size_t len = std::min(BLOCK, n - start);
+        unsigned char* px = data + start * C;
+        load_block<C>(px, len, a, b, c);
+        F(len, a, b, c, a8, b8, c8);
+        store_block<C>(px, len, a8, b8, c8);
+    }
+}
+
+/**
+ * @details Converts a block forwards, maps its third channel (V or L) through the LUT and converts it back,
+ * so the equalised RGB values are exactly those of the three separate passes but the pixels are touched once.
+ * @author Zhikang Dong
+ */
+template <int C, BlockConversion Forward, BlockConversion Inverse>
+static KERNEL_INLINE void remap_kernel(unsigned char* data, size_t n, const unsigned char* lut) {
+    float a[BLOCK], b[BLOCK], c[BLOCK];
+    unsigned char a8[BLOCK], b8[BLOCK], c8[BLOCK];
+    for (size_t start = 0; start < n; start += BLOCK) {
+        const size_t len = std::min(BLOCK, n - start);
+        unsigned char* px = data + start * C;
+        load_block<C>(px, len, a, b, c);
+        Forward(len, a, b, c, a8, b8, c8);
+        for (size_t i = 0; i < len; ++i) {
+            a[i] = a8[i];
+            b[i] = b8[i];
+            c[i] = lut[c8[i]];
+        }
+        Inverse(len, a, b, c, a8, b8, c8);
+        store_block<C>(px, len, a8, b8, c8);
+    }
+}
+
+/**
+ * @details The V (HSV) or L (HSL) byte of a single RGB pixel, with exactly the float operations of the
+ * forward conversions, so it can be read without converting the image.
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE unsigned char value_byte(unsigned char r, unsigned char g, unsigned char b, ColorModel model) {
+    float max = std::max(std::max(r, g), b) / 255.0f;
+    if (model == ColorModel::HSV) {
+        return to_byte(max * 255);
+    }
+    float min = std::min(std::min(r, g), b) / 255.0f;
+    return to_byte(((max + min) / 2) * 255);
+}
+
+/**
+ * @details Histogram of the V or L byte of a run of pixels.
+ * @author Zhikang Dong
+ */
+template <int C>
+static void histogram_kernel(const unsigned char* data, size_t n, ColorModel model, uint64_t* hist) {
+    for (size_t i = 0; i < n; ++i) {
+        hist[value_byte(data[i * C], data[i * C + 1], data[i * C + 2], model)]++;
+    }
+}
+
+/**
+ * @details Extracts the V or L byte of a run of pixels into a single channel output.
+ * @author Zhikang Dong
+ */
+template <int C>
+static void value_kernel(const unsigned char* src, unsigned char* dst, size_t n, ColorModel model) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = value_byte(src[i * C], src[i * C + 1], src[i * C + 2], model);
+    }
+}
+
+/**
+ * @details Binarises the V or L byte of a run of pixels into a single channel output.
+ * @author Zhikang Dong
+ */
+template <int C>
+static void threshold_kernel(const unsigned char* src, unsigned char* dst, size_t n, ColorModel model, int threshold) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = (value_byte(src[i * C], src[i * C + 1], src[i * C + 2], model) > threshold) ? 255 : 0;
+    }
+}
+
+/**
+ * @details Dispatches to the CPU-specific variant of the 3 or 4 channel luma kernel.
+ * @author Zhikang Dong
+ */
+void ColorSpace::rgb_to_gray(const unsigned char* src, unsigned char* dst, size_t n, int channels) {
+    static const auto gray3 = Dispatch::bind("rgb_to_gray<3>", kernel_set<gray_kernel<3>>());
+    static const auto gray4 = Dispatch::bind("rgb_to_gray<4>", kernel_set<gray_kernel<4>>());
+    if (channels == 4) gray4(src, dst, n);
+    else gray3(src, dst, n);
+}
+
+/**
+ * @details Dispatches to the CPU-specific variant of the 3 or 4 channel HSV kernel.
+ * @author Zhikang Dong
+ */
+void ColorSpace::rgb_to_hsv(unsigned char* data, size_t n, int channels) {
+    static const auto kernel3 = Dispatch::bind("rgb_to_hsv<3>", kernel_set<convert_kernel<3, hsv_forward>>());
+    static const auto kernel4 = Dispatch::bind("rgb_to_hsv<4>", kernel_set<convert_kernel<4, hsv_forward>>());
+    if (channels == 4) kernel4(data, n);
+    else kernel3(data, n);
+}
+
+/**
+ * @details Dispatches to the CPU-specific variant of the 3 or 4 channel inverse HSV kernel.
+ * @author Zhikang Dong
+ */
+void ColorSpace::hsv_to_rgb(unsigned char* data, size_t n, int channels) {
+    static const auto kernel3 = Dispatch::bind("hsv_to_rgb<3>", kernel_set<convert_kernel<3, hsv_inverse>>());
+    static const auto kernel4 = Dispatch::bind("hsv_to_rgb<4>", kernel_set<convert_kernel<4, hsv_inverse>>());
+    if (channels == 4) kernel4(data, n);
+    else kernel3(data, n);
+}
+
+/**
+ * @details Dispatches to the CPU-specific variant of the 3 or 4 channel HSL kernel.
+ * @author Zhikang Dong
+ */
+void ColorSpace::rgb_to_hsl(unsigned char* data, size_t n, int channels) {
+    static const auto kernel3 = Dispatch::bind("rgb_to_hsl<3>", kernel_set<convert_kernel<3, hsl_forward>>());
+    static const auto kernel4 = Dispatch::bind("rgb_to_hsl<4>", kernel_set<convert_kernel<4, hsl_forward>>());
+    if (channels == 4) kernel4(data, n);
+    else kernel3(data, n);
+}
+
+/**
+ * @details Dispatches to the CPU-specific variant of the 3 or 4 channel inverse HSL kernel.
+ * @author Zhikang Dong
+ */
+void ColorSpace::hsl_to_rgb(unsigned char* data, size_t n, int channels) {
+    static const auto kernel3 = Dispatch::bind("hsl_to_rgb<3>", kernel_set<convert_kernel<3, hsl_inverse>>());
+    static const auto kernel4 = Dispatch::bind("hsl_to_rgb<4>", kernel_set<convert_kernel<4, hsl_inverse>>());
+    if (channels == 4) kernel4(data, n);
+    else kernel3(data, n);
+}
+
+/**
+ * @details Dispatches to the 3 or 4 channel instantiation of the V/L histogram kernel.
+ * @author Zhikang Dong
+ */
+void ColorSpace::value_histogram(const unsigned char* data, size_t n, int channels, ColorModel model, uint64_t* hist) {
+    if (channels == 4) histogram_kernel<4>(data, n, model, hist);
+    else histogram_kernel<3>(data, n, model, hist);
+}
+
+/**
+ * @details Dispatches to the CPU-specific variant of the fused forward, remap and inverse kernel of the requested colour model.
+ * @author Zhikang Dong
+ */
+void ColorSpace::remap_value(unsigned char* data, size_t n, int channels, ColorModel model, const unsigned char* lut) {
+    static const auto hsv3 = Dispatch::bind("remap_hsv<3>", kernel_set<remap_kernel<3, hsv_forward, hsv_inverse>>());
+    static const auto hsv4 = Dispatch::bind("remap_hsv<4>", kernel_set<remap_kernel<4, hsv_forward, hsv_inverse>>());
+    static const auto hsl3 = Dispatch::bind("remap_hsl<3>", kernel_set<remap_kernel<3, hsl_forward, hsl_inverse>>());
+    static const auto hsl4 = Dispatch::bind("remap_hsl<4>", kernel_set<remap_kernel<4, hsl_forward, hsl_inverse>>());
+    if (model == ColorModel::HSV) {
+        if (channels == 4) hsv4(data, n, lut);
+        else hsv3(data, n, lut);
+    } else {
+        if (channels == 4) hsl4(data, n, lut);
+        else hsl3(data, n, lut);
+    }
+}
+
+/**
+ * @details Dispatches to the 3 or 4 channel instantiation of the V/L extraction kernel.
+ * @author Zhikang Dong
+ */
+void ColorSpace::value_plane(const unsigned char* src, unsigned char* dst, size_t n, int channels, ColorModel model) {
+    if (channels == 4) value_kernel<4>(src, dst, n, model);
+    else value_kernel<3>(src, dst, n, model);
+}
+
+/**
+ * @details Dispatches to the 3 or 4 channel instantiation of the V/L threshold kernel.
+ * @author Zhikang Dong
+ */
+void ColorSpace::value_threshold(const unsigned char* src, unsigned char* dst, size_t n, int channels, ColorModel model, int threshold) {
+    if (channels == 4) threshold_kernel<4>(src, dst, n, model, threshold);
+    else threshold_kernel<3>(src, dst, n, model, threshold);
+}
@@ -0,0 +1,184 @@
+/**
+* @file dirindex.cpp
+* @brief this file contains the implementation of the sorted, cached index of the image files in a volume directory.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include "dirindex.h"
+#include "parallel.h"
+#include "stb_image.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::mutex cacheLock;                                               /**< Guards cache. */
+std::map<std::string, std::shared_ptr<const DirectoryIndex>> cache; /**< The indexes by directory. */
+
+int64_t ticks(fs::file_time_type time) {
+    return static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+bool is_digit(char ch) {
+    return ch >= '0' && ch <= '9';
+}
+
+} // namespace
+
+/**
+ * @details Walks both names run by run. Digit runs are compared by length once their leading zeros are
+ * skipped, then digit by digit, so numbers of any length compare without overflow or allocation.
+ * @author Zhikang Dong
+ */
+bool DirectoryIndex::natural_less(std::string_view a, std::string_view b) {
+    size_t i = 0, j = 0;
+    int zeros = 0; // The first difference in leading zeros, the tie-break for equal numbers
+    while (i < a.size() && j < b.size()) {
+        if (is_digit(a[i]) && is_digit(b[j])) {
+            const size_t si = i, sj = j;
+            while (i < a.size() && a[i] == '0') ++i;
+            while (j < b.size() && b[j] == '0') ++j;
+            const size_t zi = i - si, zj = j - sj;
+            const size_t ni = i, nj = j;
+            while (i < a.size() && is_digit(a[i])) ++i;
+            while (j < b.size() && is_digit(b[j])) ++j;
+            const size_t li = i - ni, lj = j - nj;
+            if (li != lj) return li < lj;
+            const int cmp = a.substr(ni, li).compare(b.substr(nj, lj));
+            if (cmp != 0) return cmp < 0;
+            if (zeros == 0 && zi != zj) zeros = (zi < zj) ? -1 : 1;
+        } else {
+            if (a[i] != b[j]) return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[j]);
+            ++i;
+            ++j;
+        }
+    }
+    if ((a.size() - i) != (b.size() - j)) return (a.size() - i) < (b.size() - j);
+    return zeros < 0;
+}
+
+/**
+ * @details Serves the cached index while it is current; otherwise rebuilds it, passing the stale one along so
+ * unchanged headers are not read again.
+ * @author Zhikang Dong
+ */
+std::shared_ptr<const DirectoryIndex> DirectoryIndex::open(const std::string& directoryPath) {
+    fs::path directory = fs::absolute(directoryPath).lexically_normal();
+    if (!directory.has_filename()) directory = directory.parent_path(); // "dir/" and "dir" share an index
+    const std::string key = directory.string();
+
+    std::shared_ptr<const DirectoryIndex> previous;
+    {
+        std::lock_guard<std::mutex> guard(cacheLock);
+        auto found = cache.find(key);
+        if (found != cache.end()) previous = found->second;
+    }
+    if (previous && previous->current()) return previous;
+
+    std::shared_ptr<const DirectoryIndex> index = build(directory, previous.get());
+    std::lock_guard<std::mutex> guard(cacheLock);
+    cache[key] = index;
+    return index;
+}
+
+void DirectoryIndex::clear_cache() {
+    std::lock_guard<std::mutex> guard(cacheLock);
+    cache.clear();
+}
+
+/**
+ * @details The listing is sorted once on the stored names. Headers of new or changed files are read in
+ * parallel with stbi_info, which only parses the first bytes of each file.
+ * @author Zhikang Dong
+ */
+std::shared_ptr<const DirectoryIndex> DirectoryIndex::build(const fs::path& directory, const DirectoryIndex* previous) {
+    auto index = std::make_shared<DirectoryIndex>();
+    index->dir = directory;
+    index->dirMtime = ticks(fs::last_write_time(directory));
+
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (!entry.is_regular_file()) continue;
+        IndexEntry file;
+        file.path = entry.path();
+        file.name = entry.path().filename().string();
+        file.size = entry.file_size();
+        file.mtime = ticks(entry.last_write_time());
+        index->files.push_back(std::move(file));
+    }
+    std::sort(index->files.begin(), index->files.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return natural_less(a.name, b.name);
+    });
+
+    // Carry over the headers of files whose size and time are unchanged
+    std::unordered_map<std::string, const IndexEntry*> known;
+    if (previous != nullptr) {
+        for (const IndexEntry& file : previous->files) known[file.name] = &file;
+    }
+    std::vector<IndexEntry>& files = index->files;
+    Parallel::for_range(0, static_cast<int>(files.size()), [&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            IndexEntry& file = files[i];
+            auto found = known.find(file.name);
+            if (found != known.end() && found->second->size == file.size && found->second->mtime == file.mtime) {
+                file = *found->second;
+                continue;
+            }
+            const std::string path = file.path.string();
+            file.image = stbi_info(path.c_str(), &file.width, &file.height, &file.channels) != 0;
+            if (file.image) {
+                file.is16Bit = stbi_is_16_bit(path.c_str()) != 0;
+                file.isHdr = stbi_is_hdr(path.c_str()) != 0;
+            }
+        }
+    }, 16);
+    return index;
+}
+
+/**
+ * @details Adding, removing or renaming a file changes the time of the directory; rewriting a file in place
+ * only changes its own size or time, so those are checked too, in parallel.
+ * @author Zhikang Dong
+ */
+bool DirectoryIndex::current() const {
+    std::error_code error;
+    const auto time = fs::last_write_time(dir, error);
+    if (error || ticks(time) != dirMtime) return false;
+
+    std::atomic<bool> same{true};
+    Parallel::for_range(0, static_cast<int>(files.size()), [&](int i0, int i1) {
+        for (int i = i0; i < i1 && same.load(std::memory_order_relaxed); ++i) {
+            std::error_code sizeError, timeError;
+            const auto size = fs::file_size(files[i].path, sizeError);
+            const auto mtime = fs::last_write_time(files[i].path, timeError);
+            if (sizeError || timeError || size != files[i].size || ticks(mtime) != files[i].mtime) same = false;
+        }
+    }, 64);
+    return same;
+}
+
+size_t DirectoryIndex::size() const {
+    return files.size();
+}
+
+const IndexEntry& DirectoryIndex::operator[](size_t i) const {
+    return files[i];
+}
+
+const std::vector<IndexEntry>& DirectoryIndex::entries() const {
+    return files;
+}
+
+const fs::path& DirectoryIndex::directory() const {
+    return dir;
+}
@@ -0,0 +1,91 @@
+/**
+* @file dispatch.cpp
+* @brief this file contains the implementation of the CPU feature detection and the kernel registry.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include "dispatch.h"
+
+namespace {
+
+std::mutex registryMutex;                                   /**< Guards registry. */
+std::vector<std::pair<std::string, CpuLevel>> registry;     /**< Every binding made so far. */
+
+} // namespace
+
+/**
+ * @details Queries the CPU once. AVX-512 is only reported when the byte/word and vector length extensions the
+ * kernels rely on are all present.
+ * @author Zhikang Dong
+ */
+CpuLevel Dispatch::detected() {
+    static const CpuLevel cpu = [] {
+#if DISPATCH_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq")) {
+            return CpuLevel::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) return CpuLevel::AVX2;
+        if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) return CpuLevel::SSE42;
+#endif
+        return CpuLevel::Scalar;
+    }();
+    return cpu;
+}
+
+/**
+ * @details Reads IMAGE_CPU_LEVEL once; unknown names are reported and ignored.
+ * @author Zhikang Dong
+ */
+CpuLevel Dispatch::level() {
+    static const CpuLevel active = [] {
+        CpuLevel best = detected();
+        const char* env = std::getenv("IMAGE_CPU_LEVEL");
+        if (env == nullptr || *env == '\0') return best;
+
+        std::string requested(env);
+        for (int i = 0; i <= static_cast<int>(CpuLevel::AVX512); ++i) {
+            auto candidate = static_cast<CpuLevel>(i);
+            if (requested != name(candidate)) continue;
+            if (candidate > best) {
+                std::cerr << "IMAGE_CPU_LEVEL=" << requested << " is not supported by this CPU, using "
+                          << name(best) << std::endl;
+                return best;
+            }
+            return candidate;
+        }
+        std::cerr << "Unknown IMAGE_CPU_LEVEL=" << requested << ", using " << name(best) << std::endl;
+        return best;
+    }();
+    return active;
+}
+
+const char* Dispatch::name(CpuLevel level) {
+    switch (level) {
+        case CpuLevel::Scalar: return "scalar";
+        case CpuLevel::SSE42:  return "sse4.2";
+        case CpuLevel::AVX2:   return "avx2";
+        case CpuLevel::AVX512: return "avx512";
+    }
+    return "scalar";
+}
+
+void Dispatch::record(const std::string& kernel, CpuLevel level) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.emplace_back(kernel, level);
+}
+
+std::vector<std::pair<std::string, CpuLevel>> Dispatch::bound() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return registry;
+}
@@ -10,8 +10,21 @@
 * @date 19/03/2024
 */
 
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include "filter.h"
 #include "volume.h"
+#include "canny.h"
+#include "colorspace.h"
+#include "parallel.h"
+#include "threshold.h"
+#include "lut.h"
+#include "dispatch.h"
+#include "border.h"
+#include "largebuffer.h"
+#include "scratch.h"
+#include "sparse.h"
 
 /**
  * @details A simple helper function to swap two values.
@@ -24,6 +37,26 @@ void custom_swap(T& a, T& b) {
     b = temp;
 }
 
+/**
+ * @details Rejects images with 16-bit or float samples in the filters that only have an 8-bit implementation.
+ * @author Zhikang Dong
+ */
+static void require_8bit(const Image& img, const char* filter) {
+    if (img.pixel_type() != PixelType::UInt8) {
+        throw std::invalid_argument(std::string(filter) + " only supports 8-bit images.");
+    }
+}
+
+/**
+ * @details Rejects volumes of 16-bit or float samples; volumes hold one sample type, so no slice is decoded.
+ * @author Zhikang Dong
+ */
+static void require_8bit(const Volume& vol, const char* filter) {
+    if (vol.pixel_type() != PixelType::UInt8) {
+        throw std::invalid_argument(std::string(filter) + " only supports 8-bit images.");
+    }
+}
+
 /**
  * @details Manually adjust the brightness of the image by adding a constant value to each pixel.
  * The brightness value can be positive or negative.
@@ -32,48 +65,24 @@ void custom_swap(T& a, T& b) {
  * @author Georgia Ray 
  */
 void Filter::adjust_brightness(Image& img, int brightness) {
-    unsigned char* data = img.get_data();
-    int width = img.width();
-    int height = img.height();
-    int channels = img.channels();
-
-    //calculating outside the loop for optimization 
-    int size = width * height * channels;
-
-    //access each pixel directly using pointer arithmetic to adjust brightness
-    for (int i = 0; i < size; ++i) {
-        // skip alpha
-        if (channels == 4 && i % channels == 3)
-            continue;
-
-        int value = static_cast<int>(data[i]) + brightness;
-        // Use memset to clip the pixel values between 0 and 255
-        data[i] = static_cast<unsigned char>(std::min(255, std::max(0, value)));
-    }
+    // The clamped addition is a 256 entry map, applied in one alpha-aware pass without a per-element modulo
+    LutChain().brightness(brightness).apply(img);
 }
 
 /**
  * @details Automatically adjust the brightness of the image to make it appear neither too bright nor too dark.
  * The average pixel value is calculated and the brightness is adjusted so that the average pixel value is 128.
  * @author Berat Yildizgorer
+ * @author Zhikang Dong
  */
 void Filter::auto_adjust_brightness(Image& img) {
-    unsigned char* data = img.get_data();
-    int width = img.width();
-    int height = img.height();
-    int channels = img.channels();
-    long long total = 0;
-    int pixelCount = width * height * channels;
-
-    // Calculate the total pixel value
-    for(int i = 0; i < pixelCount; ++i) {
-        if(channels == 4 && (i % channels == 3)) continue; // Skip alpha channel
-        total += data[i];
-    }
+    require_8bit(img, "Automatic brightness");
+    // The mean comes from the cached histogram, so repeated calls do not rescan the image
+    ImageStatistics stats = img.statistics();
+    if (stats.count == 0) return;
 
     // Calculate the average pixel value
-    int pixelCountWithoutAlpha = (channels == 4) ? pixelCount / 4 * 3 : pixelCount; // Adjust for alpha channel if present
-    int average = total / pixelCountWithoutAlpha;
+    int average = static_cast<int>(stats.sum / stats.count);
 
     // Adjust the brightness to make the average pixel value 128
     int adjustment = 128 - average;
@@ -156,6 +165,257 @@ unsigned char Filter::findMedian(std::vector<unsigned char>& neighborhood) {
     return quickSelect(neighborhood, 0, neighborhood.size() - 1, medianIndex);
 }
 
+/**
+ * @details Orders two values in place, the compare-exchange of the median network.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static KERNEL_INLINE void sort2(T& a, T& b) {
+    T lo = std::min(a, b);
+    b = std::max(a, b);
+    a = lo;
+}
+
+/**
+ * @details Median of nine values with the 19 compare-exchange network of Paeth, branch free so it runs on
+ * whole vectors of pixels at once.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static KERNEL_INLINE T median9(T p0, T p1, T p2, T p3, T p4, T p5, T p6, T p7, T p8) {
+    sort2(p1, p2); sort2(p4, p5); sort2(p7, p8);
+    sort2(p0, p1); sort2(p3, p4); sort2(p6, p7);
+    sort2(p1, p2); sort2(p4, p5); sort2(p7, p8);
+    sort2(p0, p3); sort2(p5, p8); sort2(p4, p7);
+    sort2(p3, p6); sort2(p1, p4); sort2(p2, p5);
+    sort2(p4, p7); sort2(p4, p2); sort2(p6, p4);
+    sort2(p4, p2);
+    return p4;
+}
+
+/**
+ * @details Calls f with the channel count as a std::integral_constant, so the kernel it instantiates can be
+ * specialised for 1, 3 and 4 channels; any other count is passed as 0, meaning "known only at run time".
+ * @author Zhikang Dong
+ */
+template <typename F>
+static auto with_channels(int channels, F&& f) {
+    switch (channels) {
+        case 1: return f(std::integral_constant<int, 1>());
+        case 3: return f(std::integral_constant<int, 3>());
+        case 4: return f(std::integral_constant<int, 4>());
+        default: return f(std::integral_constant<int, 0>());
+    }
+}
+
+/**
+ * @details Calls f with a kernel radius of 1, 2 or 3 (kernel sizes 3, 5 and 7) as a std::integral_constant so
+ * the taps can be unrolled; larger radii are passed as 0, meaning "known only at run time".
+ * @author Zhikang Dong
+ */
+template <typename F>
+static auto with_radius(int radius, F&& f) {
+    switch (radius) {
+        case 1: return f(std::integral_constant<int, 1>());
+        case 2: return f(std::integral_constant<int, 2>());
+        case 3: return f(std::integral_constant<int, 3>());
+        default: return f(std::integral_constant<int, 0>());
+    }
+}
+
+/**
+ * @details Binds one specialisation of a kernel the first time it is requested, named after its sample type,
+ * channel count and radius in the dispatch registry.
+ * @author Zhikang Dong
+ */
+template <auto Impl>
+static auto specialised(const char* kernel, const char* type, int channels, int radius) {
+    static const auto bound = Dispatch::bind(std::string(kernel) + "<" + type + "," + std::to_string(channels) +
+                                             "," + std::to_string(radius) + ">", kernel_set<Impl>());
+    return bound;
+}
+
+/**
+ * @brief The type the box blur sums samples of type T in: int for 8-bit, double (exact for these sums) otherwise.
+ */
+template <typename T>
+using BoxSum = std::conditional_t<std::is_same_v<T, unsigned char>, int, double>;
+
+/**
+ * @details Converts a box average to a sample: integer types truncate like the original integer division.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static KERNEL_INLINE T box_sample(double average) {
+    if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<T>(average);
+    } else {
+        return static_cast<T>(static_cast<int>(average));
+    }
+}
+
+/**
+ * @details Converts a Gaussian sum to a sample: integer types are clamped to their range and rounded (or
+ * truncated), float samples are stored as they are.
+ * @author Zhikang Dong
+ */
+template <typename T, bool Round = true>
+static KERNEL_INLINE T gauss_sample(double sum) {
+    if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<T>(sum);
+    } else {
+        const double v = std::max(std::min(sum, PixelTraits<T>::max), 0.0);
+        return static_cast<T>(Round ? std::round(v) : v);
+    }
+}
+
+/**
+ * @details 3x3 median of one row from its three source rows, which must carry a replicated border of at least
+ * one pixel on each side, so every sample runs through the network without branches; the alpha sample of 4
+ * channel pixels is written back unchanged. C is the channel count, or 0 to read it from channels.
+ * @author Zhikang Dong
+ */
+template <int C, typename T>
+static KERNEL_INLINE void median3_kernel(const T* up, const T* mid, const T* dn, T* dst, int w, int channels) {
+    const int nc = C ? C : channels;
+    const int n = w * nc;
+    for (int b = 0; b < n; ++b) {
+        T m = median9(up[b - nc], up[b], up[b + nc], mid[b - nc], mid[b], mid[b + nc], dn[b - nc], dn[b], dn[b + nc]);
+        dst[b] = (nc == 4 && (b & 3) == 3) ? mid[b] : m;
+    }
+}
+
+/**
+ * @details Sums a column window of rows, sample by sample, for the separable box blur.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static KERNEL_INLINE void box_column_kernel(const T* const* rows, int count, BoxSum<T>* acc, int n) {
+    for (int b = 0; b < n; ++b) acc[b] = 0;
+    for (int k = 0; k < count; ++k) {
+        const T* row = rows[k];
+        for (int b = 0; b < n; ++b) acc[b] += row[b];
+    }
+}
+
+/**
+ * @details Sums the column sums of the pixels [x - e, x + e] for the interior pixels x in [e, w - e) and
+ * divides by the window area (rows valid rows by 2e + 1 columns). The sums are exact, so for integer samples
+ * the double division truncates to the same value as the integer division of the original per-pixel loop.
+ * Colour samples only; alpha is set by the caller. C and E are the channel count and radius, or 0 to read them
+ * from channels and radius; a constant radius keeps each sum in a register instead of accumulating in acc.
+ * @author Zhikang Dong
+ */
+template <int C, int E, typename T>
+static KERNEL_INLINE void box_row_kernel(const BoxSum<T>* columns, T* dst, int w, int channels, int radius,
+                                         int rows, BoxSum<T>* acc) {
+    const int nc = C ? C : channels;
+    const int e = E ? E : radius;
+    const int first = e * nc, last = (w - e) * nc;
+    const double area = static_cast<double>(rows) * (2 * e + 1);
+    if constexpr (E > 0) {
+        for (int b = first; b < last; ++b) {
+            BoxSum<T> sum = 0;
+            for (int k = -E; k <= E; ++k) sum += columns[b + k * nc];
+            T v = box_sample<T>(sum / area);
+            dst[b] = (nc == 4 && (b & 3) == 3) ? dst[b] : v;
+        }
+    } else {
+        for (int b = first; b < last; ++b) acc[b] = 0;
+        for (int k = -e; k <= e; ++k) {
+            for (int b = first; b < last; ++b) acc[b] += columns[b + k * nc];
+        }
+        for (int b = first; b < last; ++b) {
+            T v = box_sample<T>(acc[b] / area);
+            dst[b] = (nc == 4 && (b & 3) == 3) ? dst[b] : v;
+        }
+    }
+}
+
+/**
+ * @brief The number of pixels the Gaussian kernels accumulate at a time, so the double sums stay in L1.
+ */
+static constexpr int GAUSS_BLOCK = 256;
+
+/**
+ * @details Whether the original Gaussian helpers blur channel c of an nc channel image: the first three channels
+ * of RGBA, otherwise only the first.
+ * @author Zhikang Dong
+ */
+static KERNEL_INLINE bool gauss_blurs(int c, int nc) {
+    return (nc == 4) ? c < 3 : c == 0;
+}
+
+/**
+ * @details Horizontal Gaussian pass over the interior pixels of one row, x in [center, w - center). Products are
+ * added in the same tap order as the original per-pixel loop, so the sums round identically. With a constant
+ * radius R the taps of each sample are unrolled and summed in a register; otherwise they are added one tap at a
+ * time across a block of pixels in acc (GAUSS_BLOCK * nc values). Only the channels the original blurred are
+ * stored. C is the channel count, or 0 to read it from channels.
+ * @author Zhikang Dong
+ */
+template <int C, int R, typename T>
+static KERNEL_INLINE void gauss_row_kernel(const T* src, T* dst, int w, int channels, int center,
+                                           const double* weights, double* acc) {
+    const int nc = C ? C : channels;
+    if constexpr (R > 0) {
+        for (int x = R; x < w - R; ++x) {
+            for (int c = 0; c < nc; ++c) {
+                if (!gauss_blurs(c, nc)) continue;
+                const T* in = src + x * nc + c;
+                double sum = 0.0;
+                for (int k = -R; k <= R; ++k) sum += in[k * nc] * weights[k + R];
+                dst[x * nc + c] = gauss_sample<T>(sum);
+            }
+        }
+    } else {
+        for (int x0 = center; x0 < w - center; x0 += GAUSS_BLOCK) {
+            const int x1 = std::min(x0 + GAUSS_BLOCK, w - center);
+            const int n = (x1 - x0) * nc;
+            const T* in = src + x0 * nc;
+            for (int b = 0; b < n; ++b) acc[b] = 0.0;
+            for (int k = -center; k <= center; ++k) {
+                const double weight = weights[k + center];
+                for (int b = 0; b < n; ++b) acc[b] += in[b + k * nc] * weight;
+            }
+            for (int x = 0; x < x1 - x0; ++x) {
+                for (int c = 0; c < nc; ++c) {
+                    if (!gauss_blurs(c, nc)) continue;
+                    dst[(x0 + x) * nc + c] = gauss_sample<T>(acc[x * nc + c]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @details Vertical (or through-slice) Gaussian pass of one row from its taps rows, in tap order, a block of
+ * pixels at a time in acc (GAUSS_BLOCK * nc values). The 2D pass rounds; the 3D z pass historically truncates,
+ * hence the Round flag. C is the channel count, or 0 to read it from channels.
+ * @author Zhikang Dong
+ */
+template <bool Round, int C, typename T>
+static KERNEL_INLINE void gauss_column_kernel(const T* const* rows, int taps, const double* weights, T* dst, int w,
+                                              int channels, double* acc) {
+    const int nc = C ? C : channels;
+    for (int x0 = 0; x0 < w; x0 += GAUSS_BLOCK) {
+        const int x1 = std::min(x0 + GAUSS_BLOCK, w);
+        const int n = (x1 - x0) * nc;
+        for (int b = 0; b < n; ++b) acc[b] = 0.0;
+        for (int k = 0; k < taps; ++k) {
+            const T* row = rows[k] + x0 * nc;
+            const double weight = weights[k];
+            for (int b = 0; b < n; ++b) acc[b] += row[b] * weight;
+        }
+        for (int x = 0; x < x1 - x0; ++x) {
+            for (int c = 0; c < nc; ++c) {
+                if (!gauss_blurs(c, nc)) continue;
+                dst[(x0 + x) * nc + c] = gauss_sample<T, Round>(acc[x * nc + c]);
+            }
+        }
+    }
+}
+
 /**
  * @details Apply median blur to the image using the specified kernel size.
  * The kernel size must be an odd number.
@@ -163,34 +423,64 @@ unsigned char Filter::findMedian(std::vector<unsigned char>& neighborhood) {
  */
 void Filter::median_blur(Image& img, int kernelSize) {
     const int edgeOffset = kernelSize / 2;
-    unsigned char* data = img.get_data();
     int width = img.width();
     int height = img.height();
     int channels = img.channels();
 
-    std::vector<unsigned char> originalImg(data, data + width * height * channels);
-    std::vector<unsigned char> neighborhood;
-    neighborhood.reserve(kernelSize * kernelSize);
-
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            for (int c = 0; c < channels; ++c) {
-                if (channels == 4 && c == 3) {
-                    continue;
+    // The replicated border stands in for the clamped coordinates of the window
+    const BorderedImage original(img, edgeOffset, BorderMode::Replicate);
+
+    visit_pixel_type(img.pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        T* data = img.pixels<T>();
+        auto source = [&](int y) { return reinterpret_cast<const T*>(original.row(y)); };
+
+        if (kernelSize == 3) {
+            // The 3x3 window is small enough for a sorting network, which returns the same middle element
+            const auto median3 = with_channels(channels, [](auto c) {
+                return specialised<median3_kernel<decltype(c)::value, T>>("median3_row", PixelTraits<T>::name, c, 1);
+            });
+            const size_t stride = static_cast<size_t>(width) * channels;
+            Parallel::for_range(0, height, [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y) {
+                    median3(source(y - 1), source(y), source(y + 1), data + y * stride, width, channels);
                 }
-                neighborhood.clear();
-                for (int ky = -edgeOffset; ky <= edgeOffset; ++ky) {
-                    for (int kx = -edgeOffset; kx <= edgeOffset; ++kx) {
-                        int nx = std::min(std::max(x + kx, 0), width - 1);
-                        int ny = std::min(std::max(y + ky, 0), height - 1);
-                        neighborhood.push_back(originalImg[ny * width * channels + nx * channels + c]);
+            }, 8);
+            return;
+        }
+
+        // Larger windows use quickselect; the loop is instantiated per channel count so the alpha test folds away
+        with_channels(channels, [&](auto known) {
+            const int nc = decltype(known)::value ? decltype(known)::value : channels;
+            const int colours = (nc == 4) ? 3 : nc;
+            Parallel::for_range(0, height, [&](int y0, int y1) {
+                std::vector<T> neighborhood;
+                neighborhood.reserve(kernelSize * kernelSize);
+                for (int y = y0; y < y1; ++y) {
+                    for (int x = 0; x < width; ++x) {
+                        for (int c = 0; c < colours; ++c) {
+                            neighborhood.clear();
+                            for (int ky = -edgeOffset; ky <= edgeOffset; ++ky) {
+                                const T* row = source(y + ky) + x * nc + c;
+                                for (int kx = -edgeOffset; kx <= edgeOffset; ++kx) {
+                                    neighborhood.push_back(row[kx * nc]);
+                                }
+                            }
+                            if constexpr (std::is_same_v<T, unsigned char>) {
+                                data[y * width * nc + x * nc + c] = findMedian(neighborhood);
+                            } else {
+                                auto middle = neighborhood.begin() + neighborhood.size() / 2;
+                                std::nth_element(neighborhood.begin(), middle, neighborhood.end());
+                                data[y * width * nc + x * nc + c] = *middle;
+                            }
+                        }
                     }
                 }
-                unsigned char medianValue = findMedian(neighborhood);
-                data[y * width * channels + x * channels + c] = medianValue;
-            }
-        }
-    }
+            });
+            return 0;
+        });
+    });
+    img.invalidate_statistics();
 }
 
 /**
@@ -202,73 +492,100 @@ void Filter::box_blur(Image& img, int kernelSize) {
     int width = img.width();
     int height = img.height();
     int channels = img.channels();
-
-    std::vector<unsigned char> newImg(width * height * channels);
-    std::vector<int> sum(channels, 0); // Use this to accumulate sums
-
     const int edgeOffset = kernelSize / 2;
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            std::fill(sum.begin(), sum.end(), 0); // Reset sum for each pixel
-            int count = 0;
-
-            for (int ky = -edgeOffset; ky <= edgeOffset; ++ky) {
-                int ny = y + ky;
-                // Check if the ny is within the image bounds
-                if (ny < 0 || ny >= height) continue; // Skip this ky iteration if ny is out of bounds
-                
-                for (int kx = -edgeOffset; kx <= edgeOffset; ++kx) {
-                    int nx = x + kx;
-                    // Check if the nx is within the image bounds
-                    if (nx < 0 || nx >= width) continue; // Skip this kx iteration if nx is out of bounds
+    const int stride = width * channels;
+
+    visit_pixel_type(img.pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        using Sum = BoxSum<T>;
+        const char* type = PixelTraits<T>::name;
+        ScratchBuffer<T> newImg(static_cast<size_t>(width) * height * channels);
+        const T* src = img.pixels<T>();
+
+        // The window is separable: sum the valid rows of each column, then the valid columns of those sums.
+        // Only the division depends on the number of valid taps, so the result is the original average.
+        const auto columnSum = specialised<box_column_kernel<T>>("box_column", type, 0, 0);
+        const auto rowSum = with_channels(channels, [&](auto c) {
+            return with_radius(edgeOffset, [&](auto r) {
+                return specialised<box_row_kernel<decltype(c)::value, decltype(r)::value, T>>("box_row", type, c, r);
+            });
+        });
+        Parallel::for_range(0, height, [&](int y0, int y1) {
+            ScratchBuffer<Sum> columns(stride), acc(stride);
+            ScratchBuffer<const T*> rows(kernelSize);
+            for (int y = y0; y < y1; ++y) {
+                const int top = std::max(y - edgeOffset, 0), bottom = std::min(y + edgeOffset, height - 1);
+                for (int ny = top; ny <= bottom; ++ny) rows[ny - top] = src + ny * stride;
+                columnSum(rows.data(), bottom - top + 1, columns.data(), stride);
+
+                T* out = newImg.data() + y * stride;
+                if (channels == 4) {
+                    // Alpha is copied from the last tap of the window, as the original loop did
+                    const T* last = src + bottom * stride;
+                    for (int x = 0; x < width; ++x) {
+                        out[x * 4 + 3] = last[std::min(x + edgeOffset, width - 1) * 4 + 3];
+                    }
+                }
+                rowSum(columns.data(), out, width, channels, edgeOffset, bottom - top + 1, acc.data());
 
+                // Columns whose window is cut by the left or right border
+                auto border = [&](int x) {
+                    const int left = std::max(x - edgeOffset, 0), right = std::min(x + edgeOffset, width - 1);
+                    const int count = (bottom - top + 1) * (right - left + 1);
                     for (int c = 0; c < channels; ++c) {
-                        if (channels == 4 && c == 3) { // Copy alpha channel unchanged
-                            newImg[(y * width + x) * channels + c] = img.get_data()[(ny * width + nx) * channels + c];
-                        } else {
-                            sum[c] += img.get_data()[(ny * width + nx) * channels + c];
-                        }
+                        if (channels == 4 && c == 3) continue;
+                        Sum sum = 0;
+                        for (int nx = left; nx <= right; ++nx) sum += columns[nx * channels + c];
+                        out[x * channels + c] = box_sample<T>(static_cast<double>(sum) / count);
                     }
-                    count++;
-                }
+                };
+                for (int x = 0; x < std::min(edgeOffset, width); ++x) border(x);
+                for (int x = std::max(edgeOffset, width - edgeOffset); x < width; ++x) border(x);
             }
+        }, 4);
 
-            for (int c = 0; c < channels; ++c) {
-                if (channels != 4 || c != 3) { // Skip alpha channel processing
-                    newImg[(y * width + x) * channels + c] = sum[c] / count;
-                }
-            }
-        }
-    }
+        // Now, copy the blurred image back to the original data buffer.
+        std::copy(newImg.data(), newImg.data() + newImg.size(), img.pixels<T>());
+    });
+    img.invalidate_statistics();
+}
+
+/**
+ * @details Helper that runs a run-of-pixels colour kernel over the rows of an image in parallel.
+ * @author Zhikang Dong
+ */
+static void convert_rows(Image& img, void (*kernel)(unsigned char*, size_t, int)) {
+    require_8bit(img, "Colour space conversion");
+    unsigned char* data = img.get_data();
+    int width = img.width();
+    int channels = img.channels();
+    if (channels < 3) return;
 
-    // Now, copy the blurred image back to the original data buffer.
-    std::copy(newImg.begin(), newImg.end(), img.get_data());
+    Parallel::for_range(0, img.height(), [&](int y0, int y1) {
+        kernel(data + static_cast<size_t>(y0) * width * channels, static_cast<size_t>(y1 - y0) * width, channels);
+    }, 16);
+    img.invalidate_statistics();
 }
 
 /**
  * @details Convert the image from RGB to grayscale.
- * 
+ * Uses fixed-point Rec. 709 luma weights; the output is identical to the original double precision formula.
  * @author Zhikang Dong
  */
 void Filter::RGB2Gray(Image& img) {
+    require_8bit(img, "Grayscale conversion");
     unsigned char* data = img.get_data();
     int width = img.width();
     int height = img.height();
     int channels = img.channels();
+    if (channels < 3) return;
     
-    unsigned char* grayData = new unsigned char[width * height];
-
-    for(int j = 0; j < height; ++j) {
-        for(int i = 0; i < width; ++i) {
-            int index = j * width * channels + i * channels;
-            unsigned char r = data[index];
-            unsigned char g = data[index + 1];
-            unsigned char b = data[index + 2];
-            unsigned char gray = static_cast<unsigned char>(0.2126 * r + 0.7152 * g + 0.0722 * b);
-            
-            grayData[j * width + i] = gray;
-        }
-    }
+    unsigned char* grayData = LargeBuffer::allocate(height, width);
+
+    Parallel::for_range(0, height, [&](int y0, int y1) {
+        size_t first = static_cast<size_t>(y0) * width;
+        ColorSpace::rgb_to_gray(data + first * channels, grayData + first, static_cast<size_t>(y1 - y0) * width, channels);
+    }, 16);
 
     img.set_data(grayData);
     img.set_channels(1);
@@ -279,45 +596,7 @@ void Filter::RGB2Gray(Image& img) {
  * @author Zhikang Dong
  */
 void Filter::RGB2HSV(Image& img) {
-    unsigned char* data = img.get_data();
-    int width = img.width();
-    int height = img.height();
-    int channels = img.channels();
-    
-    for(int j = 0; j < height; ++j) {
-        for(int i = 0; i < width; ++i) {
-            int index = j * width * channels + i * channels;
-            unsigned char r = data[index];
-            unsigned char g = data[index + 1];
-            unsigned char b = data[index + 2];
-            
-            float R = r / 255.0f;
-            float G = g / 255.0f;
-            float B = b / 255.0f;
-            
-            float Cmax = std::max(std::max(R, G), B);
-            float Cmin = std::min(std::min(R, G), B);
-            float delta = Cmax - Cmin;
-            
-            float H = 0;
-            if (delta == 0) {
-                H = 0;
-            } else if (Cmax == R) {
-                H = 60 * fmod((G - B) / delta, 6);
-            } else if (Cmax == G) {
-                H = 60 * ((B - R) / delta + 2);
-            } else if (Cmax == B) {
-                H = 60 * ((R - G) / delta + 4);
-            }
-            
-            float S = (Cmax == 0) ? 0 : delta / Cmax;
-            float V = Cmax;
-            
-            data[index] = static_cast<unsigned char>(H / 360 * 255);
-            data[index + 1] = static_cast<unsigned char>(S * 255);
-            data[index + 2] = static_cast<unsigned char>(V * 255);
-        }
-    }
+    convert_rows(img, ColorSpace::rgb_to_hsv);
 }
 
 /**
@@ -325,54 +604,7 @@ void Filter::RGB2HSV(Image& img) {
  * @author Zhikang Dong
  */
 void Filter::HSV2RGB(Image& img){
-    unsigned char* data = img.get_data();
-    int width = img.width();
-    int height = img.height();
-    int channels = img.channels();
-    
-    for(int j = 0; j < height; ++j) {
-        for(int i = 0; i < width; ++i) {
-            int index = j * width * channels + i * channels;
-            float H = data[index] / 255.0f * 360;
-            float S = data[index + 1] / 255.0f;
-            float V = data[index + 2] / 255.0f;
-            
-            float C = V * S;
-            float X = C * (1 - fabs(fmod(H / 60, 2) - 1));
-            float m = V - C;
-            
-            float R, G, B;
-            if (H >= 0 && H < 60) {
-                R = C;
-                G = X;
-                B = 0;
-            } else if (H >= 60 && H < 120) {
-                R = X;
-                G = C;
-                B = 0;
-            } else if (H >= 120 && H < 180) {
-                R = 0;
-                G = C;
-                B = X;
-            } else if (H >= 180 && H < 240) {
-                R = 0;
-                G = X;
-                B = C;
-            } else if (H >= 240 && H < 300) {
-                R = X;
-                G = 0;
-                B = C;
-            } else {
-                R = C;
-                G = 0;
-                B = X;
-            }
-            
-            data[index] = static_cast<unsigned char>((R + m) * 255);
-            data[index + 1] = static_cast<unsigned char>((G + m) * 255);
-            data[index + 2] = static_cast<unsigned char>((B + m) * 255);
-        }
-    }
+    convert_rows(img, ColorSpace::hsv_to_rgb);
 }
 
 /**
@@ -380,86 +612,75 @@ void Filter::HSV2RGB(Image& img){
  * @author Zhikang Dong
  */
 void Filter::RGB2HSL(Image& img) {
-    unsigned char* data = img.get_data();
+    convert_rows(img, ColorSpace::rgb_to_hsl);
+}
+
+/**
+ * @details Convert the image from HSL to RGB.
+ * @author Zhikang Dong
+ */
+void Filter::HSL2RGB(Image& img) {
+    convert_rows(img, ColorSpace::hsl_to_rgb);
+}
+
+/**
+ * @details Histogram of the V (HSV) or L (HSL) byte of an RGB(A) image, gathered straight from RGB
+ * into per-chunk bins that are merged at the end.
+ * @author Zhikang Dong
+ */
+static std::array<uint64_t, 256> value_histogram(const Image& img, ColorModel model) {
+    const unsigned char* data = img.get_data();
     int width = img.width();
-    int height = img.height();
     int channels = img.channels();
-    
-    for (int j = 0; j < height; ++j) {
-        for (int i = 0; i < width; ++i) {
-            int index = j * width * channels + i * channels;
-            float r = data[index] / 255.0f;
-            float g = data[index + 1] / 255.0f;
-            float b = data[index + 2] / 255.0f;
-            
-            float max = std::max({r, g, b});
-            float min = std::min({r, g, b});
-            float delta = max - min;
-            
-            float L = (max + min) / 2;
-            float H = 0;
-            float S = 0;
-            
-            if (delta != 0) {
-                S = (L < 0.5) ? (delta / (max + min)) : (delta / (2 - max - min));
-                
-                if (max == r) {
-                    H = 60 * fmod(((g - b) / delta), 6);
-                } else if (max == g) {
-                    H = 60 * ((b - r) / delta + 2);
-                } else if (max == b) {
-                    H = 60 * ((r - g) / delta + 4);
-                }
-            }
-            
-            data[index] = static_cast<unsigned char>((H / 360) * 255); // H
-            data[index + 1] = static_cast<unsigned char>(S * 255); // S
-            data[index + 2] = static_cast<unsigned char>(L * 255); // L
+
+    std::array<uint64_t, 256> histogram{};
+    std::mutex histogramMutex;
+    Parallel::for_range(0, img.height(), [&](int y0, int y1) {
+        uint64_t local[256] = {0};
+        ColorSpace::value_histogram(data + static_cast<size_t>(y0) * width * channels,
+                                    static_cast<size_t>(y1 - y0) * width, channels, model, local);
+        std::lock_guard<std::mutex> lock(histogramMutex);
+        for (int i = 0; i < 256; ++i) {
+            histogram[i] += local[i];
         }
-    }
+    }, 16);
+    return histogram;
 }
 
 /**
- * @details Convert the image from HSL to RGB.
+ * @details Equalises the V (HSV) or L (HSL) channel of an RGB(A) image without converting it.
+ * The LUT is built exactly like the per-channel path below, and the forward conversion, remap and
+ * inverse conversion are fused into one in-place pass, so the image is read twice instead of being
+ * converted there and back.
  * @author Zhikang Dong
  */
-void Filter::HSL2RGB(Image& img) {
+static void equalize_value(Image& img, ColorModel model) {
     unsigned char* data = img.get_data();
     int width = img.width();
     int height = img.height();
     int channels = img.channels();
-    
-    for (int j = 0; j < height; ++j) {
-        for (int i = 0; i < width; ++i) {
-            int index = j * width * channels + i * channels;
-            float H = data[index] / 255.0f * 360;
-            float S = data[index + 1] / 255.0f;
-            float L = data[index + 2] / 255.0f;
-            
-            float C = (1 - fabs(2 * L - 1)) * S;
-            float X = C * (1 - fabs(fmod(H / 60.0, 2) - 1));
-            float m = L - C / 2;
-            
-            float r = 0, g = 0, b = 0;
-            if (0 <= H && H < 60) {
-                r = C; g = X; b = 0;
-            } else if (60 <= H && H < 120) {
-                r = X; g = C; b = 0;
-            } else if (120 <= H && H < 180) {
-                r = 0; g = C; b = X;
-            } else if (180 <= H && H < 240) {
-                r = 0; g = X; b = C;
-            } else if (240 <= H && H < 300) {
-                r = X; g = 0; b = C;
-            } else if (300 <= H && H < 360) {
-                r = C; g = 0; b = X;
-            }
-            
-            data[index] = static_cast<unsigned char>((r + m) * 255);
-            data[index + 1] = static_cast<unsigned char>((g + m) * 255);
-            data[index + 2] = static_cast<unsigned char>((b + m) * 255);
-        }
+    int pixelCount = width * height;
+
+    std::array<uint64_t, 256> histogram = value_histogram(img, model);
+
+    std::vector<int> cdf(256, 0);
+    cdf[0] = static_cast<int>(histogram[0]);
+    for (int i = 1; i < 256; ++i) {
+        cdf[i] = cdf[i - 1] + static_cast<int>(histogram[i]);
+    }
+
+    float cdfMin = cdf[0];
+    float denom = static_cast<float>(pixelCount - cdfMin);
+    unsigned char lut[256];
+    for (int i = 0; i < 256; ++i) {
+        lut[i] = (denom != 0) ? static_cast<unsigned char>(static_cast<int>(round(((cdf[i] - cdfMin) / denom) * 255))) : 0;
     }
+
+    Parallel::for_range(0, height, [&](int y0, int y1) {
+        ColorSpace::remap_value(data + static_cast<size_t>(y0) * width * channels,
+                                static_cast<size_t>(y1 - y0) * width, channels, model, lut);
+    }, 16);
+    img.invalidate_statistics();
 }
 
 /**
@@ -470,35 +691,36 @@ void Filter::HSL2RGB(Image& img) {
  * @author Georgia Ray
  */
 void Filter::HistogramEqualization(Image& img, int transform) {
+    require_8bit(img, "Histogram equalization");
     int width = img.width();
     int height = img.height();
     int channels = img.channels();
     
     if (channels == 1) 
     {   
-        unsigned char* data = img.get_data();
-        std::vector<int> histogram(256, 0);
-        for (int i = 0; i < width * height; ++i) {
-            histogram[data[i]]++;
-        }
+        ImageStatistics stats = img.statistics(); // cached histogram of the intensities
         
         std::vector<int> cumulativeHistogram(256, 0);
-        cumulativeHistogram[0] = histogram[0];
+        cumulativeHistogram[0] = static_cast<int>(stats.histogram[0]);
         for (int i = 1; i < 256; ++i) {
-            cumulativeHistogram[i] = cumulativeHistogram[i - 1] + histogram[i];
+            cumulativeHistogram[i] = cumulativeHistogram[i - 1] + static_cast<int>(stats.histogram[i]);
         }
         
-        for (int i = 0; i < width * height; ++i) {
-            data[i] = static_cast<unsigned char>(255 * cumulativeHistogram[data[i]] / (width * height));
+        unsigned char mapping[256];
+        for (int i = 0; i < 256; ++i) {
+            mapping[i] = static_cast<unsigned char>(255 * cumulativeHistogram[i] / (width * height));
         }
+        LutChain().map(mapping).apply(img);
     }
 
     else if (channels == 3 || channels == 4) 
     {
-        if(transform == 1) RGB2HSV(img); // Convert RGB to HSV
-        else if(transform == 2) RGB2HSL(img); // Convert RGB to HSL
+        if (transform == 1 || transform == 2) {
+            equalize_value(img, static_cast<ColorModel>(transform));
+            return;
+        }
 
-        unsigned char* data = img.get_data(); // Now data is in HSV format
+        unsigned char* data = img.get_data();
         int pixelCount = width * height ;
 
         // Step 1: Build a histogram for the V channel only
@@ -528,15 +750,35 @@ void Filter::HistogramEqualization(Image& img, int transform) {
         }
 
         // Step 3: Apply the equalized CDF to the V channel
-        for (int i = 0; i < pixelCount; ++i) {
-            int vIndex = i * channels + 2; // V channel index in HSV
-            data[vIndex] = static_cast<unsigned char>(cdf[data[vIndex]]);
+        unsigned char mapping[256];
+        for (int i = 0; i < 256; ++i) {
+            mapping[i] = static_cast<unsigned char>(cdf[i]);
         }
-        
-        // Convert back to RGB (assuming you have an HSV2RGB function defined)
+        LutChain().map(2, mapping).apply(img);
+    }
+}
+
+/**
+ * @details Apply CLAHE to the image. Gray images are equalized directly; colour images are equalized on the V channel
+ * in HSV format or the L channel in HSL format, like HistogramEqualization.
+ * @author Zhikang Dong
+ */
+void Filter::clahe(Image& img, int tiles, double clipLimit, int transform) {
+    require_8bit(img, "CLAHE");
+    int channels = img.channels();
+    if (channels == 1) {
+        Clahe::equalize(img.get_data(), img.width(), img.height(), 1, tiles, tiles, clipLimit);
+    }
+    else if (channels == 3 || channels == 4) {
+        if (transform == 1) RGB2HSV(img);
+        else if (transform == 2) RGB2HSL(img);
+
+        Clahe::equalize(img.get_data() + 2, img.width(), img.height(), channels, tiles, tiles, clipLimit);
+
         if (transform == 1) HSV2RGB(img);
         else if (transform == 2) HSL2RGB(img);
     }
+    img.invalidate_statistics();
 }
 
 /**
@@ -547,26 +789,30 @@ void Filter::HistogramEqualization(Image& img, int transform) {
  * @author Georgia Ray
  */
 void Filter::Tresholding(Image& img, int threshold, int transform) {
+    require_8bit(img, "Thresholding");
     int width = img.width();
     int height = img.height();
     int channels = img.channels();
     
     if (channels == 1) 
     {
-        unsigned char* data = img.get_data();
-        for (int i = 0; i < width * height; ++i) {
-            data[i] = (data[i] > threshold) ? 255 : 0;
-        }
+        LutChain().threshold(threshold).apply(img);
     }
     else if (channels == 3 || channels == 4) 
     {
-        if(transform == 1) RGB2HSV(img); // Convert RGB to HSV
-        else if(transform == 2) RGB2HSL(img); // Convert RGB to HSL
-
         unsigned char* data = img.get_data();
-        unsigned char* TreshData = new unsigned char[width * height];
-
-        for (int i = 0; i < width * height; ++i) {
+        unsigned char* TreshData = LargeBuffer::allocate(height, width);
+
+        if (transform == 1 || transform == 2) {
+            // Read V or L straight from RGB instead of converting the whole image first
+            ColorModel model = static_cast<ColorModel>(transform);
+            Parallel::for_range(0, height, [&](int y0, int y1) {
+                size_t first = static_cast<size_t>(y0) * width;
+                ColorSpace::value_threshold(data + first * channels, TreshData + first,
+                                            static_cast<size_t>(y1 - y0) * width, channels, model, threshold);
+            }, 16);
+        }
+        else for (int i = 0; i < width * height; ++i) {
             int vIndex = i * channels + 2; // V channel index in HSV
             TreshData[i] = (data[vIndex] > threshold) ? 255 : 0;
         }
@@ -576,11 +822,81 @@ void Filter::Tresholding(Image& img, int threshold, int transform) {
     }
 }
 
+/**
+ * @details Helper that returns the histogram of the channel that Tresholding compares: the intensity of gray images,
+ * V or L for colour images with transform 1 or 2, and the raw third channel otherwise.
+ * @author Zhikang Dong
+ */
+static std::array<uint64_t, 256> intensity_histogram(const Image& img, int transform) {
+    int channels = img.channels();
+    if (channels == 1) return img.statistics().histogram;
+
+    std::array<uint64_t, 256> histogram{};
+    if (channels != 3 && channels != 4) return histogram;
+    if (transform == 1 || transform == 2) return value_histogram(img, static_cast<ColorModel>(transform));
+
+    const unsigned char* data = img.get_data();
+    size_t pixelCount = static_cast<size_t>(img.width()) * img.height();
+    for (size_t i = 0; i < pixelCount; ++i) {
+        histogram[data[i * channels + 2]]++;
+    }
+    return histogram;
+}
+
+/**
+ * @details Pick a global threshold from the histogram of the thresholded channel and apply it with Tresholding.
+ * The histogram of a gray image comes from the statistics cache, so it is free if it is already known.
+ * @author Zhikang Dong
+ */
+int Filter::automatic_thresholding(Image& img, GlobalThreshold method, int transform) {
+    require_8bit(img, "Thresholding");
+    int threshold = Threshold::global(intensity_histogram(img, transform), method);
+    Tresholding(img, threshold, transform);
+    return threshold;
+}
+
+/**
+ * @details Apply adaptive thresholding to the same channel as Tresholding. Gray images are binarised in place;
+ * colour images have their V or L plane extracted straight from RGB and are replaced by the 1 channel result.
+ * @author Zhikang Dong
+ */
+void Filter::adaptive_thresholding(Image& img, AdaptiveThreshold method, int windowSize, double k, int transform) {
+    require_8bit(img, "Adaptive thresholding");
+    unsigned char* data = img.get_data();
+    int width = img.width();
+    int height = img.height();
+    int channels = img.channels();
+
+    if (channels == 1) {
+        Threshold::adaptive(data, data, width, height, windowSize, k, method);
+        img.invalidate_statistics();
+    }
+    else if (channels == 3 || channels == 4) {
+        unsigned char* plane = LargeBuffer::allocate(height, width);
+        Parallel::for_range(0, height, [&](int y0, int y1) {
+            size_t first = static_cast<size_t>(y0) * width;
+            size_t count = static_cast<size_t>(y1 - y0) * width;
+            if (transform == 1 || transform == 2) {
+                ColorSpace::value_plane(data + first * channels, plane + first, count, channels, static_cast<ColorModel>(transform));
+            } else {
+                for (size_t i = first; i < first + count; ++i) {
+                    plane[i] = data[i * channels + 2];
+                }
+            }
+        }, 16);
+
+        Threshold::adaptive(plane, plane, width, height, windowSize, k, method);
+        img.set_data(plane);
+        img.set_channels(1);
+    }
+}
+
 /**
  * @details Add salt and pepper noise to the image.
  * @author Shengzhi Tian
  */
 void Filter::add_salt_and_pepper(Image& img, float density) {
+    require_8bit(img, "Salt and pepper noise");
     int w = img.width();
     int h = img.height();
     int c = img.channels();
@@ -619,6 +935,83 @@ void Filter::add_salt_and_pepper(Image& img, float density) {
             }
         }
     }
+    img.invalidate_statistics();
+}
+
+/**
+ * @details Horizontal Gaussian pass over samples of type T; the body of GaussBlur_x.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static void gauss_blur_x(const T* src, T* dst, int w, int h, int kernelSize, const double* gaussianArray, int nc) {
+    int center = kernelSize / 2;
+    const auto interior = with_channels(nc, [&](auto c) {
+        return with_radius(center, [&](auto r) {
+            return specialised<gauss_row_kernel<decltype(c)::value, decltype(r)::value, T>>(
+                "gauss_row", PixelTraits<T>::name, c, r);
+        });
+    });
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        ScratchBuffer<double> acc(static_cast<size_t>(GAUSS_BLOCK) * nc);
+        int ind = 0;
+        for (int i = y0; i < y1; i++) {
+            interior(src + i * w * nc, dst + i * w * nc, w, nc, center, gaussianArray, acc.data());
+
+            // Pixels whose taps cross the left or right border keep the original mirrored loop
+            auto border = [&](int j) {
+                double sumR = 0.0, sumG = 0.0, sumB = 0.0;
+                for (int k = -center; k <= center; k++) {
+                    // mirroring if exceed boundary
+                    if (j + k < 0 || j + k >= w) {
+                        ind = (i * w + j - k) * nc;
+                    } else {
+                        ind = (i * w + j + k) * nc;
+                    }
+                    sumR += src[ind] * gaussianArray[k + center];
+                    if (nc == 4) {
+                        sumG += src[ind + 1] * gaussianArray[k + center];
+                        sumB += src[ind + 2] * gaussianArray[k + center];
+                    }
+                }
+                // Store result in the destination
+                ind = (i * w + j)*nc;
+                dst[ind] = gauss_sample<T>(sumR);
+
+                if (nc == 4) {
+                    dst[ind + 1] = gauss_sample<T>(sumG);
+                    dst[ind + 2] = gauss_sample<T>(sumB);
+                }
+            };
+            for (int j = 0; j < std::min(center, w); j++) border(j);
+            for (int j = std::max(center, w - center); j < w; j++) border(j);
+        }
+    });
+}
+
+/**
+ * @details Vertical Gaussian pass over samples of type T; the body of GaussBlur_y.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static void gauss_blur_y(const T* src, T* dst, int w, int h, int kernelSize, const double* gaussianArray, int nc) {
+    int center = kernelSize / 2;
+    const auto column = with_channels(nc, [](auto c) {
+        return specialised<gauss_column_kernel<true, decltype(c)::value, T>>("gauss_column", PixelTraits<T>::name, c, 0);
+    });
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        ScratchBuffer<double> acc(static_cast<size_t>(GAUSS_BLOCK) * nc);
+        ScratchBuffer<const T*> rows(kernelSize);
+        for (int i = y0; i < y1; i++)
+        {
+            for (int k = -center; k <= center; k++)
+            {
+                // mirroring if exceed boundary
+                int row = (i + k < 0 || i + k >= h) ? i - k : i + k;
+                rows[k + center] = src + row * w * nc;
+            }
+            column(rows.data(), kernelSize, gaussianArray, dst + i * w * nc, w, nc, acc.data());
+        }
+    });
 }
 
 /**
@@ -631,14 +1024,17 @@ void Filter::gaussian_blur_2d(Image &img, int kernelSize, double sigma) {
     int w = img.width();
     int h = img.height();
     int c = img.channels();
-    unsigned char* data = img.get_data();
 
     double *gaussianArray = Filter::getGaussianKernel(kernelSize, sigma);
-    auto *temp = new unsigned char[w * h * c];
-    Filter::GaussBlur_x(data, temp, w, h, kernelSize, gaussianArray, c);
-    Filter::GaussBlur_y(temp, data, w, h, kernelSize, gaussianArray, c);
+    visit_pixel_type(img.pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        T* data = img.pixels<T>();
+        ScratchBuffer<T> temp(static_cast<size_t>(w) * h * c);
+        gauss_blur_x(data, temp.data(), w, h, kernelSize, gaussianArray, c);
+        gauss_blur_y(temp.data(), data, w, h, kernelSize, gaussianArray, c);
+    });
+    img.invalidate_statistics();
 
-    stbi_image_free(temp);
     stbi_image_free(gaussianArray);
 }
 
@@ -689,34 +1085,7 @@ void Filter::GaussBlur_x(unsigned char* src, unsigned char* dst, int w, int h, i
     Author: 
     Shengzhi Tian (edsml-st1123)
     */
-    int center = kernelSize / 2;
-    int ind = 0;
-    for (int i = 0; i < h; i++) {
-        for (int j = 0; j < w; j++) {
-            double sumR = 0.0, sumG = 0.0, sumB = 0.0;
-            for (int k = -center; k <= center; k++) {
-                // mirroring if exceed boundary
-                if (j + k < 0 || j + k >= w) {
-                    ind = (i * w + j - k) * nc;
-                } else {
-                    ind = (i * w + j + k) * nc;
-                }
-                sumR += src[ind] * gaussianArray[k + center];
-                if (nc == 4) {
-                    sumG += src[ind + 1] * gaussianArray[k + center];
-                    sumB += src[ind + 2] * gaussianArray[k + center];
-                }
-            }
-            // Store result in the destination
-            ind = (i * w + j)*nc;
-            dst[ind] = std::round(std::max(std::min(sumR, 255.0), 0.0));
-
-            if (nc == 4) {
-                dst[ind + 1] = std::round(std::max(std::min(sumG, 255.0), 0.0));
-                dst[ind + 2] = std::round(std::max(std::min(sumB, 255.0), 0.0));
-            }
-        }
-    }
+    gauss_blur_x(src, dst, w, h, kernelSize, gaussianArray, nc);
 }
 
 /**
@@ -744,40 +1113,26 @@ void Filter::GaussBlur_y(unsigned char* src, unsigned char* dst, int w, int h, i
     Author: 
     Shengzhi Tian (edsml-st1123)
     */
-    int center = kernelSize / 2;
-    int ind = 0;
-    for (int i = 0; i < h; i++)
-    {
-        for (int j = 0; j < w; j++)
-        {
-            double sumR = 0.0, sumG = 0.0, sumB = 0.0;
-            for (int k = -center; k <= center; k++)
-            {
-                if (i + k < 0 || i + k >= h) {
-                    ind = ((i - k) * w + j) * nc;
-                } else {
-                    ind = ((i + k) * w + j) * nc;
-                }
-                sumR += src[ind] * gaussianArray[k + center];
-                if (nc == 4) {
-                    sumG += src[ind + 1] * gaussianArray[k + center];
-                    sumB += src[ind + 2] * gaussianArray[k + center];
-                }
-            }
-            ind = (i*w + j) * nc;
-            dst[ind] = std::round(std::max(std::min(sumR, 255.0), 0.0));
+    gauss_blur_y(src, dst, w, h, kernelSize, gaussianArray, nc);
+}
 
-            if (nc == 4){
-                dst[ind + 1] = std::round(std::max(std::min(sumG, 255.0), 0.0));
-                dst[ind + 2] = std::round(std::max(std::min(sumB, 255.0), 0.0));
-            }
-        }
-    }
+/**
+ * @details Median of a 3D window with the rule of the 8-bit histogram in median_blur_3d: the smallest value
+ * whose cumulative count reaches half the window, which is element size / 2 - 1 in sorted order.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static T window_median(std::vector<T>& values) {
+    const size_t rank = values.size() >= 2 ? values.size() / 2 - 1 : 0;
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
 }
 
 /**
  * @details Apply 3D median blur to the volume using the specified kernel size.
+ * 8-bit samples are counted in a histogram; wider samples are gathered and selected with nth_element.
  * @author Berat Yildizgorer
+ * @author Zhikang Dong
  */
 void Filter::median_blur_3d(Volume &vol, int kernelSize) {
     std::vector<Image> imgs = vol.getImages();
@@ -787,57 +1142,86 @@ void Filter::median_blur_3d(Volume &vol, int kernelSize) {
     int w = imgs[0].width();
     int h = imgs[0].height();
     int nc = imgs[0].channels();
+    const int bps = imgs[0].bytes_per_sample();
 
-    // Create new data storage
-    std::vector<unsigned char*> new_data(num_imgs);
-    for (int i = 0; i < num_imgs; ++i) {
-        new_data[i] = new unsigned char[w * h * nc];
+    // Only the 2r + 1 slices of the current window are kept, padded with a replicated border in x and y;
+    // slice z is written in place once the window holds its original, and slot z % window is reused for
+    // slice z + r + 1 afterwards
+    const int edgeOffset = kernelSize / 2;
+    const int window = 2 * edgeOffset + 1;
+    std::vector<BorderedImage> padded;
+    padded.reserve(window);
+    for (int i = 0; i < std::min(window, num_imgs); ++i) {
+        padded.emplace_back(w, h, nc * bps, edgeOffset);
+    }
+    for (int z = 0; z < std::min(edgeOffset, num_imgs); ++z) {
+        padded[z % window].assign(imgs[z].get_data(), BorderMode::Replicate);
     }
 
-    for (int z = 0; z < num_imgs; ++z) {
-        for (int y = 0; y < h; ++y) {
-            for (int x = 0; x < w; ++x) {
-                for (int c = 0; c < nc; ++c) { // Iterate through each channel
-                    if (!(nc == 4 && c == 3)) { // Skip alpha channel for RGBA images
-                        int histogram[256] = {0};
-                        int totalPixels = 0;
-
-                        // Populate histogram for the neighborhood in 3D
-                        for (int zz = std::max(0, z - kernelSize / 2); zz <= std::min(z + kernelSize / 2, num_imgs - 1); ++zz) {
-                            for (int ky = -kernelSize / 2; ky <= kernelSize / 2; ++ky) {
-                                for (int kx = -kernelSize / 2; kx <= kernelSize / 2; ++kx) {
-                                    int nx = std::max(0, std::min(x + kx, w - 1));
-                                    int ny = std::max(0, std::min(y + ky, h - 1));
-                                    unsigned char pixelValue = imgs[zz].get_data()[(ny * w + nx) * nc + c];
-                                    histogram[pixelValue]++;
-                                    totalPixels++;
+    visit_pixel_type(imgs[0].pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        for (int z = 0; z < num_imgs; ++z) {
+            if (z + edgeOffset < num_imgs) {
+                padded[(z + edgeOffset) % window].assign(imgs[z + edgeOffset].get_data(), BorderMode::Replicate);
+            }
+            const int first = std::max(0, z - edgeOffset), last = std::min(z + edgeOffset, num_imgs - 1);
+            T* out = imgs[z].pixels<T>();
+
+            // Each band of rows is independent since the window holds the unfiltered slices
+            Parallel::for_range(0, h, [&](int y0, int y1) {
+                std::vector<T> neighborhood;
+                for (int y = y0; y < y1; ++y) {
+                    for (int x = 0; x < w; ++x) {
+                        for (int c = 0; c < nc; ++c) { // Iterate through each channel
+                            if (nc == 4 && c == 3) continue; // Skip alpha channel for RGBA images
+
+                            if constexpr (!std::is_same_v<T, unsigned char>) {
+                                neighborhood.clear();
+                                for (int zz = first; zz <= last; ++zz) {
+                                    for (int ky = -edgeOffset; ky <= edgeOffset; ++ky) {
+                                        const T* row = reinterpret_cast<const T*>(padded[zz % window].row(y + ky)) + x * nc + c;
+                                        for (int kx = -edgeOffset; kx <= edgeOffset; ++kx) {
+                                            neighborhood.push_back(row[kx * nc]);
+                                        }
+                                    }
+                                }
+                                out[(y * w + x) * nc + c] = window_median(neighborhood);
+                            } else {
+                                int histogram[256] = {0};
+                                int totalPixels = 0;
+
+                                // Populate histogram for the neighborhood in 3D
+                                for (int zz = first; zz <= last; ++zz) {
+                                    const BorderedImage& slice = padded[zz % window];
+                                    for (int ky = -edgeOffset; ky <= edgeOffset; ++ky) {
+                                        const unsigned char* row = slice.row(y + ky) + x * nc + c;
+                                        for (int kx = -edgeOffset; kx <= edgeOffset; ++kx) {
+                                            histogram[row[kx * nc]]++;
+                                        }
+                                    }
+                                    totalPixels += (2 * edgeOffset + 1) * (2 * edgeOffset + 1);
+                                }
+
+                                // Find median from histogram
+                                int sum = 0;
+                                int median = 0;
+                                for (int i = 0; i < 256; ++i) {
+                                    sum += histogram[i];
+                                    if (sum >= (totalPixels / 2)) {
+                                        median = i;
+                                        break;
+                                    }
                                 }
-                            }
-                        }
 
-                        // Find median from histogram
-                        int sum = 0;
-                        int median = 0;
-                        for (int i = 0; i < 256; ++i) {
-                            sum += histogram[i];
-                            if (sum >= (totalPixels / 2)) {
-                                median = i;
-                                break;
+                                out[(y * w + x) * nc + c] = median;
                             }
                         }
-
-                        new_data[z][(y * w + x) * nc + c] = median;
                     }
                 }
-            }
+            }, 16);
+            imgs[z].invalidate_statistics();
         }
-    }
-
-    // Copy new data to original images and clean up
-    for (int i = 0; i < num_imgs; ++i) {
-        memcpy(imgs[i].get_data(), new_data[i], w * h * nc);
-        delete[] new_data[i];
-    }
+    });
 }
 
 
@@ -849,132 +1233,336 @@ void Filter::median_blur_3d(Volume &vol, int kernelSize) {
 void Filter::gaussian_blur_3d(Volume &vol, int kernelSize, double sigma) {
     std::vector<Image> imgs = vol.getImages();
     int num_imgs = imgs.size();
+    if (num_imgs == 0) return;
+    for (const Image& img : imgs) {
+        if (img.pixel_type() != imgs[0].pixel_type()) {
+            throw std::invalid_argument("All slices of the volume must have the same pixel type.");
+        }
+    }
 
     // get 1d gaussian kernel
     double *gaussianArray = Filter::getGaussianKernel(kernelSize, sigma);
 
-    // apply to x and y direction
-    for (int i = 0; i < num_imgs; i++) {
-        unsigned char* data = imgs[i].get_data();
-        int w = imgs[i].width();
-        int h = imgs[i].height();
-        int nc = imgs[i].channels();
-
-        auto *temp_x = new unsigned char[w * h * nc];
-        Filter::GaussBlur_x(data, temp_x, w, h, kernelSize, gaussianArray, nc);
-        Filter::GaussBlur_y(temp_x, data, w, h, kernelSize, gaussianArray, nc);
-
-        stbi_image_free(temp_x);
-    }
-
-    // apply to z direction
-    int w = imgs[0].width();
-    int h = imgs[0].height();
-    int nc = imgs[0].channels();
+    visit_pixel_type(imgs[0].pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        // apply to x and y direction
+        for (int i = 0; i < num_imgs; i++) {
+            T* data = imgs[i].pixels<T>();
+            int w = imgs[i].width();
+            int h = imgs[i].height();
+            int nc = imgs[i].channels();
+
+            ScratchBuffer<T> temp_x(static_cast<size_t>(w) * h * nc);
+            gauss_blur_x(data, temp_x.data(), w, h, kernelSize, gaussianArray, nc);
+            gauss_blur_y(temp_x.data(), data, w, h, kernelSize, gaussianArray, nc);
+        }
 
-    for (int z = 0; z < num_imgs; z++) {
-        unsigned char* data = imgs[z].get_data();
+        // apply to z direction
+        int w = imgs[0].width();
+        int h = imgs[0].height();
+        int nc = imgs[0].channels();
 
+        // The pass is in place along z, so each column of voxels is filtered in slice order; columns are
+        // independent, so rows are spread across threads with the slice loop inside
         int center = kernelSize / 2;
-        int ind = 0;
-        int img_ind = 0;
-        for (int i = 0; i < h; i++)
-        {
-            for (int j = 0; j < w; j++)
-            {
-                double sumR = 0.0, sumG = 0.0, sumB = 0.0;
-                for (int k = -center; k <= center; k++)
+        const auto column = with_channels(nc, [](auto c) {
+            return specialised<gauss_column_kernel<false, decltype(c)::value, T>>("gauss_column_trunc",
+                                                                                  PixelTraits<T>::name, c, 0);
+        });
+        Parallel::for_range(0, h, [&](int y0, int y1) {
+            ScratchBuffer<double> acc(static_cast<size_t>(GAUSS_BLOCK) * nc);
+            ScratchBuffer<const T*> rows(kernelSize);
+            for (int z = 0; z < num_imgs; z++) {
+                for (int i = y0; i < y1; i++)
                 {
-                    if (z + k < 0 || z + k >= num_imgs) {
-                        img_ind = z - k;
-                    } else {
-                        img_ind = z + k;
-                    }
-                    unsigned char * src = imgs[img_ind].get_data();
-                    ind = (i * w + j) * nc;
-                    sumR += src[ind] * gaussianArray[k + center];
-                    if (nc == 4) {
-                        sumG += src[ind + 1] * gaussianArray[k + center];
-                        sumB += src[ind + 2] * gaussianArray[k + center];
+                    for (int k = -center; k <= center; k++)
+                    {
+                        int img_ind = (z + k < 0 || z + k >= num_imgs) ? z - k : z + k;
+                        rows[k + center] = imgs[img_ind].pixels<T>() + i * w * nc;
                     }
-                }
-                ind = (i*w + j) * nc;
-                data[ind] = std::max(std::min(sumR, 255.0), 0.0);
-
-                if (nc == 4){
-                    data[ind + 1] = std::max(std::min(sumG, 255.0), 0.0);
-                    data[ind + 2] = std::max(std::min(sumB, 255.0), 0.0);
+                    column(rows.data(), kernelSize, gaussianArray, imgs[z].pixels<T>() + i * w * nc, w, nc,
+                           acc.data());
                 }
             }
-        }
+        });
+    });
+    for (int z = 0; z < num_imgs; z++) {
+        imgs[z].invalidate_statistics();
     }
 
     stbi_image_free(gaussianArray);
 }
 
 /**
- * @details Apply edge detection to the image using the specified kernels.
- * @author Yunting Tao
+ * @details Whether every tile within radius voxels of tile (tx, ty, tz) is the same constant tile, in which
+ * case any filter that preserves constants leaves the tile unchanged.
+ * @author Zhikang Dong
  */
-void Filter::apply_edge_detection(Image& img, const int horizontal_kernel[3][3], const int vertical_kernel[3][3]) {
-    int width = img.width();
-    int height = img.height();
+static bool constant_neighbourhood(const SparseVolume& vol, int tx, int ty, int tz, int radius) {
+    const auto& centre = vol.tile(tx, ty, tz);
+    if (!centre->constant) return false;
+    const int s = vol.tile_size();
+    const int x0 = std::max(0, tx * s - radius) / s, x1 = std::min(vol.width() - 1, (tx + 1) * s - 1 + radius) / s;
+    const int y0 = std::max(0, ty * s - radius) / s, y1 = std::min(vol.height() - 1, (ty + 1) * s - 1 + radius) / s;
+    const int z0 = std::max(0, tz * s - radius) / s, z1 = std::min(vol.depth() - 1, (tz + 1) * s - 1 + radius) / s;
+    for (int z = z0; z <= z1; ++z) {
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                if (vol.tile(x, y, z) != centre) return false;
+            }
+        }
+    }
+    return true;
+}
 
-    // Temporary array to store the result of edge detection
-    unsigned char* edge_pixels = new unsigned char[width * height];
+/**
+ * @details Calls filter(tx, ty, tz) for every tile in parallel to get its replacement, keeps the tiles whose
+ * neighbourhood is constant, and swaps the new tiles in at the end.
+ * @author Zhikang Dong
+ */
+template <typename F>
+static void filter_tiles(SparseVolume& vol, int radius, F&& filter) {
+    const int nx = vol.tiles_x(), ny = vol.tiles_y(), nz = vol.tiles_z();
+    std::vector<std::shared_ptr<const SparseTile>> filtered(static_cast<size_t>(nx) * ny * nz);
+    Parallel::for_range(0, static_cast<int>(filtered.size()), [&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            const int tx = i % nx, ty = (i / nx) % ny, tz = i / (nx * ny);
+            filtered[i] = constant_neighbourhood(vol, tx, ty, tz, radius) ? vol.tile(tx, ty, tz)
+                                                                           : vol.make_tile(filter(tx, ty, tz));
+        }
+    });
+    vol.set_tiles(std::move(filtered));
+}
 
-    // Apply edge detection operator
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            double gradient_x = 0.0;
-            double gradient_y = 0.0;
-            // Apply kernel
-            for (int j = -1; j <= 1; ++j) {
-                for (int i = -1; i <= 1; ++i) {
-                    // Calculate pixel coordinates, handling edge cases by replicating border pixels
-                    int pixelX = std::min(std::max(x + i, 0), width - 1);
-                    int pixelY = std::min(std::max(y + j, 0), height - 1);
-                    // Calculate the gradient in horizontal direction
-                    gradient_x += horizontal_kernel[j + 1][i + 1] * img.get_data()[(pixelY * width + pixelX)];
-                    // Calculate the gradient in vertical direction
-                    gradient_y += vertical_kernel[j + 1][i + 1] * img.get_data()[(pixelY * width + pixelX)];
+/**
+ * @details Each tile gathers its neighbourhood from the sparse volume and takes the median of every voxel with
+ * the rules of the dense filter: replicated borders in x and y, the slice range clamped in z, and the same rank
+ * for wider samples.
+ * @author Zhikang Dong
+ */
+void Filter::median_blur_3d(SparseVolume &vol, int kernelSize) {
+    const int w = vol.width(), h = vol.height(), d = vol.depth(), nc = vol.channels(), s = vol.tile_size();
+    const int r = kernelSize / 2;
+    visit_pixel_type(vol.pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        filter_tiles(vol, r, [&](int tx, int ty, int tz) {
+            int ex, ey, ez;
+            vol.tile_extent(tx, ty, tz, ex, ey, ez);
+            const int x0 = tx * s, y0 = ty * s, z0 = tz * s;
+            const int bx0 = std::max(0, x0 - r), bx1 = std::min(w, x0 + ex + r);
+            const int by0 = std::max(0, y0 - r), by1 = std::min(h, y0 + ey + r);
+            const int bz0 = std::max(0, z0 - r), bz1 = std::min(d, z0 + ez + r);
+            const int bw = bx1 - bx0, bh = by1 - by0;
+            std::vector<T> box(static_cast<size_t>(bw) * bh * (bz1 - bz0) * nc);
+            vol.gather(bx0, bx1, by0, by1, bz0, bz1, reinterpret_cast<unsigned char*>(box.data()));
+            auto at = [&](int x, int y, int z) {
+                return box.data() + ((static_cast<size_t>(z - bz0) * bh + (y - by0)) * bw + (x - bx0)) * nc;
+            };
+
+            std::vector<T> voxels(static_cast<size_t>(ex) * ey * ez * nc);
+            std::vector<T> neighborhood;
+            for (int z = z0; z < z0 + ez; ++z) {
+                const int first = std::max(0, z - r), last = std::min(z + r, d - 1);
+                const int totalPixels = (last - first + 1) * (2 * r + 1) * (2 * r + 1);
+                for (int y = y0; y < y0 + ey; ++y) {
+                    for (int x = x0; x < x0 + ex; ++x) {
+                        T* out = voxels.data() + ((static_cast<size_t>(z - z0) * ey + (y - y0)) * ex + (x - x0)) * nc;
+                        for (int c = 0; c < nc; ++c) {
+                            if (nc == 4 && c == 3) {
+                                out[c] = at(x, y, z)[c];
+                                continue;
+                            }
+                            if constexpr (!std::is_same_v<T, unsigned char>) {
+                                neighborhood.clear();
+                                for (int zz = first; zz <= last; ++zz) {
+                                    for (int ky = -r; ky <= r; ++ky) {
+                                        const int yy = std::clamp(y + ky, 0, h - 1);
+                                        for (int kx = -r; kx <= r; ++kx) {
+                                            neighborhood.push_back(at(std::clamp(x + kx, 0, w - 1), yy, zz)[c]);
+                                        }
+                                    }
+                                }
+                                out[c] = window_median(neighborhood);
+                            } else {
+                                int histogram[256] = {0};
+                                for (int zz = first; zz <= last; ++zz) {
+                                    for (int ky = -r; ky <= r; ++ky) {
+                                        const int yy = std::clamp(y + ky, 0, h - 1);
+                                        for (int kx = -r; kx <= r; ++kx) {
+                                            histogram[at(std::clamp(x + kx, 0, w - 1), yy, zz)[c]]++;
+                                        }
+                                    }
+                                }
+                                int sum = 0, median = 0;
+                                for (int i = 0; i < 256; ++i) {
+                                    sum += histogram[i];
+                                    if (sum >= (totalPixels / 2)) {
+                                        median = i;
+                                        break;
+                                    }
+                                }
+                                out[c] = static_cast<T>(median);
+                            }
+                        }
+                    }
                 }
             }
-            // Calculate the magnitude of gradient
-            double magnitude = sqrt(gradient_x * gradient_x + gradient_y * gradient_y);
-            magnitude = (magnitude > 255.0f) ? 255.0f : magnitude;
-            // Threshold the magnitude to obtain binary edges
-            edge_pixels[y * width + x] = magnitude;
+            std::vector<unsigned char> bytes(voxels.size() * sizeof(T));
+            std::memcpy(bytes.data(), voxels.data(), bytes.size());
+            return bytes;
+        });
+    });
+}
+
+/**
+ * @details Each tile gathers its neighbourhood and runs the three passes over it: x over the whole
+ * neighbourhood in y and z, y over the neighbourhood in z, then z over the tile. Taps past a border mirror
+ * about the output voxel, and the z pass truncates where x and y round, as in the dense passes.
+ * @author Zhikang Dong
+ */
+void Filter::gaussian_blur_3d(SparseVolume &vol, int kernelSize, double sigma) {
+    const int w = vol.width(), h = vol.height(), d = vol.depth(), nc = vol.channels(), s = vol.tile_size();
+    const int r = kernelSize / 2;
+    double* gaussianArray = Filter::getGaussianKernel(kernelSize, sigma);
+    auto mirror = [](int i, int k, int n) { return (i + k < 0 || i + k >= n) ? i - k : i + k; };
+
+    visit_pixel_type(vol.pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        filter_tiles(vol, r, [&](int tx, int ty, int tz) {
+            int ex, ey, ez;
+            vol.tile_extent(tx, ty, tz, ex, ey, ez);
+            const int x0 = tx * s, y0 = ty * s, z0 = tz * s;
+            const int bx0 = std::max(0, x0 - r), bx1 = std::min(w, x0 + ex + r);
+            const int by0 = std::max(0, y0 - r), by1 = std::min(h, y0 + ey + r);
+            const int bz0 = std::max(0, z0 - r), bz1 = std::min(d, z0 + ez + r);
+            const int bw = bx1 - bx0, bh = by1 - by0, bd = bz1 - bz0;
+            std::vector<T> box(static_cast<size_t>(bw) * bh * bd * nc);
+            vol.gather(bx0, bx1, by0, by1, bz0, bz1, reinterpret_cast<unsigned char*>(box.data()));
+
+            // passX holds bd x bh rows of the tile width, passY bd x ey rows
+            std::vector<T> passX(static_cast<size_t>(ex) * bh * bd * nc), passY(static_cast<size_t>(ex) * ey * bd * nc);
+            std::vector<T> voxels(static_cast<size_t>(ex) * ey * ez * nc);
+            for (int z = 0; z < bd; ++z) {
+                for (int y = 0; y < bh; ++y) {
+                    for (int x = x0; x < x0 + ex; ++x) {
+                        for (int c = 0; c < nc; ++c) {
+                            if (!gauss_blurs(c, nc)) continue;
+                            double sum = 0.0;
+                            for (int k = -r; k <= r; ++k) {
+                                const int xx = mirror(x, k, w) - bx0;
+                                sum += box[((static_cast<size_t>(z) * bh + y) * bw + xx) * nc + c] * gaussianArray[k + r];
+                            }
+                            passX[((static_cast<size_t>(z) * bh + y) * ex + (x - x0)) * nc + c] = gauss_sample<T>(sum);
+                        }
+                    }
+                }
+            }
+            for (int z = 0; z < bd; ++z) {
+                for (int y = y0; y < y0 + ey; ++y) {
+                    for (int x = 0; x < ex; ++x) {
+                        for (int c = 0; c < nc; ++c) {
+                            if (!gauss_blurs(c, nc)) continue;
+                            double sum = 0.0;
+                            for (int k = -r; k <= r; ++k) {
+                                const int yy = mirror(y, k, h) - by0;
+                                sum += passX[((static_cast<size_t>(z) * bh + yy) * ex + x) * nc + c] * gaussianArray[k + r];
+                            }
+                            passY[((static_cast<size_t>(z) * ey + (y - y0)) * ex + x) * nc + c] = gauss_sample<T>(sum);
+                        }
+                    }
+                }
+            }
+            for (int z = z0; z < z0 + ez; ++z) {
+                for (int y = 0; y < ey; ++y) {
+                    for (int x = 0; x < ex; ++x) {
+                        const size_t at = ((static_cast<size_t>(z - z0) * ey + y) * ex + x) * nc;
+                        const size_t original = ((static_cast<size_t>(z - bz0) * bh + (y + y0 - by0)) * bw + (x + x0 - bx0)) * nc;
+                        for (int c = 0; c < nc; ++c) {
+                            if (!gauss_blurs(c, nc)) {
+                                voxels[at + c] = box[original + c];
+                                continue;
+                            }
+                            double sum = 0.0;
+                            for (int k = -r; k <= r; ++k) {
+                                const int zz = mirror(z, k, d) - bz0;
+                                sum += passY[((static_cast<size_t>(zz) * ey + y) * ex + x) * nc + c] * gaussianArray[k + r];
+                            }
+                            voxels[at + c] = gauss_sample<T, false>(sum);
+                        }
+                    }
+                }
+            }
+            std::vector<unsigned char> bytes(voxels.size() * sizeof(T));
+            std::memcpy(bytes.data(), voxels.data(), bytes.size());
+            return bytes;
+        });
+    });
+    delete[] gaussianArray;
+}
+
+/**
+ * @details Apply 3D CLAHE to the volume, equalizing each colour channel over blocks of neighbouring slices
+ * (the alpha channel is left untouched).
+ * @author Zhikang Dong
+ */
+void Filter::clahe_3d(Volume &vol, int tiles, int tilesZ, double clipLimit) {
+    require_8bit(vol, "3D CLAHE");
+    std::vector<Image> imgs = vol.getImages();
+    if (imgs.empty()) return;
+
+    int w = imgs[0].width();
+    int h = imgs[0].height();
+    int nc = imgs[0].channels();
+
+    std::vector<unsigned char*> slices(imgs.size());
+    for (int c = 0; c < nc; ++c) {
+        if (nc == 4 && c == 3) continue; // Skip alpha
+        for (size_t z = 0; z < imgs.size(); ++z) {
+            slices[z] = imgs[z].get_data() + c;
         }
+        Clahe::equalize_volume(slices, w, h, nc, tiles, tiles, tilesZ, clipLimit);
     }
 
-    // Copy the result back to the image
-    for (int i = 0; i < width * height; ++i) {
-        img.get_data()[i] = edge_pixels[i];
+    for (auto& img : imgs) {
+        img.invalidate_statistics();
+    }
+}
+
+/**
+ * @details Apply edge detection to the image using the specified gradient operator.
+ * The gradient is evaluated by the fused integer engine in gradient.cpp, which shares the row loads between Gx and Gy
+ * and only clamps at the border. Colour images are converted to grayscale first.
+ * @author Yunting Tao
+ * @author Zhikang Dong
+ */
+void Filter::apply_edge_detection(Image& img, GradientOperator op, GradientMagnitude mode) {
+    require_8bit(img, "Edge detection");
+    if (img.channels() >= 3) {
+        RGB2Gray(img);
     }
+    int width = img.width();
+    int height = img.height();
 
-    // Free memory allocated for temporary array
-    delete[] edge_pixels;
+    // The result is written to a fresh buffer that replaces the image data, so no copy back is needed
+    unsigned char* edge_pixels = LargeBuffer::allocate(height, width);
+    Gradient::magnitude(img.get_data(), edge_pixels, width, height, op, mode);
+    img.set_data(edge_pixels);
 }
 
 /**
  * @details Apply Sobel edge detection to the image.
  * @author Yunting Tao
  */
-void Filter::apply_sobel_edge_detection(Image& img) {
-    int sobel_horizontal[3][3] = { {-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1} };
-    int sobel_vertical[3][3] = { {-1, -2, -1}, {0, 0, 0}, {1, 2, 1} };
-    apply_edge_detection(img, sobel_horizontal, sobel_vertical);
+void Filter::apply_sobel_edge_detection(Image& img, GradientMagnitude mode) {
+    apply_edge_detection(img, GradientOperator::Sobel, mode);
 }
 
 /**
  * @details Apply Prewitt edge detection to the image.
  * @author Yunting Tao
  */
-void Filter::apply_prewitt_edge_detection(Image& img) {
-    int prewitt_horizontal[3][3] = { {-1, -1, -1}, {0, 0, 0}, {1, 1, 1} };
-    int prewitt_vertical[3][3] = { {-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1} };
-    apply_edge_detection(img, prewitt_horizontal, prewitt_vertical);
+void Filter::apply_prewitt_edge_detection(Image& img, GradientMagnitude mode) {
+    apply_edge_detection(img, GradientOperator::Prewitt, mode);
 }
 
 /**
@@ -982,10 +1570,28 @@ void Filter::apply_prewitt_edge_detection(Image& img) {
  * @author Chuhan Li
  * @author Yunting Tao
  */
-void Filter::apply_scharr_edge_detection(Image& img) {
-    int scharr_horizontal[3][3] = { {-3, 0, 3}, {-10, 0, 10}, {-3, 0, 3} };
-    int scharr_vertical[3][3] = { {-3, -10, -3}, {0, 0, 0}, {3, 10, 3} };
-    apply_edge_detection(img, scharr_horizontal, scharr_vertical);
+void Filter::apply_scharr_edge_detection(Image& img, GradientMagnitude mode) {
+    apply_edge_detection(img, GradientOperator::Scharr, mode);
+}
+
+/**
+ * @details Apply Canny edge detection to the image.
+ * The image is smoothed, its Sobel gradient is thinned by non-maximum suppression and the remaining pixels are kept
+ * if they are above the high threshold or connected to such a pixel through pixels above the low threshold.
+ * Colour images are converted to grayscale first.
+ * @author Zhikang Dong
+ */
+void Filter::apply_canny_edge_detection(Image& img, int lowThreshold, int highThreshold, double sigma, int kernelSize) {
+    require_8bit(img, "Canny edge detection");
+    if (img.channels() >= 3) {
+        RGB2Gray(img);
+    }
+    int width = img.width();
+    int height = img.height();
+
+    unsigned char* edge_pixels = LargeBuffer::allocate(height, width);
+    Canny::detect(img.get_data(), edge_pixels, width, height, lowThreshold, highThreshold, sigma, kernelSize);
+    img.set_data(edge_pixels);
 }
 
 /**
@@ -995,26 +1601,29 @@ void Filter::apply_scharr_edge_detection(Image& img) {
  * @author Georgia Ray
  */
 void Filter::apply_roberts_edge_detection(Image& img) {
+    require_8bit(img, "Edge detection");
     // Roberts' Cross edge detection kernels
     int width = img.width();
     int height = img.height();
 
     // Temporary array to store the result of edge detection
-    unsigned char* edge_pixels = new unsigned char[width * height];
+    ScratchBuffer<unsigned char> edge_pixels(static_cast<size_t>(width) * height);
 
     // Apply edge detection operator
-    for (int y = 0; y < height - 1; ++y) {
-        for (int x = 0; x < width - 1; ++x) {
-            // Apply Roberts' Cross operator
-            int gx = img.get_data()[y * width + x] - img.get_data()[(y + 1) * width + (x + 1)];
-            int gy = img.get_data()[(y + 1) * width + x] - img.get_data()[y * width + (x + 1)];
-            // Calculate the magnitude of gradient
-            double magnitude = sqrt(gx * gx + gy * gy);
-            magnitude = (magnitude > 255.0f) ? 255.0f : magnitude;
-            // Threshold the magnitude to obtain binary edges
-            edge_pixels[y * width + x] = magnitude;
+    Parallel::for_range(0, height - 1, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < width - 1; ++x) {
+                // Apply Roberts' Cross operator
+                int gx = img.get_data()[y * width + x] - img.get_data()[(y + 1) * width + (x + 1)];
+                int gy = img.get_data()[(y + 1) * width + x] - img.get_data()[y * width + (x + 1)];
+                // Calculate the magnitude of gradient
+                double magnitude = sqrt(gx * gx + gy * gy);
+                magnitude = (magnitude > 255.0f) ? 255.0f : magnitude;
+                // Threshold the magnitude to obtain binary edges
+                edge_pixels[y * width + x] = magnitude;
+            }
         }
-    }
+    });
 
     // Handle the last row and column of the image
     // We replicate the last row and column of the image to handle the edge cases
@@ -1044,8 +1653,6 @@ void Filter::apply_roberts_edge_detection(Image& img) {
     for (int i = 0; i < width * height; ++i) {
         img.get_data()[i] = edge_pixels[i];
     }
-
-    // Free memory allocated for temporary array
-    delete[] edge_pixels;
+    img.invalidate_statistics();
 }
 
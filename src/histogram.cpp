@@ -0,0 +1,135 @@
+/**
+* @file histogram.cpp
+* @brief this file contains the implementation of the parallel histogram and statistics engine.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cmath>
+#include "histogram.h"
+#include "parallel.h"
+
+/**
+ * @details Exact, since the sum is accumulated in integers.
+ * @author Zhikang Dong
+ */
+double ImageStatistics::mean() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count);
+}
+
+/**
+ * @details Walks the cumulative histogram until it reaches ceil(percent / 100 * count) samples.
+ * @author Zhikang Dong
+ */
+unsigned char ImageStatistics::percentile(double percent) const {
+    if (count == 0) return 0;
+    percent = std::min(std::max(percent, 0.0), 100.0);
+    uint64_t target = static_cast<uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(count)));
+    if (target == 0) return min;
+
+    uint64_t cumulative = 0;
+    for (int i = 0; i < 256; ++i) {
+        cumulative += histogram[i];
+        if (cumulative >= target) return static_cast<unsigned char>(i);
+    }
+    return max;
+}
+
+/**
+ * @details Rows are counted in parallel; each chunk fills a private histogram that is merged under a lock.
+ * @author Zhikang Dong
+ */
+ImageStatistics Histogram::compute(const unsigned char* data, int w, int h, int channels) {
+    ImageStatistics stats;
+    std::mutex statsMutex;
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        uint64_t local[256] = {0};
+        accumulate(data + static_cast<size_t>(y0) * w * channels, static_cast<size_t>(y1 - y0) * w, channels, local);
+        std::lock_guard<std::mutex> guard(statsMutex);
+        for (int i = 0; i < 256; ++i) {
+            stats.histogram[i] += local[i];
+        }
+    }, 16);
+    summarise(stats);
+    return stats;
+}
+
+/**
+ * @details Adds the histograms and recomputes the summary values.
+ * @author Zhikang Dong
+ */
+void Histogram::merge(ImageStatistics& into, const ImageStatistics& other) {
+    for (int i = 0; i < 256; ++i) {
+        into.histogram[i] += other.histogram[i];
+    }
+    summarise(into);
+}
+
+/**
+ * @details Counts into four interleaved 32-bit histograms so consecutive equal samples hit different counters,
+ * flushing them into the 64-bit result every block so the 32-bit counters cannot overflow.
+ * @author Zhikang Dong
+ */
+void Histogram::accumulate(const unsigned char* data, size_t n, int channels, uint64_t* hist) {
+    constexpr size_t FLUSH = size_t(1) << 30;
+    uint32_t bins[4][256];
+
+    for (size_t start = 0; start < n; start += FLUSH) {
+        const size_t len = std::min(FLUSH, n - start);
+        const unsigned char* p = data + start * channels;
+        std::fill(&bins[0][0], &bins[0][0] + 4 * 256, 0u);
+
+        if (channels == 4) {
+            // Skip alpha
+            for (size_t i = 0; i < len; ++i) {
+                bins[0][p[4 * i]]++;
+                bins[1][p[4 * i + 1]]++;
+                bins[2][p[4 * i + 2]]++;
+            }
+        } else {
+            const size_t m = len * channels;
+            size_t i = 0;
+            for (; i + 4 <= m; i += 4) {
+                bins[0][p[i]]++;
+                bins[1][p[i + 1]]++;
+                bins[2][p[i + 2]]++;
+                bins[3][p[i + 3]]++;
+            }
+            for (; i < m; ++i) {
+                bins[0][p[i]]++;
+            }
+        }
+
+        for (int v = 0; v < 256; ++v) {
+            hist[v] += static_cast<uint64_t>(bins[0][v]) + bins[1][v] + bins[2][v] + bins[3][v];
+        }
+    }
+}
+
+/**
+ * @details Derives count, sum, min and max with one scan over the 256 bins.
+ * @author Zhikang Dong
+ */
+void Histogram::summarise(ImageStatistics& stats) {
+    stats.count = 0;
+    stats.sum = 0;
+    stats.min = 0;
+    stats.max = 0;
+    bool first = true;
+    for (int v = 0; v < 256; ++v) {
+        if (stats.histogram[v] == 0) continue;
+        stats.count += stats.histogram[v];
+        stats.sum += stats.histogram[v] * static_cast<uint64_t>(v);
+        if (first) {
+            stats.min = static_cast<unsigned char>(v);
+            first = false;
+        }
+        stats.max = static_cast<unsigned char>(v);
+    }
+}
@@ -0,0 +1,177 @@
+/**
+* @file largebuffer.cpp
+* @brief this file contains the implementation of the huge-page aware large-buffer allocator.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "largebuffer.h"
+#include "parallel.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/resource.h>
+#define LARGEBUFFER_LINUX 1
+#else
+#define LARGEBUFFER_LINUX 0
+#endif
+
+namespace {
+
+constexpr size_t HUGE_PAGE = size_t(2) << 20; /**< The transparent huge page size on x86-64 and most AArch64. */
+constexpr size_t PAGE = 4096;                 /**< The base page size the fault estimate is counted in. */
+
+bool env_flag(const char* name, bool fallback) {
+    const char* env = std::getenv(name);
+    if (env == nullptr || *env == '\0') return fallback;
+    return std::atoi(env) != 0;
+}
+
+std::atomic<bool> hugePages{env_flag("IMAGE_HUGE_PAGES", true)};
+std::atomic<bool> firstTouch{env_flag("IMAGE_FIRST_TOUCH", true)};
+std::atomic<size_t> largeThreshold{HUGE_PAGE};
+
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> hugeAllocations{0};
+std::atomic<size_t> totalBytes{0};
+std::atomic<size_t> hugeBytes{0};
+std::atomic<uint64_t> faultsExpected{0};
+std::atomic<uint64_t> faultsMeasured{0};
+
+long minor_faults() {
+#if LARGEBUFFER_LINUX
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Allocates an untouched buffer: a plain malloc below the threshold, otherwise 2 MiB aligned (rounded
+ * up to whole huge pages so the tail can be promoted too) and advised.
+ * @param large Set to whether the buffer is large.
+ */
+unsigned char* reserve(size_t bytes, bool& large) {
+    large = bytes >= largeThreshold.load(std::memory_order_relaxed);
+    if (!large) {
+        auto* data = static_cast<unsigned char*>(std::malloc(bytes > 0 ? bytes : 1));
+        if (data == nullptr) throw std::bad_alloc();
+        return data;
+    }
+
+    const size_t rounded = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    auto* data = static_cast<unsigned char*>(std::aligned_alloc(HUGE_PAGE, rounded));
+    if (data == nullptr) throw std::bad_alloc();
+    ++allocations;
+    totalBytes += bytes;
+
+#if LARGEBUFFER_LINUX && defined(MADV_HUGEPAGE)
+    if (hugePages.load(std::memory_order_relaxed) && madvise(data, rounded, MADV_HUGEPAGE) == 0) {
+        ++hugeAllocations;
+        hugeBytes += rounded;
+    }
+#endif
+    return data;
+}
+
+/**
+ * @brief Runs touch over the rows of a large buffer in parallel bands and counts the faults it takes.
+ */
+template <typename F>
+void touch_rows(size_t rows, size_t rowBytes, F&& touch) {
+    const long before = minor_faults();
+    Parallel::for_range(0, static_cast<int>(rows), [&](int r0, int r1) {
+        touch(r0 * rowBytes, static_cast<size_t>(r1 - r0) * rowBytes);
+    });
+    const long measured = minor_faults() - before;
+    faultsExpected += (rows * rowBytes + PAGE - 1) / PAGE;
+    faultsMeasured += measured > 0 ? static_cast<uint64_t>(measured) : 0;
+}
+
+} // namespace
+
+/**
+ * @details Small buffers are plain mallocs. Large ones are aligned, advised and touched row band by row band
+ * in parallel.
+ * @author Zhikang Dong
+ */
+unsigned char* LargeBuffer::allocate(size_t rows, size_t rowBytes) {
+    bool large = false;
+    unsigned char* data = reserve(rows * rowBytes, large);
+    if (large && firstTouch.load(std::memory_order_relaxed) && rows > 0) {
+        touch_rows(rows, rowBytes, [&](size_t at, size_t bytes) { std::memset(data + at, 0, bytes); });
+    }
+    return data;
+}
+
+/**
+ * @details A large buffer is filled by the same parallel row bands as the first touch of allocate(), so it is
+ * written once instead of zeroed and then copied; with first touch disabled, the copy is serial.
+ * @author Zhikang Dong
+ */
+unsigned char* LargeBuffer::copy(const unsigned char* src, size_t rows, size_t rowBytes) {
+    bool large = false;
+    unsigned char* data = reserve(rows * rowBytes, large);
+    if (large && firstTouch.load(std::memory_order_relaxed) && rows > 0) {
+        touch_rows(rows, rowBytes, [&](size_t at, size_t bytes) { std::memcpy(data + at, src + at, bytes); });
+    } else {
+        std::memcpy(data, src, rows * rowBytes);
+    }
+    return data;
+}
+
+void LargeBuffer::set_huge_pages(bool enabled) {
+    hugePages = enabled;
+}
+
+bool LargeBuffer::huge_pages() {
+    return hugePages;
+}
+
+void LargeBuffer::set_first_touch(bool enabled) {
+    firstTouch = enabled;
+}
+
+bool LargeBuffer::first_touch() {
+    return firstTouch;
+}
+
+void LargeBuffer::set_threshold(size_t bytes) {
+    largeThreshold = bytes;
+}
+
+size_t LargeBuffer::threshold() {
+    return largeThreshold;
+}
+
+LargeBufferStatistics LargeBuffer::statistics() {
+    LargeBufferStatistics stats;
+    stats.allocations = allocations;
+    stats.hugeAllocations = hugeAllocations;
+    stats.bytes = totalBytes;
+    stats.hugeBytes = hugeBytes;
+    stats.faultsExpected = faultsExpected;
+    stats.faultsMeasured = faultsMeasured;
+    stats.faultsAvoided = stats.faultsExpected > stats.faultsMeasured ? stats.faultsExpected - stats.faultsMeasured : 0;
+    return stats;
+}
+
+void LargeBuffer::reset_statistics() {
+    allocations = 0;
+    hugeAllocations = 0;
+    totalBytes = 0;
+    hugeBytes = 0;
+    faultsExpected = 0;
+    faultsMeasured = 0;
+}
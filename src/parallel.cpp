@@ -0,0 +1,311 @@
+/**
+* @file parallel.cpp
+* @brief this file contains the implementation of the Parallel class and the work-stealing thread pool behind it.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+namespace {
+
+/**
+ * @brief One parallel loop in flight: its body, the number of unfinished chunks and the first exception thrown.
+ */
+struct Job {
+    const std::function<void(int, int)>* body = nullptr; /**< The loop body. */
+    bool stealable = true;                               /**< Whether idle threads may take chunks of other threads. */
+    std::atomic<int> remaining{0};                       /**< The number of chunks not yet finished. */
+    std::mutex errorMutex;                               /**< Guards error. */
+    std::exception_ptr error;                            /**< The first exception thrown by the body. */
+};
+
+/**
+ * @brief A chunk [begin, end) of a job.
+ */
+struct Task {
+    Job* job;  /**< The job the chunk belongs to. */
+    int begin; /**< The first index of the chunk. */
+    int end;   /**< One past the last index of the chunk. */
+};
+
+/**
+ * @brief The task queue of one thread; the owner pops from the front, thieves take from the back.
+ */
+struct Queue {
+    std::mutex mutex;      /**< Guards tasks. */
+    std::deque<Task> tasks; /**< The queued chunks. */
+};
+
+thread_local bool insideLoop = false; /**< Set while a thread runs a loop body, so nested loops run serially. */
+
+/**
+ * @brief The persistent pool: queue 0 belongs to whichever thread starts a loop, queues 1.. to the workers.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) : queues(threads) {
+        for (auto& q : queues) {
+            q = std::make_unique<Queue>();
+        }
+        for (int i = 1; i < threads; ++i) {
+            workers.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    int size() const {
+        return static_cast<int>(queues.size());
+    }
+
+    /**
+     * @brief Deals the chunks onto the queues, helps until they are all done and rethrows the first exception.
+     */
+    void run(const std::vector<Task>& tasks, Job& job) {
+        // Loops started from different external threads share queue 0, so only one may be dealt at a time
+        std::lock_guard<std::mutex> callerLock(callerMutex);
+        job.remaining = static_cast<int>(tasks.size());
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            Queue& q = *queues[i % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(tasks[i]);
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            ++generation;
+        }
+        wake.notify_all();
+
+        while (job.remaining.load(std::memory_order_acquire) > 0) {
+            Task task;
+            if (pop(0, task) || (job.stealable && steal(0, task))) {
+                execute(task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        if (job.error) std::rethrow_exception(job.error);
+    }
+
+private:
+    std::vector<std::unique_ptr<Queue>> queues; /**< One queue per thread. */
+    std::vector<std::thread> workers;           /**< The worker threads. */
+    std::mutex callerMutex;                     /**< Serialises loops started by different external threads. */
+    std::mutex sleepMutex;                      /**< Guards generation and stopping. */
+    std::condition_variable wake;               /**< Wakes idle workers when chunks are queued. */
+    unsigned long long generation = 0;          /**< Bumped every time a loop deals its chunks. */
+    bool stopping = false;                      /**< Set when the pool shuts down. */
+
+    bool pop(int self, Task& task) {
+        Queue& q = *queues[self];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        task = q.tasks.front();
+        q.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(int self, Task& task) {
+        const int n = size();
+        for (int k = 1; k < n; ++k) {
+            Queue& q = *queues[(self + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty() || !q.tasks.back().job->stealable) continue;
+            task = q.tasks.back();
+            q.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    static void execute(const Task& task) {
+        Job& job = *task.job;
+        const bool outer = !insideLoop;
+        insideLoop = true;
+        try {
+            (*job.body)(task.begin, task.end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(job.errorMutex);
+            if (!job.error) job.error = std::current_exception();
+        }
+        if (outer) insideLoop = false;
+        job.remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void worker_loop(int self) {
+        insideLoop = true;
+        while (true) {
+            unsigned long long seen;
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                if (stopping) return;
+                seen = generation;
+            }
+            Task task;
+            if (pop(self, task) || steal(self, task)) {
+                execute(task);
+                continue;
+            }
+            // Nothing to do: sleep until a later loop deals new chunks
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+        }
+    }
+};
+
+std::mutex poolMutex;                /**< Guards pool and requestedThreads. */
+std::unique_ptr<ThreadPool> pool;    /**< The pool, created on first use. */
+int requestedThreads = 0;            /**< The thread count set at runtime, or 0 for the default. */
+std::atomic<bool> deterministicMode{false}; /**< Whether loops use deterministic chunking. */
+
+int default_threads() {
+    if (const char* env = std::getenv("IMAGE_NUM_THREADS")) {
+        int n = std::atoi(env);
+        if (n > 0) return n;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool& get_pool() {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (!pool) {
+        pool = std::make_unique<ThreadPool>(requestedThreads > 0 ? requestedThreads : default_threads());
+    }
+    return *pool;
+}
+
+} // namespace
+
+/**
+ * @details Reads the size of the pool, creating it if needed.
+ * @author Zhikang Dong
+ */
+int Parallel::num_threads() {
+    return get_pool().size();
+}
+
+/**
+ * @details Drops the current pool; the next loop starts one with the new size.
+ * @author Zhikang Dong
+ */
+void Parallel::set_num_threads(int threads) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    requestedThreads = std::max(threads, 0);
+    pool.reset();
+}
+
+void Parallel::set_deterministic(bool deterministic) {
+    deterministicMode = deterministic;
+}
+
+/**
+ * @details Cuts the range into chunks of at least grain indices: four per thread so that stealing can balance
+ * the load, or exactly one per thread in deterministic mode. A single chunk, or a call made from inside another
+ * loop's body, runs directly on the calling thread.
+ * @author Zhikang Dong
+ */
+void Parallel::for_range(int begin, int end, const std::function<void(int, int)>& body, int grain) {
+    int n = end - begin;
+    if (n <= 0) return;
+    grain = std::max(grain, 1);
+
+    if (insideLoop) {
+        body(begin, end);
+        return;
+    }
+
+    ThreadPool& threads = get_pool();
+    const bool deterministic = deterministicMode;
+    const int perThread = threads.size() == 1 ? 0 : (deterministic ? 1 : 4);
+    int chunks = std::min(threads.size() * perThread, (n + grain - 1) / grain);
+    if (chunks <= 1) {
+        struct Guard {
+            Guard() { insideLoop = true; }
+            ~Guard() { insideLoop = false; }
+        } guard;
+        body(begin, end);
+        return;
+    }
+
+    Job job;
+    job.body = &body;
+    job.stealable = !deterministic;
+    std::vector<Task> tasks(chunks);
+    for (int i = 0; i < chunks; ++i) {
+        tasks[i].job = &job;
+        tasks[i].begin = begin + static_cast<int>(static_cast<long long>(n) * i / chunks);
+        tasks[i].end = begin + static_cast<int>(static_cast<long long>(n) * (i + 1) / chunks);
+    }
+    threads.run(tasks, job);
+}
+
+/**
+ * @details Numbers the blocks row-major and runs them as a 1D loop, so 2D blocks are stolen like any chunk.
+ * @author Zhikang Dong
+ */
+void Parallel::for_range_2d(int y0, int y1, int x0, int x1,
+                            const std::function<void(int, int, int, int)>& body, int grainY, int grainX) {
+    if (y1 <= y0 || x1 <= x0) return;
+    grainY = std::max(grainY, 1);
+    if (grainX <= 0) grainX = x1 - x0;
+    const int blocksY = (y1 - y0 + grainY - 1) / grainY;
+    const int blocksX = (x1 - x0 + grainX - 1) / grainX;
+
+    for_range(0, blocksY * blocksX, [&](int b0, int b1) {
+        for (int b = b0; b < b1; ++b) {
+            const int by = y0 + (b / blocksX) * grainY;
+            const int bx = x0 + (b % blocksX) * grainX;
+            body(by, std::min(by + grainY, y1), bx, std::min(bx + grainX, x1));
+        }
+    });
+}
+
+/**
+ * @details Numbers the boxes slice-major and runs them as a 1D loop.
+ * @author Zhikang Dong
+ */
+void Parallel::for_range_3d(int z0, int z1, int y0, int y1, int x0, int x1,
+                            const std::function<void(int, int, int, int, int, int)>& body,
+                            int grainZ, int grainY, int grainX) {
+    if (z1 <= z0 || y1 <= y0 || x1 <= x0) return;
+    grainZ = std::max(grainZ, 1);
+    if (grainY <= 0) grainY = y1 - y0;
+    if (grainX <= 0) grainX = x1 - x0;
+    const int boxesZ = (z1 - z0 + grainZ - 1) / grainZ;
+    const int boxesY = (y1 - y0 + grainY - 1) / grainY;
+    const int boxesX = (x1 - x0 + grainX - 1) / grainX;
+
+    for_range(0, boxesZ * boxesY * boxesX, [&](int b0, int b1) {
+        for (int b = b0; b < b1; ++b) {
+            const int bz = z0 + (b / (boxesY * boxesX)) * grainZ;
+            const int by = y0 + ((b / boxesX) % boxesY) * grainY;
+            const int bx = x0 + (b % boxesX) * grainX;
+            body(bz, std::min(bz + grainZ, z1), by, std::min(by + grainY, y1), bx, std::min(bx + grainX, x1));
+        }
+    });
+}
@@ -10,42 +10,187 @@
 * @date 19/03/2024
 */
 
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
 #include "projection.h"
 #include "filter.h"
+#include "parallel.h"
+#include "dispatch.h"
+#include "largebuffer.h"
+#include "scratch.h"
+#include "sparse.h"
 
 /**
- * @details This function computes the Maximum Intensity Projection (MIP) from the given Volume.
- * Volume is a class that contains a vector of Image objects. The MIP is computed by taking the maximum pixel value of each Image in the Volume.
- * @author Shengzhi Tian
+ * @brief The number of pixels a projection reduces at a time, small enough for the partial results to stay in L1.
+ */
+static constexpr int BLOCK = 4096;
+
+/**
+ * @details Folds one slice into the running maximum.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static KERNEL_INLINE void max_kernel(T* acc, const T* src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        acc[i] = std::max(acc[i], src[i]);
+    }
+}
+
+/**
+ * @details Folds one slice into the running minimum.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static KERNEL_INLINE void min_kernel(T* acc, const T* src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        acc[i] = std::min(acc[i], src[i]);
+    }
+}
+
+/**
+ * @details Adds one slice to the running sums.
+ * @author Zhikang Dong
+ */
+template <typename T>
+static KERNEL_INLINE void accumulate_kernel(double* acc, const T* src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        acc[i] += src[i];
+    }
+}
+
+/**
+ * @details Calls fold(z0, last, slices) on consecutive batches of slices held in memory together: the whole
+ * volume for a fully loaded one, or as many slices as a lazy volume keeps resident, fetched in parallel.
+ * @author Zhikang Dong
+ */
+template <typename F>
+static void for_slice_batches(const Volume& vol, F&& fold) {
+    const int depth = vol.depth();
+    const size_t limit = vol.resident_limit();
+    const int batch = (limit > 0) ? static_cast<int>(std::min<size_t>(limit, depth)) : depth;
+    for (int z0 = 0; z0 < depth; z0 += batch) {
+        const int z1 = std::min(z0 + batch, depth);
+        std::vector<std::shared_ptr<Image>> slices(z1 - z0);
+        Parallel::for_range(z0, z1, [&](int a, int b) {
+            for (int z = a; z < b; ++z) slices[z - z0] = vol.at(z);
+        }, 1);
+        fold(z0, z1 == depth, slices);
+    }
+}
+
+/**
+ * @details Folds the slices of one block best first, by the bounds of their bricks, and stops once no slice
+ * left can change the block: for a maximum, once the largest sample their bricks allow is no more than the
+ * smallest value of the block so far. That value is measured again after 1, 2, 4, ... folds, so a dense
+ * block costs a few extra passes at most while a block of air is read once.
+ * @author Zhikang Dong
+ */
+template <typename T, typename Fold>
+static void fold_pruned(T* out, int b0, int b1, int z0, const std::vector<std::shared_ptr<Image>>& slices,
+                        const BrickGrid& grid, int w, int c, bool maximum, const Fold& fold) {
+    // The rows of the block, and its columns when it lies within one row
+    const int p0 = b0 / c, p1 = (b1 - 1) / c;
+    const int y0 = p0 / w, y1 = p1 / w + 1;
+    const int x0 = (y1 - y0 == 1) ? p0 % w : 0, x1 = (y1 - y0 == 1) ? p1 % w + 1 : w;
+
+    std::vector<std::pair<double, int>> order(slices.size());
+    for (size_t j = 0; j < slices.size(); ++j) {
+        const int z = z0 + static_cast<int>(j);
+        const Brick bound = grid.bounds(x0, x1, y0, y1, z, z + 1);
+        order[j] = {maximum ? -bound.max : bound.min, static_cast<int>(j)};
+    }
+    std::sort(order.begin(), order.end());
+
+    auto measure = [&]() -> double {
+        return maximum ? *std::min_element(out + b0, out + b1) : *std::max_element(out + b0, out + b1);
+    };
+    double limit = measure();
+    int folded = 0, next = 1;
+    for (const auto& [key, j] : order) {
+        const double bound = maximum ? -key : key;
+        if (maximum ? bound <= limit : bound >= limit) break;
+        fold(out + b0, slices[j]->template pixels<T>() + b0, b1 - b0);
+        if (++folded == next) {
+            next *= 2;
+            limit = measure();
+        }
+    }
+}
+
+/**
+ * @details Applies the 3D filter of a projection and gets the volume to project. The volume itself is filtered
+ * in place, as it always was; a reduced level is a cached preview, so a copy of it is filtered instead and the
+ * pyramid keeps the level as built.
+ * @param filtered Receives the filtered copy of a reduced level, which must outlive the returned reference.
+ * @author Zhikang Dong
  */
-Image Projection::MIP(Volume &vol, const int& filter_method, int kernelSize, double sigma) {
+static Volume& filtered_level(Volume& vol, int level, int filter_method, int kernelSize, double sigma,
+                              std::unique_ptr<Volume>& filtered) {
+    if (filter_method != 1 && filter_method != 2 && filter_method != 3 && filter_method != 4) {
+        throw std::invalid_argument("Unsupported filter method");
+    }
+    Volume& source = vol.level(level);
+    if (filter_method == 3) return source;
+    if (level > 0) {
+        filtered = std::make_unique<Volume>(source.copy());
+    }
+    Volume& target = filtered ? *filtered : source;
     if (filter_method == 1) {
-        Filter::gaussian_blur_3d(vol, kernelSize, sigma);
+        Filter::gaussian_blur_3d(target, kernelSize, sigma);
     } else if (filter_method == 2) {
-        Filter::median_blur_3d(vol, kernelSize);
-    } else if (filter_method == 3) {
-        // Do nothing
+        Filter::median_blur_3d(target, kernelSize);
     } else {
-        throw std::invalid_argument("Unsupported filter method");
+        Filter::clahe_3d(target);
     }
+    return target;
+}
 
-    std::vector<Image> imgs = vol.getImages();
-    int num_imgs = imgs.size();
-    int w = imgs[0].width();
-    int h = imgs[0].height();
-    int c = imgs[0].channels();
-
-    auto* data = new unsigned char[w * h * c];
-    for (int i = 0; i < w * h * c; i++) {
-        unsigned char max_val = 0;
-        for (int z = 0; z < num_imgs; z++) {
-            unsigned char* img_data = imgs[z].get_data();
-            max_val = std::max(max_val, img_data[i]);
-        }
-        data[i] = max_val;
-    }
+/**
+ * @details This function computes the Maximum Intensity Projection (MIP) from the given Volume.
+ * Volume is a class that contains a vector of Image objects. The MIP is computed by taking the maximum pixel value of each Image in the Volume.
+ * @author Shengzhi Tian
+ */
+Image Projection::MIP(Volume &vol, const int& filter_method, int kernelSize, double sigma, int level) {
+    // A reduced level stands in for the whole volume, so previews cost a fraction of a full pass
+    std::unique_ptr<Volume> filtered;
+    Volume& source = filtered_level(vol, level, filter_method, kernelSize, sigma, filtered);
+
+    int w = source.width();
+    int h = source.height();
+    int c = source.channels();
 
-    return {data, w, h, c};
+    const PixelType type = source.pixel_type();
+    // With brick summaries, slices whose bricks cannot raise a block are skipped
+    const BrickGrid* grid = source.bricks();
+    auto* data = LargeBuffer::allocate(h, static_cast<size_t>(w) * c * Image::bytes_per_sample(type));
+    visit_pixel_type(type, [&](auto sample) {
+        using T = decltype(sample);
+        T* out = reinterpret_cast<T*>(data);
+        // Each block of pixels is reduced slice by slice, so the running result stays in L1
+        static const auto fold = Dispatch::bind(std::string("projection_max<") + PixelTraits<T>::name + ">",
+                                                kernel_set<max_kernel<T>>());
+        for_slice_batches(source, [&](int z0, bool, const std::vector<std::shared_ptr<Image>>& slices) {
+            Parallel::for_range(0, w * h * c, [&](int i0, int i1) {
+                for (int b0 = i0; b0 < i1; b0 += BLOCK) {
+                    const int b1 = std::min(b0 + BLOCK, i1);
+                    if (z0 == 0) std::fill(out + b0, out + b1, std::numeric_limits<T>::lowest());
+                    if (grid != nullptr) {
+                        fold_pruned(out, b0, b1, z0, slices, *grid, w, c, true, fold);
+                        continue;
+                    }
+                    for (const auto& slice : slices) {
+                        fold(out + b0, slice->template pixels<T>() + b0, b1 - b0);
+                    }
+                }
+            }, BLOCK);
+        });
+    });
+
+    return {data, w, h, c, type};
 }
 
 /**
@@ -53,34 +198,40 @@ Image Projection::MIP(Volume &vol, const int& filter_method, int kernelSize, dou
  * Volume is a class that contains a vector of Image objects. The MinIP is computed by taking the minimum pixel value of each Image in the Volume.
  * @author Shengzhi Tian
  */
-Image Projection::MinIP(Volume &vol, const int& filter_method, int kernelSize, double sigma) {
-    if (filter_method == 1) {
-        Filter::gaussian_blur_3d(vol, kernelSize, sigma);
-    } else if (filter_method == 2) {
-        Filter::median_blur_3d(vol, kernelSize);
-    } else if (filter_method == 3) {
-        // Do nothing
-    } else {
-        throw std::invalid_argument("Unsupported filter method");
-    }
+Image Projection::MinIP(Volume &vol, const int& filter_method, int kernelSize, double sigma, int level) {
+    std::unique_ptr<Volume> filtered;
+    Volume& source = filtered_level(vol, level, filter_method, kernelSize, sigma, filtered);
 
-    std::vector<Image> imgs = vol.getImages();
-    int num_imgs = imgs.size();
-    int w = imgs[0].width();
-    int h = imgs[0].height();
-    int c = imgs[0].channels();
-
-    auto* data = new unsigned char[w * h * c];
-    for (int i = 0; i < w * h * c; i++) {
-        unsigned char min_val = 255;
-        for (int z = 0; z < num_imgs; z++) {
-            unsigned char* img_data = imgs[z].get_data();
-            min_val = std::min(min_val, img_data[i]);
-        }
-        data[i] = min_val;
-    }
+    int w = source.width();
+    int h = source.height();
+    int c = source.channels();
+
+    const PixelType type = source.pixel_type();
+    const BrickGrid* grid = source.bricks();
+    auto* data = LargeBuffer::allocate(h, static_cast<size_t>(w) * c * Image::bytes_per_sample(type));
+    visit_pixel_type(type, [&](auto sample) {
+        using T = decltype(sample);
+        T* out = reinterpret_cast<T*>(data);
+        static const auto fold = Dispatch::bind(std::string("projection_min<") + PixelTraits<T>::name + ">",
+                                                kernel_set<min_kernel<T>>());
+        for_slice_batches(source, [&](int z0, bool, const std::vector<std::shared_ptr<Image>>& slices) {
+            Parallel::for_range(0, w * h * c, [&](int i0, int i1) {
+                for (int b0 = i0; b0 < i1; b0 += BLOCK) {
+                    const int b1 = std::min(b0 + BLOCK, i1);
+                    if (z0 == 0) std::fill(out + b0, out + b1, std::numeric_limits<T>::max());
+                    if (grid != nullptr) {
+                        fold_pruned(out, b0, b1, z0, slices, *grid, w, c, false, fold);
+                        continue;
+                    }
+                    for (const auto& slice : slices) {
+                        fold(out + b0, slice->template pixels<T>() + b0, b1 - b0);
+                    }
+                }
+            }, BLOCK);
+        });
+    });
 
-    return {data, w, h, c};
+    return {data, w, h, c, type};
 }
 
 
@@ -89,33 +240,158 @@ Image Projection::MinIP(Volume &vol, const int& filter_method, int kernelSize, d
  * Volume is a class that contains a vector of Image objects. The AIP is computed by averaging the pixel values of each Image in the Volume.
  * @author Shengzhi Tian
  */
-Image Projection::AIP(Volume &vol, const int& filter_method, int kernelSize, double sigma) {
+Image Projection::AIP(Volume &vol, const int& filter_method, int kernelSize, double sigma, int level) {
+    std::unique_ptr<Volume> filtered;
+    Volume& source = filtered_level(vol, level, filter_method, kernelSize, sigma, filtered);
+
+    int num_imgs = source.depth();
+    int w = source.width();
+    int h = source.height();
+    int c = source.channels();
+
+    const PixelType type = source.pixel_type();
+    auto* data = LargeBuffer::allocate(h, static_cast<size_t>(w) * c * Image::bytes_per_sample(type));
+    visit_pixel_type(type, [&](auto sample) {
+        using T = decltype(sample);
+        T* out = reinterpret_cast<T*>(data);
+        // Sums are kept for one block of pixels at a time and added in slice order, as before
+        static const auto accumulate = Dispatch::bind(std::string("projection_sum<") + PixelTraits<T>::name + ">",
+                                                      kernel_set<accumulate_kernel<T>>());
+        // With several batches the sums of every pixel must outlive a batch; otherwise one block is enough
+        const bool batched = source.resident_limit() > 0 && source.resident_limit() < static_cast<size_t>(num_imgs);
+        ScratchBuffer<double> totals(batched ? static_cast<size_t>(w) * h * c : 0);
+        for_slice_batches(source, [&](int z0, bool last, const std::vector<std::shared_ptr<Image>>& slices) {
+            Parallel::for_range(0, w * h * c, [&](int i0, int i1) {
+                std::vector<double> block(batched ? 0 : BLOCK);
+                for (int b0 = i0; b0 < i1; b0 += BLOCK) {
+                    const int b1 = std::min(b0 + BLOCK, i1);
+                    double* sum = batched ? totals.data() + b0 : block.data();
+                    if (z0 == 0) std::fill(sum, sum + (b1 - b0), 0.0);
+                    for (const auto& slice : slices) {
+                        accumulate(sum, slice->template pixels<T>() + b0, b1 - b0);
+                    }
+                    if (!last) continue;
+                    for (int i = b0; i < b1; i++) {
+                        // Integer samples are rounded to the nearest level; float averages are kept as they are
+                        const double avg = sum[i - b0] / num_imgs;
+                        out[i] = static_cast<T>(std::is_floating_point_v<T> ? avg : std::round(avg));
+                    }
+                }
+            }, BLOCK);
+        });
+    });
+
+    return {data, w, h, c, type};
+}
+
+/**
+ * @brief The reductions a projection of a sparse volume can make.
+ */
+enum class Reduction { Max, Min, Mean };
+
+/**
+ * @details Applies the filter a sparse projection was asked for; CLAHE works on whole slices, so it has no
+ * sparse form.
+ * @author Zhikang Dong
+ */
+static void filter_sparse(SparseVolume& vol, int filter_method, int kernelSize, double sigma) {
     if (filter_method == 1) {
         Filter::gaussian_blur_3d(vol, kernelSize, sigma);
     } else if (filter_method == 2) {
         Filter::median_blur_3d(vol, kernelSize);
-    } else if (filter_method == 3) {
-        // Do nothing
-    } else {
+    } else if (filter_method == 4) {
+        throw std::invalid_argument("CLAHE is not supported on sparse volumes");
+    } else if (filter_method != 3) {
         throw std::invalid_argument("Unsupported filter method");
     }
+}
 
-    std::vector<Image> imgs = vol.getImages();
-    int num_imgs = imgs.size();
-    int w = imgs[0].width();
-    int h = imgs[0].height();
-    int c = imgs[0].channels();
-
-    auto* data = new unsigned char[w * h * c];
-    for (int i = 0; i < w * h * c; i++) {
-        double sum = 0;
-        for (int z = 0; z < num_imgs; z++) {
-            unsigned char* img_data = imgs[z].get_data();
-            sum += img_data[i];
-        }
-        auto avg = static_cast<unsigned char>(std::round(sum / num_imgs));
-        data[i] = avg;
-    }
+/**
+ * @details Each column of tiles is reduced into its footprint of the output independently. A constant tile is
+ * folded in once whatever its depth (or added as value times depth for a mean), and a stored tile row by row.
+ * @author Zhikang Dong
+ */
+static Image project_sparse(const SparseVolume& vol, Reduction reduction) {
+    const int w = vol.width(), h = vol.height(), d = vol.depth(), c = vol.channels();
+    const int size = vol.tile_size();
+    const PixelType type = vol.pixel_type();
+    auto* data = LargeBuffer::allocate(h, static_cast<size_t>(w) * c * Image::bytes_per_sample(type));
+    visit_pixel_type(type, [&](auto sample) {
+        using T = decltype(sample);
+        T* out = reinterpret_cast<T*>(data);
+        Parallel::for_range_2d(0, vol.tiles_y(), 0, vol.tiles_x(), [&](int ty0, int ty1, int tx0, int tx1) {
+            for (int ty = ty0; ty < ty1; ++ty) {
+                for (int tx = tx0; tx < tx1; ++tx) {
+                    int ex, ey, ez;
+                    vol.tile_extent(tx, ty, 0, ex, ey, ez);
+                    const size_t n = static_cast<size_t>(ex) * c;
+                    T* base = out + (static_cast<size_t>(ty) * size * w + static_cast<size_t>(tx) * size) * c;
+                    std::vector<double> sums(reduction == Reduction::Mean ? n * ey : 0, 0.0);
+                    for (int y = 0; y < ey; ++y) {
+                        const T start = (reduction == Reduction::Max) ? std::numeric_limits<T>::lowest()
+                                                                      : std::numeric_limits<T>::max();
+                        if (reduction != Reduction::Mean) std::fill(base + y * w * c, base + y * w * c + n, start);
+                    }
+                    for (int tz = 0; tz < vol.tiles_z(); ++tz) {
+                        const SparseTile& tile = *vol.tile(tx, ty, tz);
+                        vol.tile_extent(tx, ty, tz, ex, ey, ez);
+                        const T* voxels = reinterpret_cast<const T*>(tile.bytes.data());
+                        for (int y = 0; y < ey; ++y) {
+                            T* row = base + y * w * c;
+                            if (tile.constant) {
+                                for (size_t i = 0; i < n; ++i) {
+                                    const T v = voxels[i % c];
+                                    if (reduction == Reduction::Max) row[i] = std::max(row[i], v);
+                                    else if (reduction == Reduction::Min) row[i] = std::min(row[i], v);
+                                    else sums[y * n + i] += static_cast<double>(v) * ez;
+                                }
+                                continue;
+                            }
+                            for (int z = 0; z < ez; ++z) {
+                                const T* src = voxels + (static_cast<size_t>(z) * ey + y) * n;
+                                if (reduction == Reduction::Max) max_kernel(row, src, n);
+                                else if (reduction == Reduction::Min) min_kernel(row, src, n);
+                                else accumulate_kernel(sums.data() + y * n, src, n);
+                            }
+                        }
+                    }
+                    if (reduction != Reduction::Mean) continue;
+                    for (int y = 0; y < ey; ++y) {
+                        for (size_t i = 0; i < n; ++i) {
+                            const double avg = sums[y * n + i] / d;
+                            base[y * w * c + i] = static_cast<T>(std::is_floating_point_v<T> ? avg : std::round(avg));
+                        }
+                    }
+                }
+            }
+        }, 1, 4);
+    });
+    return {data, w, h, c, type};
+}
+
+/**
+ * @details Computes the MIP of a sparse volume from its tiles.
+ * @author Zhikang Dong
+ */
+Image Projection::MIP(SparseVolume &vol, const int& filter_method, int kernelSize, double sigma) {
+    filter_sparse(vol, filter_method, kernelSize, sigma);
+    return project_sparse(vol, Reduction::Max);
+}
 
-    return {data, w, h, c};
+/**
+ * @details Computes the MinIP of a sparse volume from its tiles.
+ * @author Zhikang Dong
+ */
+Image Projection::MinIP(SparseVolume &vol, const int& filter_method, int kernelSize, double sigma) {
+    filter_sparse(vol, filter_method, kernelSize, sigma);
+    return project_sparse(vol, Reduction::Min);
+}
+
+/**
+ * @details Computes the AIP of a sparse volume from its tiles.
+ * @author Zhikang Dong
+ */
+Image Projection::AIP(SparseVolume &vol, const int& filter_method, int kernelSize, double sigma) {
+    filter_sparse(vol, filter_method, kernelSize, sigma);
+    return project_sparse(vol, Reduction::Mean);
 }
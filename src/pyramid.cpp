@@ -0,0 +1,116 @@
+/**
+* @file pyramid.cpp
+* @brief this file contains the implementation of the 2x downsampling that builds the resolution levels of a volume.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <type_traits>
+#include "pyramid.h"
+#include "volume.h"
+#include "parallel.h"
+#include "largebuffer.h"
+#include "scratch.h"
+
+namespace {
+
+/**
+ * @brief The source samples averaged into one output sample along one axis.
+ */
+struct Taps {
+    int count = 1;                   /**< The number of taps. */
+    int offset[4] = {0, 0, 0, 0};    /**< The offsets of the taps from twice the output position. */
+    double weight[4] = {1, 0, 0, 0}; /**< The weights of the taps, summing to 1. */
+};
+
+/**
+ * @brief Gets the taps of an axis of the given length.
+ */
+Taps taps_for(int size, PyramidFilter filter) {
+    Taps taps;
+    if (size <= 1) return taps;
+    if (filter == PyramidFilter::Box) {
+        taps.count = 2;
+        taps.offset[0] = 0;   taps.offset[1] = 1;
+        taps.weight[0] = 0.5; taps.weight[1] = 0.5;
+    } else {
+        taps.count = 4;
+        taps.offset[0] = -1;      taps.offset[1] = 0;         taps.offset[2] = 1;         taps.offset[3] = 2;
+        taps.weight[0] = 1.0 / 8; taps.weight[1] = 3.0 / 8; taps.weight[2] = 3.0 / 8; taps.weight[3] = 1.0 / 8;
+    }
+    return taps;
+}
+
+/**
+ * @brief Gets the length of an axis after halving.
+ */
+int halved(int size) {
+    return size > 1 ? (size + 1) / 2 : size;
+}
+
+} // namespace
+
+/**
+ * @details The filter is separable, so each output row is made in two passes: the source rows under it are
+ * weighted into one full-width row of sums, which is then reduced along x. Blocks of output rows run in
+ * parallel, each fetching the few source slices it reads.
+ * @author Zhikang Dong
+ */
+std::vector<Image> Pyramid::downsample(const Volume& vol, PyramidFilter filter) {
+    const int w = vol.width(), h = vol.height(), d = vol.depth(), c = vol.channels();
+    const PixelType type = vol.pixel_type();
+    const int w2 = halved(w), h2 = halved(h), d2 = halved(d);
+    const Taps tx = taps_for(w, filter), ty = taps_for(h, filter), tz = taps_for(d, filter);
+    const size_t row = static_cast<size_t>(w) * c, row2 = static_cast<size_t>(w2) * c;
+
+    std::vector<unsigned char*> slices(d2);
+    for (auto& slice : slices) slice = LargeBuffer::allocate(h2, row2 * Image::bytes_per_sample(type));
+
+    visit_pixel_type(type, [&](auto sample) {
+        using T = decltype(sample);
+        Parallel::for_range_2d(0, d2, 0, h2, [&](int z0, int z1, int y0, int y1) {
+            ScratchBuffer<double> sums(row);
+            for (int oz = z0; oz < z1; ++oz) {
+                std::shared_ptr<Image> source[4];
+                for (int t = 0; t < tz.count; ++t) {
+                    source[t] = vol.at(std::clamp(2 * oz + tz.offset[t], 0, d - 1));
+                }
+                T* out = reinterpret_cast<T*>(slices[oz]);
+                for (int oy = y0; oy < y1; ++oy) {
+                    std::fill(sums.data(), sums.data() + row, 0.0);
+                    for (int a = 0; a < tz.count; ++a) {
+                        const T* plane = source[a]->template pixels<T>();
+                        for (int b = 0; b < ty.count; ++b) {
+                            const double weight = tz.weight[a] * ty.weight[b];
+                            const T* src = plane + std::clamp(2 * oy + ty.offset[b], 0, h - 1) * row;
+                            for (size_t i = 0; i < row; ++i) sums[i] += weight * src[i];
+                        }
+                    }
+                    T* dst = out + oy * row2;
+                    for (int ox = 0; ox < w2; ++ox) {
+                        for (int k = 0; k < c; ++k) {
+                            double value = 0.0;
+                            for (int t = 0; t < tx.count; ++t) {
+                                value += tx.weight[t] * sums[std::clamp(2 * ox + tx.offset[t], 0, w - 1) * c + k];
+                            }
+                            dst[ox * c + k] = static_cast<T>(std::is_floating_point_v<T> ? value : std::round(value));
+                        }
+                    }
+                }
+            }
+        }, 1, 16);
+    });
+
+    std::vector<Image> images;
+    images.reserve(d2);
+    for (unsigned char* slice : slices) images.emplace_back(slice, w2, h2, c, type);
+    return images;
+}
@@ -0,0 +1,173 @@
+/**
+* @file scratch.cpp
+* @brief this file contains the implementation of the thread-local scratch arena.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "scratch.h"
+
+namespace {
+
+constexpr int MIN_SHIFT = 6;                  /**< The smallest block is 64 bytes, one cache line. */
+constexpr int FINE_SHIFT = 26;                /**< Past 64 MiB, each power of two is split into finer classes. */
+constexpr int FINE_STEPS = 8;                 /**< The classes per power of two past 64 MiB, 1/8 apart. */
+constexpr int COARSE = FINE_SHIFT - MIN_SHIFT + 1; /**< The power of two classes, 64 bytes to 64 MiB. */
+constexpr int BUCKETS = COARSE + (47 - FINE_SHIFT) * FINE_STEPS; /**< Blocks up to 2^47 bytes. */
+constexpr size_t ALIGNMENT = size_t(1) << MIN_SHIFT;
+
+std::atomic<uint64_t> requests{0};
+std::atomic<uint64_t> hits{0};
+std::atomic<size_t> bytesInUse{0};
+std::atomic<size_t> peakBytes{0};
+std::atomic<size_t> bytesCached{0};
+std::atomic<size_t> cacheLimit{size_t(256) << 20};
+
+size_t bucket_size(int bucket) {
+    if (bucket < COARSE) return size_t(1) << (bucket + MIN_SHIFT);
+    const int octave = FINE_SHIFT + (bucket - COARSE) / FINE_STEPS;
+    const size_t step = (size_t(1) << octave) / FINE_STEPS;
+    return (size_t(1) << octave) + step * ((bucket - COARSE) % FINE_STEPS + 1);
+}
+
+/**
+ * @brief Gets the smallest size class holding bytes; large requests waste at most 1/8 of their size.
+ */
+int bucket_for(size_t bytes) {
+    if (bytes <= (size_t(1) << FINE_SHIFT)) {
+        int bucket = 0;
+        while (bucket_size(bucket) < bytes) ++bucket;
+        return bucket;
+    }
+    int octave = FINE_SHIFT;
+    while ((size_t(2) << octave) < bytes) ++octave;
+    const size_t step = (size_t(1) << octave) / FINE_STEPS;
+    const size_t steps = (bytes - (size_t(1) << octave) + step - 1) / step;
+    return COARSE + (octave - FINE_SHIFT) * FINE_STEPS + static_cast<int>(steps) - 1;
+}
+
+thread_local bool arenaGone = false; /**< Set once the thread's arena is destroyed at thread exit. */
+
+/**
+ * @brief The free lists of one thread.
+ */
+struct Arena {
+    std::vector<void*> free[BUCKETS]; /**< The cached blocks of each size class. */
+    size_t cached = 0;                /**< The bytes held in free. */
+
+    ~Arena() {
+        clear();
+        arenaGone = true;
+    }
+
+    void clear() {
+        for (int b = 0; b < BUCKETS; ++b) {
+            for (void* p : free[b]) std::free(p);
+            free[b].clear();
+        }
+        bytesCached -= cached;
+        cached = 0;
+    }
+};
+
+Arena& arena() {
+    thread_local Arena local;
+    return local;
+}
+
+} // namespace
+
+/**
+ * @details Pops the free list of the size class, or allocates a fresh aligned block on a miss.
+ * @author Zhikang Dong
+ */
+Scratch::Block Scratch::acquire(size_t bytes) {
+    if (bytes == 0) return {};
+    const int bucket = bucket_for(bytes);
+    if (bucket >= BUCKETS) throw std::bad_alloc();
+    const size_t size = bucket_size(bucket);
+    ++requests;
+
+    Block block{nullptr, bucket};
+    if (!arenaGone) {
+        Arena& local = arena();
+        if (!local.free[bucket].empty()) {
+            block.ptr = local.free[bucket].back();
+            local.free[bucket].pop_back();
+            local.cached -= size;
+            bytesCached -= size;
+            ++hits;
+        }
+    }
+    if (block.ptr == nullptr) {
+        block.ptr = std::aligned_alloc(ALIGNMENT, size);
+        if (block.ptr == nullptr) throw std::bad_alloc();
+    }
+
+    const size_t now = bytesInUse += size;
+    size_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (now > peak && !peakBytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+    return block;
+}
+
+/**
+ * @details Keeps the block for the next request of its size class unless the thread's cache is full, or the
+ * thread is exiting and its arena is already gone. A thread with nothing cached keeps the block whatever its
+ * size, so one temporary larger than the limit is still reused.
+ * @author Zhikang Dong
+ */
+void Scratch::release(Block block) {
+    if (block.ptr == nullptr) return;
+    const size_t size = bucket_size(block.bucket);
+    bytesInUse -= size;
+
+    if (!arenaGone) {
+        Arena& local = arena();
+        const size_t limit = cacheLimit.load(std::memory_order_relaxed);
+        if (local.cached + size <= limit || (local.cached == 0 && limit > 0)) {
+            local.free[block.bucket].push_back(block.ptr);
+            local.cached += size;
+            bytesCached += size;
+            return;
+        }
+    }
+    std::free(block.ptr);
+}
+
+ScratchStatistics Scratch::statistics() {
+    ScratchStatistics stats;
+    stats.requests = requests;
+    stats.hits = hits;
+    stats.bytesInUse = bytesInUse;
+    stats.peakBytes = peakBytes;
+    stats.bytesCached = bytesCached;
+    return stats;
+}
+
+void Scratch::reset_statistics() {
+    requests = 0;
+    hits = 0;
+    peakBytes = bytesInUse.load();
+}
+
+void Scratch::trim() {
+    if (!arenaGone) arena().clear();
+}
+
+void Scratch::set_cache_limit(size_t bytes) {
+    cacheLimit = bytes;
+}
+
+size_t Scratch::cache_limit() {
+    return cacheLimit;
+}
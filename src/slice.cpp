@@ -10,7 +10,11 @@
 * @date 19/03/2024
 */
 
+#include <algorithm>
+#include <cstring>
 #include "slice.h"
+#include "parallel.h"
+#include "largebuffer.h"
 
 
 /**
@@ -18,53 +22,159 @@
  * Volume is a class that contains a vector of Image objects. The slice is generated by taking the i-th slice of each Image in the Volume for any plane.
  * @author Zhikang Dong
  */
-Image Slice::slice(const Volume& volume, int n, SliceType type) {
-    int w = volume.getImages()[0].width();
-    int h = volume.getImages()[0].height();
-    int c = volume.getImages()[0].channels();
+Image Slice::slice(const Volume& full, int n, SliceType type, int level) {
+    // A reduced level is browsed with the same index, scaled down to its own size
+    const Volume& volume = full.level(level);
+    int w = volume.width();
+    int h = volume.height();
+    int c = volume.channels();
 
-    std::vector<Image> images = volume.getImages();
-
-    int z = images.size();
+    // Slices are fetched one at a time, so a lazy volume decodes them in parallel and never all at once
+    int z = volume.depth();
     
-    if (type == SliceType::XZ){
-        unsigned char* data = new unsigned char[w * z * c];
-        int index = 0;
-        for (auto &img : images){
-            unsigned char* imgData = img.get_data();
-            for(int j = 0; j < 1; ++j) {
-                for(int i = 0; i < w; ++i) {
-                    int d_index = index * w * c + i * c;
-                    int img_index = n * w * c + i * c;
-                    for (int k = 0; k < c; ++k) {
-                        data[d_index + k] = imgData[img_index + k];
+    if (type != SliceType::XZ && type != SliceType::YZ) {
+        throw std::runtime_error("Invalid SliceType");
+    }
+    n = std::min(n >> level, (type == SliceType::XZ ? h : w) - 1);
+
+    // The gathers are instantiated per sample type, so 16-bit and float volumes are sliced without conversion
+    const PixelType pixelType = volume.pixel_type();
+    return visit_pixel_type(pixelType, [&](auto sample) {
+        using T = decltype(sample);
+        if (type == SliceType::XZ){
+            unsigned char* data = LargeBuffer::allocate(z, static_cast<size_t>(w) * c * sizeof(T));
+            T* out = reinterpret_cast<T*>(data);
+            // Row index of the output is the slice index, so slices are copied independently
+            Parallel::for_range(0, z, [&](int z0, int z1) {
+                for (int index = z0; index < z1; ++index) {
+                    const std::shared_ptr<Image> image = volume.at(index);
+                    const T* imgData = image->template pixels<T>();
+                    for(int i = 0; i < w; ++i) {
+                        int d_index = index * w * c + i * c;
+                        int img_index = n * w * c + i * c;
+                        for (int k = 0; k < c; ++k) {
+                            out[d_index + k] = imgData[img_index + k];
+                        }
                     }
                 }
-            }
-            index++;
+            }, 8);
+            return Image(data, w, z, c, pixelType);
         }
-        return Image(data, w, z, c);
-    }
 
-    else if (type == SliceType::YZ){
-        unsigned char* data = new unsigned char[h * z * c];
-        int index = 0;
-        for (auto &img : images){
-            unsigned char* imgData = img.get_data();
-            for(int j = 0; j < h; ++j) {
-                for(int i = 0; i < 1; ++i) {
+        unsigned char* data = LargeBuffer::allocate(z, static_cast<size_t>(h) * c * sizeof(T));
+        T* out = reinterpret_cast<T*>(data);
+        Parallel::for_range(0, z, [&](int z0, int z1) {
+            for (int index = z0; index < z1; ++index) {
+                const std::shared_ptr<Image> image = volume.at(index);
+                const T* imgData = image->template pixels<T>();
+                for(int j = 0; j < h; ++j) {
                     int d_index = index * h * c + j * c;
                     int img_index = j * w * c + n * c;
                     for (int k = 0; k < c; ++k) {
-                        data[d_index + k] = imgData[img_index + k];
+                        out[d_index + k] = imgData[img_index + k];
                     }
                 }
             }
-            index++;
-        }
-        return Image(data, h, z, c);
+        }, 8);
+        return Image(data, h, z, c, pixelType);
+    });
+}
+
+/**
+ * @details Each row of the output is one row or column of a slice, gathered from the tiles it crosses, so
+ * constant tiles are filled without ever being expanded.
+ * @author Zhikang Dong
+ */
+Image Slice::slice(const SparseVolume& volume, int n, SliceType type) {
+    if (type != SliceType::XZ && type != SliceType::YZ) {
+        throw std::runtime_error("Invalid SliceType");
     }
-    else{
+    const int w = volume.width(), h = volume.height(), z = volume.depth();
+    const int length = (type == SliceType::XZ) ? w : h;
+    const size_t row = static_cast<size_t>(length) * volume.pixel_bytes();
+    unsigned char* data = LargeBuffer::allocate(z, row);
+    Parallel::for_range(0, z, [&](int z0, int z1) {
+        for (int index = z0; index < z1; ++index) {
+            if (type == SliceType::XZ) {
+                volume.gather(0, w, n, n + 1, index, index + 1, data + index * row);
+            } else {
+                volume.gather(n, n + 1, 0, h, index, index + 1, data + index * row);
+            }
+        }
+    }, 8);
+    return Image(data, length, z, volume.channels(), volume.pixel_type());
+}
+
+/**
+ * @details XZ planes take whole rows of each source slice, so they are copied with memcpy. YZ planes transpose
+ * each source slice; it is copied in BLOCK x BLOCK tiles so the rows read and the plane rows written both stay
+ * in cache. The tasks split the source slices and, for YZ, the columns, and every task writes its own rows of
+ * the planes.
+ * @author Zhikang Dong
+ */
+Volume Slice::reorient(const Volume& volume, SliceType type) {
+    if (type != SliceType::XZ && type != SliceType::YZ) {
         throw std::runtime_error("Invalid SliceType");
     }
-}
\ No newline at end of file
+    constexpr int BLOCK = 64;
+    const int w = volume.width(), h = volume.height(), z = volume.depth(), c = volume.channels();
+    const PixelType pixelType = volume.pixel_type();
+    const int count = (type == SliceType::XZ) ? h : w;
+    const int length = (type == SliceType::XZ) ? w : h;
+    const size_t pixel = static_cast<size_t>(c) * Image::bytes_per_sample(pixelType);
+    const size_t row = static_cast<size_t>(length) * pixel;
+
+    std::vector<unsigned char*> planes(count);
+    for (auto& plane : planes) plane = LargeBuffer::allocate(z, row);
+
+    if (type == SliceType::XZ) {
+        Parallel::for_range(0, z, [&](int z0, int z1) {
+            for (int index = z0; index < z1; ++index) {
+                const std::shared_ptr<Image> image = volume.at(index);
+                const unsigned char* src = image->get_data();
+                for (int y = 0; y < h; ++y) std::memcpy(planes[y] + index * row, src + y * row, row);
+            }
+        }, 1);
+    } else {
+        visit_pixel_type(pixelType, [&](auto sample) {
+            using T = decltype(sample);
+            Parallel::for_range_2d(0, z, 0, w, [&](int z0, int z1, int x0, int x1) {
+                for (int index = z0; index < z1; ++index) {
+                    const std::shared_ptr<Image> image = volume.at(index);
+                    const T* src = image->template pixels<T>();
+                    for (int yb = 0; yb < h; yb += BLOCK) {
+                        const int ye = std::min(yb + BLOCK, h);
+                        for (int xb = x0; xb < x1; xb += BLOCK) {
+                            const int xe = std::min(xb + BLOCK, x1);
+                            for (int x = xb; x < xe; ++x) {
+                                T* out = reinterpret_cast<T*>(planes[x] + index * row);
+                                if (c == 1) {
+                                    for (int y = yb; y < ye; ++y) out[y] = src[static_cast<size_t>(y) * w + x];
+                                    continue;
+                                }
+                                for (int y = yb; y < ye; ++y) {
+                                    for (int k = 0; k < c; ++k) {
+                                        out[y * c + k] = src[(static_cast<size_t>(y) * w + x) * c + k];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }, 1, BLOCK * 4);
+        });
+    }
+
+    std::vector<Image> slices(count);
+    for (int i = 0; i < count; ++i) slices[i] = Image(planes[i], length, z, c, pixelType);
+    return Volume(std::move(slices));
+}
+
+/**
+ * @details The planes are built with reorient(), then written by Volume::save, which encodes them in parallel.
+ * @author Zhikang Dong
+ */
+void Slice::save_all(const Volume& volume, SliceType type, const std::string& directoryPath) {
+    Volume planes = reorient(volume, type);
+    planes.save(directoryPath, type == SliceType::XZ ? "xz" : "yz");
+}
@@ -0,0 +1,161 @@
+/**
+* @file slicecodec.cpp
+* @brief this file contains the implementation of the lossless codec that keeps the slices of a volume compressed in memory.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include "slicecodec.h"
+#include "Image.h"
+#include "scratch.h"
+
+namespace {
+
+constexpr int MAX_LITERAL = 128;  /**< The longest literal, coded as control bytes 0 to 127. */
+constexpr int MIN_RUN = 3;        /**< The shortest run worth coding, coded from control byte 128. */
+constexpr int MAX_SHORT_RUN = 129; /**< The longest run with a one byte control, coded up to control byte 254. */
+constexpr unsigned char LONG_RUN = 255; /**< The control byte of a run with a three byte length. */
+constexpr size_t MAX_LONG_RUN = (1u << 24) - 1; /**< The longest run with a three byte length. */
+
+/**
+ * @brief The unsigned integer the samples of type T are differenced in.
+ */
+template <typename T>
+using Bits = std::conditional_t<sizeof(T) == 1, uint8_t, std::conditional_t<sizeof(T) == 2, uint16_t, uint32_t>>;
+
+/**
+ * @brief Appends the runs and literals coding src[0, n).
+ */
+void pack_runs(const unsigned char* src, size_t n, std::vector<unsigned char>& out) {
+    size_t i = 0;
+    while (i < n) {
+        size_t run = 1;
+        while (i + run < n && src[i + run] == src[i] && run < MAX_LONG_RUN) ++run;
+        if (run >= MIN_RUN) {
+            if (run <= MAX_SHORT_RUN) {
+                out.push_back(static_cast<unsigned char>(128 + run - MIN_RUN));
+            } else {
+                out.push_back(LONG_RUN);
+                out.push_back(static_cast<unsigned char>(run));
+                out.push_back(static_cast<unsigned char>(run >> 8));
+                out.push_back(static_cast<unsigned char>(run >> 16));
+            }
+            out.push_back(src[i]);
+            i += run;
+            continue;
+        }
+        // A literal stops where a run worth coding starts
+        const size_t start = i;
+        while (i < n && i - start < MAX_LITERAL) {
+            if (i + 2 < n && src[i] == src[i + 1] && src[i] == src[i + 2]) break;
+            ++i;
+        }
+        out.push_back(static_cast<unsigned char>(i - start - 1));
+        out.insert(out.end(), src + start, src + i);
+    }
+}
+
+/**
+ * @brief Decodes runs and literals into exactly n bytes of dst.
+ */
+void unpack_runs(const std::vector<unsigned char>& packed, unsigned char* dst, size_t n) {
+    const unsigned char* in = packed.data();
+    const unsigned char* end = in + packed.size();
+    size_t o = 0;
+    while (in < end) {
+        const unsigned char control = *in++;
+        if (control < 128) {
+            const size_t count = control + 1;
+            if (o + count > n || in + count > end) break;
+            std::memcpy(dst + o, in, count);
+            in += count;
+            o += count;
+            continue;
+        }
+        size_t count = control - 128 + MIN_RUN;
+        if (control == LONG_RUN) {
+            if (end - in < 3) break;
+            count = in[0] | (static_cast<size_t>(in[1]) << 8) | (static_cast<size_t>(in[2]) << 16);
+            in += 3;
+        }
+        if (o + count > n || in >= end) break;
+        std::memset(dst + o, *in++, count);
+        o += count;
+    }
+    if (o != n || in != end) {
+        throw std::runtime_error("Corrupt compressed slice.");
+    }
+}
+
+} // namespace
+
+/**
+ * @details The residuals are written plane by plane into a scratch buffer and run-length coded in one go.
+ * @author Zhikang Dong
+ */
+std::vector<unsigned char> SliceCodec::encode(const Image& img) {
+    const int w = img.width(), h = img.height(), c = img.channels();
+    const size_t row = static_cast<size_t>(w) * c, n = row * h;
+    std::vector<unsigned char> packed;
+    visit_pixel_type(img.pixel_type(), [&](auto sample) {
+        using U = Bits<decltype(sample)>;
+        const U* src = reinterpret_cast<const U*>(img.get_data());
+        ScratchBuffer<unsigned char> planes(n * sizeof(U));
+        for (size_t y = 0; y < static_cast<size_t>(h); ++y) {
+            for (size_t i = 0; i < row; ++i) {
+                const size_t at = y * row + i;
+                const U predicted = (y > 0) ? src[at - row] : (i >= static_cast<size_t>(c) ? src[at - c] : U(0));
+                const U residual = static_cast<U>(src[at] - predicted);
+                for (size_t b = 0; b < sizeof(U); ++b) {
+                    planes[b * n + at] = static_cast<unsigned char>(residual >> (8 * b));
+                }
+            }
+        }
+        packed.reserve(n * sizeof(U) / 4);
+        pack_runs(planes.data(), n * sizeof(U), packed);
+    });
+    packed.shrink_to_fit();
+    return packed;
+}
+
+/**
+ * @details 8-bit residuals are decoded straight into the image and summed in place; wider ones go through a
+ * scratch buffer of planes first.
+ * @author Zhikang Dong
+ */
+void SliceCodec::decode(const std::vector<unsigned char>& packed, Image& img) {
+    const int w = img.width(), h = img.height(), c = img.channels();
+    const size_t row = static_cast<size_t>(w) * c, n = row * h;
+    visit_pixel_type(img.pixel_type(), [&](auto sample) {
+        using U = Bits<decltype(sample)>;
+        U* dst = reinterpret_cast<U*>(img.get_data());
+        ScratchBuffer<unsigned char> planes(sizeof(U) > 1 ? n * sizeof(U) : 0);
+        if constexpr (sizeof(U) == 1) {
+            unpack_runs(packed, dst, n);
+        } else {
+            unpack_runs(packed, planes.data(), n * sizeof(U));
+            for (size_t i = 0; i < n; ++i) {
+                U residual = 0;
+                for (size_t b = 0; b < sizeof(U); ++b) residual |= static_cast<U>(planes[b * n + i]) << (8 * b);
+                dst[i] = residual;
+            }
+        }
+        // Only the first row depends on its own samples; every other row is one independent add per sample
+        for (size_t i = c; i < row && h > 0; ++i) dst[i] = static_cast<U>(dst[i] + dst[i - c]);
+        for (size_t y = 1; y < static_cast<size_t>(h); ++y) {
+            U* line = dst + y * row;
+            const U* above = line - row;
+            for (size_t i = 0; i < row; ++i) line[i] = static_cast<U>(line[i] + above[i]);
+        }
+    });
+    img.invalidate_statistics();
+}
@@ -0,0 +1,271 @@
+/**
+* @file sparse.cpp
+* @brief this file contains the implementation of the sparse, tiled representation of mostly empty volumes.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "sparse.h"
+#include "volume.h"
+#include "parallel.h"
+#include "largebuffer.h"
+
+/**
+ * @brief Writes count copies of one pixel of pixelBytes bytes.
+ */
+static void fill_pixels(unsigned char* dst, const unsigned char* pixel, size_t count, int pixelBytes) {
+    if (pixelBytes == 1) {
+        std::memset(dst, pixel[0], count);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) std::memcpy(dst + i * pixelBytes, pixel, pixelBytes);
+}
+
+/**
+ * @brief Whether every colour sample of a tile is at or below level and its alpha, if any, is constant.
+ * @param pixel Set to the background pixel the tile stands for: zero colour and the tile's alpha.
+ */
+template <typename T>
+static bool below_background(const std::vector<unsigned char>& voxels, int channels, double level,
+                             std::vector<unsigned char>& pixel) {
+    const T* samples = reinterpret_cast<const T*>(voxels.data());
+    const size_t count = voxels.size() / sizeof(T);
+    const int alpha = (channels == 2 || channels == 4) ? channels - 1 : -1;
+    for (size_t i = 0; i < count; ++i) {
+        const int c = static_cast<int>(i % channels);
+        if (c == alpha ? samples[i] != samples[alpha] : static_cast<double>(samples[i]) > level) return false;
+    }
+    std::vector<T> background(channels, T(0));
+    if (alpha >= 0) background[alpha] = samples[alpha];
+    pixel.resize(channels * sizeof(T));
+    std::memcpy(pixel.data(), background.data(), pixel.size());
+    return true;
+}
+
+/**
+ * @details Each layer of tiles is fetched as whole slices, so a lazy volume only holds one layer at a time;
+ * the tiles of the layer are then cut and classified in parallel.
+ * @author Zhikang Dong
+ */
+SparseVolume::SparseVolume(const Volume& vol, int size, std::optional<double> background)
+    : size(size), background(background) {
+    if (size <= 0) {
+        throw std::invalid_argument("The tile size must be positive");
+    }
+    w = vol.width();
+    h = vol.height();
+    d = vol.depth();
+    c = vol.channels();
+    type = vol.pixel_type();
+    nx = (w + size - 1) / size;
+    ny = (h + size - 1) / size;
+    nz = (d + size - 1) / size;
+    tiles.resize(static_cast<size_t>(nx) * ny * nz);
+
+    const int pb = pixel_bytes();
+    const size_t row = static_cast<size_t>(w) * pb;
+    for (int tz = 0; tz < nz; ++tz) {
+        const int z0 = tz * size, z1 = std::min(z0 + size, d);
+        std::vector<std::shared_ptr<Image>> slices(z1 - z0);
+        Parallel::for_range(z0, z1, [&](int a, int b) {
+            for (int z = a; z < b; ++z) slices[z - z0] = vol.at(z);
+        }, 1);
+
+        Parallel::for_range_2d(0, ny, 0, nx, [&](int ty0, int ty1, int tx0, int tx1) {
+            for (int ty = ty0; ty < ty1; ++ty) {
+                for (int tx = tx0; tx < tx1; ++tx) {
+                    int ex, ey, ez;
+                    tile_extent(tx, ty, tz, ex, ey, ez);
+                    const size_t span = static_cast<size_t>(ex) * pb;
+                    std::vector<unsigned char> voxels(span * ey * ez);
+                    for (int z = 0; z < ez; ++z) {
+                        const unsigned char* data = slices[z]->get_data();
+                        for (int y = 0; y < ey; ++y) {
+                            std::memcpy(voxels.data() + (static_cast<size_t>(z) * ey + y) * span,
+                                        data + (ty * size + y) * row + static_cast<size_t>(tx) * size * pb, span);
+                        }
+                    }
+                    tiles[(static_cast<size_t>(tz) * ny + ty) * nx + tx] = make_tile(std::move(voxels));
+                }
+            }
+        }, 1, 4);
+    }
+}
+
+/**
+ * @details Slices are filled independently, each gathered from its row of tiles.
+ * @author Zhikang Dong
+ */
+Volume SparseVolume::dense() const {
+    const size_t row = static_cast<size_t>(w) * pixel_bytes();
+    std::vector<Image> images(d);
+    Parallel::for_range(0, d, [&](int z0, int z1) {
+        for (int z = z0; z < z1; ++z) {
+            unsigned char* data = LargeBuffer::allocate(h, row);
+            gather(0, w, 0, h, z, z + 1, data);
+            images[z] = Image(data, w, h, c, type);
+        }
+    }, 1);
+    return Volume(std::move(images));
+}
+
+int SparseVolume::width() const {
+    return w;
+}
+
+int SparseVolume::height() const {
+    return h;
+}
+
+int SparseVolume::depth() const {
+    return d;
+}
+
+int SparseVolume::channels() const {
+    return c;
+}
+
+PixelType SparseVolume::pixel_type() const {
+    return type;
+}
+
+std::optional<double> SparseVolume::background_level() const {
+    return background;
+}
+
+int SparseVolume::tile_size() const {
+    return size;
+}
+
+int SparseVolume::tiles_x() const {
+    return nx;
+}
+
+int SparseVolume::tiles_y() const {
+    return ny;
+}
+
+int SparseVolume::tiles_z() const {
+    return nz;
+}
+
+int SparseVolume::pixel_bytes() const {
+    return c * Image::bytes_per_sample(type);
+}
+
+const std::shared_ptr<const SparseTile>& SparseVolume::tile(int tx, int ty, int tz) const {
+    return tiles[(static_cast<size_t>(tz) * ny + ty) * nx + tx];
+}
+
+void SparseVolume::tile_extent(int tx, int ty, int tz, int& ex, int& ey, int& ez) const {
+    ex = std::min(size, w - tx * size);
+    ey = std::min(size, h - ty * size);
+    ez = std::min(size, d - tz * size);
+}
+
+/**
+ * @details A tile is constant when every pixel matches its first byte for byte, or, with a background level,
+ * when it is all background; constant tiles are looked up by their pixel so equal ones are shared.
+ * @author Zhikang Dong
+ */
+std::shared_ptr<const SparseTile> SparseVolume::make_tile(std::vector<unsigned char> voxels) {
+    // Every pixel equals the first exactly when the voxels equal themselves shifted by one pixel
+    const int pb = pixel_bytes();
+    const bool uniform = voxels.size() <= static_cast<size_t>(pb) ||
+                         std::memcmp(voxels.data() + pb, voxels.data(), voxels.size() - pb) == 0;
+    std::vector<unsigned char> first(voxels.begin(), voxels.begin() + pb);
+    const bool empty = background && visit_pixel_type(type, [&](auto sample) {
+        return below_background<decltype(sample)>(voxels, c, *background, first);
+    });
+    if (!uniform && !empty) {
+        auto tile = std::make_shared<SparseTile>();
+        tile->bytes = std::move(voxels);
+        return tile;
+    }
+
+    const std::string pixel(first.begin(), first.end());
+    std::lock_guard<std::mutex> guard(constantsLock);
+    std::shared_ptr<const SparseTile>& shared = constants[pixel];
+    if (!shared) {
+        auto tile = std::make_shared<SparseTile>();
+        tile->constant = true;
+        tile->bytes.assign(pixel.begin(), pixel.end());
+        shared = tile;
+    }
+    return shared;
+}
+
+void SparseVolume::set_tiles(std::vector<std::shared_ptr<const SparseTile>> replacement) {
+    tiles = std::move(replacement);
+    std::lock_guard<std::mutex> guard(constantsLock);
+    for (auto it = constants.begin(); it != constants.end();) {
+        it = (it->second.use_count() == 1) ? constants.erase(it) : std::next(it);
+    }
+}
+
+/**
+ * @details Copies each row of the box one tile at a time: rows of stored tiles are copied, constant tiles are
+ * filled with their pixel.
+ * @author Zhikang Dong
+ */
+void SparseVolume::gather(int x0, int x1, int y0, int y1, int z0, int z1, unsigned char* dst) const {
+    const int pb = pixel_bytes();
+    const size_t span = static_cast<size_t>(x1 - x0) * pb;
+    for (int z = z0; z < z1; ++z) {
+        for (int y = y0; y < y1; ++y) {
+            unsigned char* out = dst + (static_cast<size_t>(z - z0) * (y1 - y0) + (y - y0)) * span;
+            for (int tx = x0 / size; tx * size < x1; ++tx) {
+                const int xs = std::max(x0, tx * size), xe = std::min(x1, (tx + 1) * size);
+                const SparseTile& t = *tile(tx, y / size, z / size);
+                unsigned char* to = out + static_cast<size_t>(xs - x0) * pb;
+                if (t.constant) {
+                    fill_pixels(to, t.bytes.data(), xe - xs, pb);
+                    continue;
+                }
+                int ex, ey, ez;
+                tile_extent(tx, y / size, z / size, ex, ey, ez);
+                const size_t at = (static_cast<size_t>(z % size) * ey + y % size) * ex + (xs - tx * size);
+                std::memcpy(to, t.bytes.data() + at * pb, static_cast<size_t>(xe - xs) * pb);
+            }
+        }
+    }
+}
+
+size_t SparseVolume::stored_tiles() const {
+    size_t stored = 0;
+    for (const auto& t : tiles) stored += t->constant ? 0 : 1;
+    return stored;
+}
+
+/**
+ * @details Counts the directory, every stored tile and each distinct constant tile once.
+ * @author Zhikang Dong
+ */
+size_t SparseVolume::resident_bytes() const {
+    size_t bytes = tiles.size() * sizeof(std::shared_ptr<const SparseTile>);
+    std::vector<const SparseTile*> shared;
+    for (const auto& t : tiles) {
+        if (t->constant) {
+            shared.push_back(t.get());
+        } else {
+            bytes += sizeof(SparseTile) + t->bytes.size();
+        }
+    }
+    std::sort(shared.begin(), shared.end());
+    shared.erase(std::unique(shared.begin(), shared.end()), shared.end());
+    for (const SparseTile* t : shared) bytes += sizeof(SparseTile) + t->bytes.size();
+    return bytes;
+}
+
+size_t SparseVolume::dense_bytes() const {
+    return static_cast<size_t>(w) * h * d * pixel_bytes();
+}
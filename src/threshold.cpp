@@ -0,0 +1,180 @@
+/**
+* @file threshold.cpp
+* @brief this file contains the implementation of the automatic global and local adaptive threshold selection.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cmath>
+#include "threshold.h"
+#include "parallel.h"
+
+/**
+ * @details Sweeps the candidate thresholds once, keeping the running weight and sum of the lower class.
+ * @author Zhikang Dong
+ */
+int Threshold::otsu(const std::array<uint64_t, 256>& histogram) {
+    double total = 0, sumAll = 0;
+    for (int i = 0; i < 256; ++i) {
+        total += static_cast<double>(histogram[i]);
+        sumAll += static_cast<double>(i) * static_cast<double>(histogram[i]);
+    }
+    if (total == 0) return 0;
+
+    double weightLow = 0, sumLow = 0, best = -1;
+    int threshold = 0;
+    for (int t = 0; t < 256; ++t) {
+        weightLow += static_cast<double>(histogram[t]);
+        if (weightLow == 0) continue;
+        double weightHigh = total - weightLow;
+        if (weightHigh == 0) break;
+
+        sumLow += static_cast<double>(t) * static_cast<double>(histogram[t]);
+        double meanLow = sumLow / weightLow;
+        double meanHigh = (sumAll - sumLow) / weightHigh;
+        double between = weightLow * weightHigh * (meanLow - meanHigh) * (meanLow - meanHigh);
+        if (between > best) {
+            best = between;
+            threshold = t;
+        }
+    }
+    return threshold;
+}
+
+/**
+ * @details Draws a line from the peak to the far end of the longer tail and picks the bin furthest below it.
+ * The histogram is mirrored when the longer tail is on the right, so the search always runs leftwards.
+ * @author Zhikang Dong
+ */
+int Threshold::triangle(const std::array<uint64_t, 256>& histogram) {
+    int left = 0, right = 255, peak = 0;
+    while (left < 256 && histogram[left] == 0) ++left;
+    if (left == 256) return 0;
+    while (histogram[right] == 0) --right;
+    for (int i = 0; i < 256; ++i) {
+        if (histogram[i] > histogram[peak]) peak = i;
+    }
+    if (left > 0) --left;
+    if (right < 255) ++right;
+
+    std::array<double, 256> h;
+    for (int i = 0; i < 256; ++i) {
+        h[i] = static_cast<double>(histogram[i]);
+    }
+    bool flip = (peak - left) < (right - peak);
+    if (flip) {
+        std::reverse(h.begin(), h.end());
+        left = 255 - right;
+        peak = 255 - peak;
+    }
+
+    // Distance to the line through (left, 0) and (peak, h[peak]), up to a constant factor
+    int threshold = left;
+    double a = h[peak], b = left - peak, best = 0;
+    for (int i = left + 1; i <= peak; ++i) {
+        double distance = a * i + b * h[i];
+        if (distance > best) {
+            best = distance;
+            threshold = i;
+        }
+    }
+    threshold--;
+
+    if (flip) threshold = 255 - threshold;
+    return std::clamp(threshold, 0, 255);
+}
+
+/**
+ * @details Dispatches to the requested method.
+ * @author Zhikang Dong
+ */
+int Threshold::global(const std::array<uint64_t, 256>& histogram, GlobalThreshold method) {
+    return method == GlobalThreshold::Triangle ? triangle(histogram) : otsu(histogram);
+}
+
+/**
+ * @details Builds the prefix sums of every row in parallel, then adds the rows downwards with the
+ * columns split across the threads, so both passes stream through memory.
+ * @author Zhikang Dong
+ */
+std::vector<uint64_t> Threshold::integral(const unsigned char* src, int w, int h, bool squares) {
+    const size_t stride = static_cast<size_t>(w) + 1;
+    std::vector<uint64_t> table(stride * (h + 1), 0);
+
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            const unsigned char* row = src + static_cast<size_t>(y) * w;
+            uint64_t* out = table.data() + (y + 1) * stride;
+            uint64_t running = 0;
+            for (int x = 0; x < w; ++x) {
+                uint64_t v = row[x];
+                running += squares ? v * v : v;
+                out[x + 1] = running;
+            }
+        }
+    }, 16);
+
+    Parallel::for_range(1, w + 1, [&](int x0, int x1) {
+        for (int y = 2; y <= h; ++y) {
+            const uint64_t* above = table.data() + (y - 1) * stride;
+            uint64_t* out = table.data() + y * stride;
+            for (int x = x0; x < x1; ++x) {
+                out[x] += above[x];
+            }
+        }
+    }, 256);
+    return table;
+}
+
+/**
+ * @details Each output row is computed in parallel from the summed area tables; windows are clipped at the border,
+ * so the mean is always over real pixels. Each pixel is read just before its own output is written, so dst may alias src.
+ * @author Zhikang Dong
+ */
+void Threshold::adaptive(const unsigned char* src, unsigned char* dst, int w, int h,
+                         int windowSize, double k, AdaptiveThreshold method) {
+    if (w <= 0 || h <= 0) return;
+    const int radius = std::max(windowSize, 1) / 2;
+    const size_t stride = static_cast<size_t>(w) + 1;
+    const bool sauvola = method == AdaptiveThreshold::Sauvola;
+
+    std::vector<uint64_t> sums = integral(src, w, h, false);
+    std::vector<uint64_t> squares;
+    if (sauvola) squares = integral(src, w, h, true);
+
+    Parallel::for_range(0, h, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            const int top = std::max(y - radius, 0);
+            const int bottom = std::min(y + radius, h - 1) + 1;
+            const uint64_t* rowTop = sums.data() + top * stride;
+            const uint64_t* rowBottom = sums.data() + bottom * stride;
+            const uint64_t* sqTop = sauvola ? squares.data() + top * stride : nullptr;
+            const uint64_t* sqBottom = sauvola ? squares.data() + bottom * stride : nullptr;
+
+            for (int x = 0; x < w; ++x) {
+                const int left = std::max(x - radius, 0);
+                const int right = std::min(x + radius, w - 1) + 1;
+                const double count = static_cast<double>((right - left) * (bottom - top));
+                const double sum = static_cast<double>(rowBottom[right] - rowTop[right] - rowBottom[left] + rowTop[left]);
+                const double pixel = src[static_cast<size_t>(y) * w + x];
+
+                bool foreground;
+                if (sauvola) {
+                    const double sq = static_cast<double>(sqBottom[right] - sqTop[right] - sqBottom[left] + sqTop[left]);
+                    const double mean = sum / count;
+                    const double deviation = std::sqrt(std::max(sq / count - mean * mean, 0.0));
+                    foreground = pixel > mean * (1.0 + k * (deviation / 128.0 - 1.0));
+                } else {
+                    foreground = pixel * count > sum * (1.0 - k);
+                }
+                dst[static_cast<size_t>(y) * w + x] = foreground ? 255 : 0;
+            }
+        }
+    }, 16);
+}
@@ -113,9 +113,12 @@ int Utility::adjust_kernel_size(int kernelSize) {
 
 /**
  * @details This function allows the user to choose between median blur, box blur, and Gaussian blur.
+ * The blur is queued on the pipeline rather than applied straight away, so that a chain of local filters
+ * runs tile by tile without full-size intermediates.
  * @author Georgia Ray
+ * @author Zhikang Dong
  */
-void Utility::apply_blur(Image& img) {
+void Utility::apply_blur(Pipeline& pipeline) {
     //initiate a loop so the user can select their blur method, and if they enter an invalid option, they can try again
     while (true) {
         //ask the user to choose between median, box, and gaussian blur
@@ -135,11 +138,11 @@ void Utility::apply_blur(Image& img) {
         switch (blurOption) {
             case 1: // Median Blur
                 kernelSize = get_kernel_size();
-                Filter::median_blur(img, kernelSize);
+                pipeline.median_blur(kernelSize);
                 return;
             case 2: // Box Blur
                 kernelSize = get_kernel_size();
-                Filter::box_blur(img, kernelSize);
+                pipeline.box_blur(kernelSize);
                 return;
             case 3: // Gaussian Blur
                 kernelSize = get_kernel_size();
@@ -163,7 +166,7 @@ void Utility::apply_blur(Image& img) {
                     continue;
                 }
                 }
-                Filter::gaussian_blur_2d(img, kernelSize, sigma);
+                pipeline.gaussian_blur(kernelSize, sigma);
                 return;
             default:
                 //if the user enters an invalid option, they are asked to try again
@@ -222,8 +225,9 @@ void Utility::apply_salt_and_pepper(Image& img) {
 }
 
 /**
- * @details This function helps the user apply thresholding to the image, allowing them to choose between RGB to HSL or HSV transformations.
+ * @details This function helps the user apply thresholding to the image, allowing them to choose a manual, automatic (Otsu, triangle) or adaptive (Bradley, Sauvola) threshold and between RGB to HSL or HSV transformations.
  * @author Georgia Ray
+ * @author Zhikang Dong
  */
 void Utility::apply_thresholding(Image& img) {
     /*
@@ -237,92 +241,154 @@ void Utility::apply_thresholding(Image& img) {
     void
     */
 
-    //ask the user to enter a threshold value
-    std::cout << "Enter the threshold value (0 to 255): ";
-    int threshold;
-
-    //enter a loop so the user can enter a valid threshold value, and if they enter an invalid value, they can try again
-    while(true) {
-        std::cin >> threshold;
-        if (std::cin.fail() || threshold < 0 || threshold > 255) {
-            //if the user enters an invalid value, they are asked to try again
-            try_again("Invalid threshold value. Please enter a value between 0 and 255.\n");
+    //ask the user how the threshold should be chosen
+    int mode;
+    while (true) {
+        std::cout << "Choose a thresholding method:\n";
+        std::cout << "1) Manual threshold\n";
+        std::cout << "2) Otsu (automatic)\n";
+        std::cout << "3) Triangle (automatic)\n";
+        std::cout << "4) Bradley (adaptive)\n";
+        std::cout << "5) Sauvola (adaptive)\n";
+        std::cout << "Thresholding method: ";
+        std::cin >> mode;
+        if (std::cin.fail() || mode < 1 || mode > 5) {
+            try_again("Invalid thresholding method. Please enter a number between 1 and 5.\n");
             continue;
         }
         break;
     }
 
+    int threshold = 0;
+    if (mode == 1) {
+        //ask the user to enter a threshold value
+        std::cout << "Enter the threshold value (0 to 255): ";
+
+        //enter a loop so the user can enter a valid threshold value, and if they enter an invalid value, they can try again
+        while(true) {
+            std::cin >> threshold;
+            if (std::cin.fail() || threshold < 0 || threshold > 255) {
+                //if the user enters an invalid value, they are asked to try again
+                try_again("Invalid threshold value. Please enter a value between 0 and 255.\n");
+                continue;
+            }
+            break;
+        }
+    }
+
+    int windowSize = 0;
+    if (mode >= 4) {
+        //adaptive methods compare each pixel with its neighbourhood, so ask for the window size
+        std::cout << "Enter the window size (odd, at least 3): ";
+        while (true) {
+            std::cin >> windowSize;
+            if (std::cin.fail() || windowSize < 3 || windowSize % 2 == 0) {
+                try_again("Invalid window size. Please enter an odd number of at least 3.\n");
+                continue;
+            }
+            break;
+        }
+    }
+
     //check how many channels the image has, and if it is a grayscale image, apply the filter with a placeholder value of 1
     int channels = img.channels();
     //case to handle grayscale images
-    if (channels == 1) {
-        //will not use transform for grayscale images, so 1 is just placeholder for function call
-        Filter::Tresholding(img, threshold, 1);
-        return;
-    }
-
-    //if not grayscale, ask the user to choose between HSL and HSV
-    std::cout << "Choose whether you want to transform RGB to HSL or HSV:\n";
-    std::cout << "1) RGB to HSV\n";
-    std::cout << "2) RGB to HSL\n";
-    std::cout << "Transformation option: ";
-
-    //enter a loop so the user can enter a valid transformation value, and if they enter an invalid value, they can try again
-    int transform;
-    while(true) {
-        std::cin >> transform;
-        if (std::cin.fail() || transform != 1 && transform != 2) {
-            //if the user enters an invalid value, they are asked to try again
-            try_again("Invalid transformation option. Please enter 1 or 2: ");
-            continue;
+    int transform = 1; //will not use transform for grayscale images, so 1 is just placeholder for function call
+    if (channels != 1) {
+        //if not grayscale, ask the user to choose between HSL and HSV
+        std::cout << "Choose whether you want to transform RGB to HSL or HSV:\n";
+        std::cout << "1) RGB to HSV\n";
+        std::cout << "2) RGB to HSL\n";
+        std::cout << "Transformation option: ";
+
+        //enter a loop so the user can enter a valid transformation value, and if they enter an invalid value, they can try again
+        while(true) {
+            std::cin >> transform;
+            if (std::cin.fail() || transform != 1 && transform != 2) {
+                //if the user enters an invalid value, they are asked to try again
+                try_again("Invalid transformation option. Please enter 1 or 2: ");
+                continue;
+            }
+            break;
         }
-        break;
     }
+
     //apply the filter with the valid inputs
-    Filter::Tresholding(img, threshold, transform);
+    switch (mode) {
+        case 1:
+            Filter::Tresholding(img, threshold, transform);
+            break;
+        case 2:
+            threshold = Filter::automatic_thresholding(img, GlobalThreshold::Otsu, transform);
+            std::cout << "Otsu threshold: " << threshold << std::endl;
+            break;
+        case 3:
+            threshold = Filter::automatic_thresholding(img, GlobalThreshold::Triangle, transform);
+            std::cout << "Triangle threshold: " << threshold << std::endl;
+            break;
+        case 4:
+            Filter::adaptive_thresholding(img, AdaptiveThreshold::Bradley, windowSize, 0.15, transform);
+            break;
+        case 5:
+            Filter::adaptive_thresholding(img, AdaptiveThreshold::Sauvola, windowSize, 0.2, transform);
+            break;
+    }
 }
 
 /**
- * @details This function helps the user apply histogram equalization to the image, allowing them to choose between RGB to HSL or HSV transformations.
+ * @details This function helps the user apply histogram equalization to the image, allowing them to choose between global equalization and CLAHE, and between RGB to HSL or HSV transformations.
  * @author Georgia Ray
+ * @author Zhikang Dong
  */
 void Utility::apply_histogram(Image& img) {
-    int channels = img.channels();
-    //case to handle grayscale images
-    if (channels == 1) {
-        //will not use transform for grayscale images, so 1 is just placeholder for function call
-        Filter::HistogramEqualization(img, 1);
-        return;
-    }
-
-    //if not grayscale, ask the user to choose between HSL and HSV
-    std::cout << "Choose whether you want to transform RGB to HSL or HSV:\n";
-    std::cout << "1) RGB to HSV\n";
-    std::cout << "2) RGB to HSL\n";
-    std::cout << "Transformation option: ";
-
-    //enter a loop so the user can enter a valid transformation value, and if they enter an invalid value, they can try again
-    int transform;
-    while(true) {
-        std::cin >> transform;
-        if (std::cin.fail() || transform != 1 && transform != 2) {
-            //if the user enters an invalid value, they are asked to try again
-            try_again("Invalid transformation option. Please enter 1 or 2: ");
+    //ask the user whether to equalize the whole image at once or tile by tile
+    int method;
+    while (true) {
+        std::cout << "Choose an equalization method:\n";
+        std::cout << "1) Global histogram equalization\n";
+        std::cout << "2) CLAHE (contrast limited, tile by tile)\n";
+        std::cout << "Equalization method: ";
+        std::cin >> method;
+        if (std::cin.fail() || (method != 1 && method != 2)) {
+            try_again("Invalid equalization method. Please enter 1 or 2.\n");
             continue;
         }
         break;
     }
+
+    int channels = img.channels();
+    //case to handle grayscale images
+    int transform = 1; //will not use transform for grayscale images, so 1 is just placeholder for function call
+    if (channels != 1) {
+        //if not grayscale, ask the user to choose between HSL and HSV
+        std::cout << "Choose whether you want to transform RGB to HSL or HSV:\n";
+        std::cout << "1) RGB to HSV\n";
+        std::cout << "2) RGB to HSL\n";
+        std::cout << "Transformation option: ";
+
+        //enter a loop so the user can enter a valid transformation value, and if they enter an invalid value, they can try again
+        while(true) {
+            std::cin >> transform;
+            if (std::cin.fail() || transform != 1 && transform != 2) {
+                //if the user enters an invalid value, they are asked to try again
+                try_again("Invalid transformation option. Please enter 1 or 2: ");
+                continue;
+            }
+            break;
+        }
+    }
     //apply the filter with the valid inputs
-    Filter::HistogramEqualization(img, transform);
+    if (method == 1) Filter::HistogramEqualization(img, transform);
+    else Filter::clahe(img, 8, 2.0, transform);
 }
 
 /**
  * @details This function helps the user apply edge detection to the image, allowing them to choose between Sobel, Prewitt, Scharr, and Roberts edge detection methods.
  * @author Georgia Ray
  */
-void Utility::apply_edge_detection(Image& img) {
+void Utility::apply_edge_detection(Image& img, Pipeline& pipeline) {
     // First convert image to grayscale
-    Filter::RGB2Gray(img);
+    pipeline.gray();
     int edgeDetectionOption;
 
     //enter a loop so the user can select their edge detection method, and if they enter an invalid option, they can try again
@@ -332,6 +398,7 @@ void Utility::apply_edge_detection(Image& img) {
         std::cout << "2) Prewitt\n";
         std::cout << "3) Scharr\n";
         std::cout << "4) Roberts\n";
+        std::cout << "5) Canny\n";
         std::cout << "Edge detection method: ";
 
         std::cin >> edgeDetectionOption;
@@ -339,20 +406,38 @@ void Utility::apply_edge_detection(Image& img) {
         //switch statement to handle the user's input
         switch (edgeDetectionOption) {
             case 1: // Sobel
-                Filter::apply_sobel_edge_detection(img);
+                pipeline.edge_detection(GradientOperator::Sobel);
                 return;
             case 2: // Prewitt
-                Filter::apply_prewitt_edge_detection(img);
+                pipeline.edge_detection(GradientOperator::Prewitt);
                 return;
             case 3: // Scharr
-                Filter::apply_scharr_edge_detection(img);
+                pipeline.edge_detection(GradientOperator::Scharr);
                 return;
             case 4: // Roberts
+                pipeline.run(img);
                 Filter::apply_roberts_edge_detection(img);
                 return;
+            case 5: { // Canny
+                int low, high;
+                //enter a loop so the user can enter valid thresholds, and if they enter invalid values, they can try again
+                while (true) {
+                    std::cout << "Enter the low and high thresholds (e.g. 50 150): ";
+                    std::cin >> low >> high;
+                    if (std::cin.fail() || low < 0 || high < low) {
+                        try_again("Invalid thresholds. Please enter two values with 0 <= low <= high.\n");
+                        continue;
+                    }
+                    break;
+                }
+                // Hysteresis follows edges across the whole image, so it cannot run tile by tile
+                pipeline.run(img);
+                Filter::apply_canny_edge_detection(img, low, high);
+                return;
+            }
             default:
                 //if the user enters an invalid option, they are asked to try again
-                try_again("Invalid edge detection method selected. Please enter a number between 1 and 4.\n");
+                try_again("Invalid edge detection method selected. Please enter a number between 1 and 5.\n");
                 continue;
         }
     }
@@ -423,6 +508,7 @@ int Utility::get_projection_type(double& sigma) {
     std::cout << "1) Gaussian\n";
     std::cout << "2) Median\n";
     std::cout << "3) None\n";
+    std::cout << "4) CLAHE (contrast enhancement)\n";
     std::cout << "Filter method: ";
     std::cin >> filter_option;
 
@@ -447,9 +533,9 @@ int Utility::get_projection_type(double& sigma) {
             }
         }
     }
-    else if (std::cin.fail() || filter_option < 1 || filter_option > 3) {
+    else if (std::cin.fail() || filter_option < 1 || filter_option > 4) {
         //if the user enters an invalid option, they are asked to try again
-        try_again("Invalid filter method selected. Please enter 1, 2, or 3.\n");
+        try_again("Invalid filter method selected. Please enter 1, 2, 3, or 4.\n");
         continue;
     }
     break;
@@ -495,8 +581,8 @@ int Utility::get_kernel_size() {
  * @author Shengzhi Tian
  */
 Volume Utility::slab_or_whole(std::string volPath) {
-    // Making a whole volume object before beginning, so I can access its total size
-    std::vector<fs::directory_entry> entries = Volume::getFileEntries(volPath);
+    // Index the directory before beginning, so I can access its total size; the volume reuses the same index
+    std::shared_ptr<const DirectoryIndex> entries = DirectoryIndex::open(volPath);
     //Enter a loop so the user can select whether they want to work with the whole volume or a slab
     while (true) {
         std::cout << "Would you like to work with the whole volume or a slab?\n";
@@ -508,15 +594,17 @@ Volume Utility::slab_or_whole(std::string volPath) {
         std::cin >> slab_or_whole;
 
         if (slab_or_whole == 1) {
-            // Create a volume object with the whole volume
-            Volume vol(volPath);
+            // Create a volume object with the whole volume; slices are decoded when an operation first needs them
+            LoadOptions options;
+            options.lazy = true;
+            Volume vol(volPath, options);
             return vol; // Return the whole volume
         }
 
             //if the user wants to work with a slab, ask them for the start and end values
         else if (slab_or_whole == 2) {
             // Get the total number of images in the volume, specifying the possible range of start and end values
-            int maxZ = entries.size();
+            int maxZ = entries->size();
             int start, end;
 
             // Ask the user for the start value and enter a loop so the user can enter a valid start value if incorrect the first time
@@ -555,7 +643,9 @@ Volume Utility::slab_or_whole(std::string volPath) {
             }
 
             // Create a volume object with the specified start and end values
-            Volume vol(volPath, start, end);
+            LoadOptions options;
+            options.lazy = true;
+            Volume vol(volPath, start, end, options);
             return vol;
         }
         else {
@@ -578,7 +668,7 @@ bool Utility::checkZValidity(int z1, int z2, int minZ, int maxZ) {
  * @details This function allows the user to take a slice of the volume and returns the slice as an image. The user can choose between XZ and YZ slices, and specify the slice number.
  * @author Georgia Ray
  */
-Image Utility::take_a_slice(Volume vol) {
+Image Utility::take_a_slice(const Volume& vol) {
     //ask the user what kind of slice they want to take, either xz or yz
     int sliceType;
     //enter a loop so the user can select their slice type, and if they enter an invalid option, they can try again
@@ -602,19 +692,16 @@ Image Utility::take_a_slice(Volume vol) {
     int max;
     SliceType type;
 
-    //this will be used to get the max value for the slice
-    std::vector<Image> images = vol.getImages();
-
-    //if the user wants an XZ slice
+    //if the user wants an XZ slice (the size comes from the headers, so a lazy volume is not decoded here)
     if (sliceType == 1) {
         SliceType type = SliceType::XZ;
-        max = images[0].height();
+        max = vol.height();
     }
 
         //if the user wants a YZ slice
     else {
         SliceType type = SliceType::YZ;
-        max = images[0].width();
+        max = vol.width();
     }
 
     //ask the user for the slice number they wish to use
@@ -673,6 +760,9 @@ Image Utility::twoDImageProcessing(std::string imagePath) {
     //load the image using the path (either passed in, default, or user input)
     Image img(imagePath);
 
+    //local filters are queued here and run tile by tile, just before a filter that needs the whole image
+    Pipeline pending;
+
     //setting some global variables for use later
     std::string outputPath;
     int count = 0;
@@ -706,48 +796,53 @@ Image Utility::twoDImageProcessing(std::string imagePath) {
         //switch statement to handle the user's input
         switch (option) {
             case 1: {
+                pending.run(img);
                 apply_brightness(img);
                 count++;
                 failed = false;
                 break;
             }
             case 2: {
-                apply_blur(img);
+                apply_blur(pending);
                 count++;
                 failed = false;
                 break;
             }
             case 3: { // Salt and Pepper
+                pending.run(img);
                 apply_salt_and_pepper(img);
                 count++;
                 failed = false;
                 break;
             }
             case 4: { // Grayscale
-                Filter::RGB2Gray(img);
+                pending.gray();
                 count++;
                 failed = false;
                 break;
             }
             case 5: { // Histogram Equalization
+                pending.run(img);
                 apply_histogram(img);
                 count++;
                 failed = false;
                 break;
             }
             case 6: { // Thresholding
+                pending.run(img);
                 apply_thresholding(img);
                 count++;
                 failed = false;
                 break;
             }
             case 7: { // Edge Detection
-                apply_edge_detection(img);
+                apply_edge_detection(img, pending);
                 count++;
                 failed = false;
                 break;
             }
             case 8: { // Save and Exit
+                pending.run(img);
                 exitProgram = true;
                 break;
             }
@@ -876,10 +971,5 @@ Image Utility::threeDImageProcessing() {
         to_save.save(outputPath);
         to_save = Utility::twoDImageProcessing(outputPath);
     }
-    for (auto img_v : vol.getImages())
-    {
-        stbi_image_free(img_v.get_data());
-    }
-
     return to_save;
 }
\ No newline at end of file
@@ -11,43 +11,78 @@
 */
 
 #include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <stdexcept>
 #include "volume.h"
+#include "dirindex.h"
+#include "parallel.h"
+#include "largebuffer.h"
+#include "slicecodec.h"
+
+/**
+ * @brief Gets the sample type a file decodes to without a window, from its header in the directory index.
+ */
+static PixelType file_pixel_type(const IndexEntry& entry) {
+    return entry.is16Bit ? PixelType::UInt16 : entry.isHdr ? PixelType::Float32 : PixelType::UInt8;
+}
+
+/**
+ * @brief Throws if the images among the index entries [first, last) do not all decode to one sample type, as
+ * the typed kernels read every slice of a volume as the type of the first.
+ */
+static void require_one_pixel_type(const std::vector<IndexEntry>& entries, size_t first, size_t last) {
+    const IndexEntry* reference = nullptr;
+    for (size_t i = first; i < last; ++i) {
+        if (!entries[i].image) continue;
+        if (reference == nullptr) {
+            reference = &entries[i];
+        } else if (file_pixel_type(entries[i]) != file_pixel_type(*reference)) {
+            throw std::runtime_error("All slices of a volume must have the same bit depth, but " +
+                                     entries[i].path.string() + " differs from " + reference->path.string() + ".");
+        }
+    }
+}
 
 /**
  * @details Constructs a Volume object from the images in the specified directory.
  * The images are loaded in sorted order based on filenames.
  * @author Shengzhi Tian
  */
-Volume::Volume(const std::string& directoryPath, int desiredChannels) {
+Volume::Volume(const std::string& directoryPath, int desiredChannels)
+    : Volume(directoryPath, LoadOptions::with_channels(desiredChannels)) {
+}
+
+/**
+ * @details Constructs a Volume object from the images in the specified directory, applying load options.
+ * The images are loaded in sorted order based on filenames.
+ * @author Shengzhi Tian
+ * @author Zhikang Dong
+ */
+Volume::Volume(const std::string& directoryPath, const LoadOptions& options) {
     try {
         // Ensure the path exists and is a directory
         if (fs::exists(directoryPath) && fs::is_directory(directoryPath)) {
-            std::vector<fs::directory_entry> entries;
-
-            // Iterate over directory contents and store them in a vector
-            for (const auto& entry : fs::directory_iterator(directoryPath)) {
-                entries.push_back(entry);
+            // The files in natural order, listed once and shared with any slab of the same directory
+            std::shared_ptr<const DirectoryIndex> index = DirectoryIndex::open(directoryPath);
+            const std::vector<IndexEntry>& entries = index->entries();
+            if (options.lazy || options.compressed) {
+                openLazy(index, 0, entries.size(), options);
+                return;
             }
 
-            // Sort the entries based on filenames
-            sortFilenames(entries);
-
-            // Load images in sorted order
-            int i = 0;
-            for (const auto& entry : entries) {
-                // Check if the entry is a file
-                if (entry.is_regular_file()) {
-                    // Load the image
-                    try {
-                        Image img(entry.path().string(), desiredChannels);
-                        images.push_back(img); // Move img into the vector
-                    }
-                    catch (const std::exception& e) {
-                        std::cerr << "Failed to load image " << entry.path() << ": " << e.what() << std::endl;
-                    }
+            // Load images in parallel, then keep them in sorted order
+            std::vector<LoadedEntry> loaded = loadEntries(entries, 0, entries.size(), options);
+            for (size_t i = 0; i < loaded.size(); ++i) {
+                if (loaded[i].loaded) {
+                    images.push_back(loaded[i].image);
                 }
-                i++;
-                std::cout << i << " number loaded" << std::endl;
+                else if (!loaded[i].error.empty()) {
+                    std::cerr << "Failed to load image " << entries[i].path << ": " << loaded[i].error << std::endl;
+                }
+                std::cout << i + 1 << " number loaded" << std::endl;
             }
         }
         else {
@@ -63,15 +98,129 @@ Volume::Volume(const std::string& directoryPath, int desiredChannels) {
 }
 
 /**
- * @details Finds all the files names in the specified directory and returns them in a vector.
+ * @details Decoding dominates loading, so every entry is decoded on its own thread from the pool; results are
+ * stored by index so the caller can keep the sorted order and report failures in order.
+ * @author Zhikang Dong
+ */
+void Volume::decodeEntries(const std::vector<IndexEntry>& entries, size_t first,
+                           const LoadOptions& options, std::vector<LoadedEntry>& loaded,
+                           const std::vector<bool>& done) {
+    Parallel::for_range(0, static_cast<int>(loaded.size()), [&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            const auto& entry = entries[first + i];
+            if (!done.empty() && done[i]) continue;
+            try {
+                loaded[i].image = Image(entry.path.string(), options);
+                loaded[i].loaded = true;
+            }
+            catch (const std::exception& e) {
+                loaded[i].error = e.what();
+            }
+        }
+    });
+}
+
+/**
+ * @details Without an automatic window every entry is decoded with the options as given. An automatic window
+ * must be the same for every slice, so evenly spaced sample slices are decoded first at full precision, the
+ * window is resolved from their combined histogram, the remaining slices are decoded through it and the
+ * samples are mapped last.
+ * @author Zhikang Dong
+ */
+std::vector<Volume::LoadedEntry> Volume::loadEntries(const std::vector<IndexEntry>& entries,
+                                                     size_t first, size_t last, const LoadOptions& options) {
+    require_one_pixel_type(entries, first, last);
+    std::vector<LoadedEntry> loaded(last - first);
+    if (!options.window || !options.window->automatic() || loaded.empty()) {
+        decodeEntries(entries, first, options, loaded, {});
+        matchChannels(entries, first, loaded);
+        return loaded;
+    }
+
+    // Decode the sample slices without the window
+    const size_t count = loaded.size();
+    const size_t step = std::max<size_t>(1, (count + WINDOW_SAMPLES - 1) / WINDOW_SAMPLES);
+    std::vector<bool> sampled(count, true);
+    for (size_t i = 0; i < count; i += step) sampled[i] = false;
+    LoadOptions raw = options;
+    raw.window.reset();
+    decodeEntries(entries, first, raw, loaded, sampled);
+
+    // Resolve one window for the whole volume from the samples' histogram
+    std::vector<uint64_t> histogram;
+    PixelType type = PixelType::UInt8;
+    for (size_t i = 0; i < count; i += step) {
+        if (!loaded[i].loaded) continue;
+        Window::accumulate(loaded[i].image, histogram);
+        type = loaded[i].image.pixel_type();
+    }
+    LoadOptions fixed = options;
+    fixed.window = Window::resolve(*options.window, histogram, type);
+
+    // Decode the rest through the window, then map the samples
+    for (size_t i = 0; i < count; ++i) sampled[i] = !sampled[i];
+    decodeEntries(entries, first, fixed, loaded, sampled);
+    for (size_t i = 0; i < count; i += step) {
+        if (!loaded[i].loaded) continue;
+        Image windowed = Window::apply(loaded[i].image, *fixed.window);
+        stbi_image_free(loaded[i].image.get_data());
+        loaded[i].image = windowed;
+    }
+    matchChannels(entries, first, loaded);
+    return loaded;
+}
+
+/**
+ * @details Slices collapse independently while decoding, so a stack with a few colour slices could end up
+ * with mixed channel counts; those slices are expanded again. This is a no-op when nothing was collapsed. A
+ * slice that cannot be expanded (a gray and alpha slice in an RGB stack, say) fails the whole load rather
+ * than being dropped, since a missing slice would shift the z spacing of every slice after it.
+ * @author Zhikang Dong
+ */
+void Volume::matchChannels(const std::vector<IndexEntry>& entries, size_t first, std::vector<LoadedEntry>& loaded) {
+    int channels = 0;
+    for (const LoadedEntry& entry : loaded) {
+        if (entry.loaded) channels = std::max(channels, entry.image.channels());
+    }
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        LoadedEntry& entry = loaded[i];
+        if (!entry.loaded || entry.image.channels() == channels) continue;
+        try {
+            entry.image.expand_gray(channels);
+        }
+        catch (const std::exception& e) {
+            const std::string message = "Slice " + entries[first + i].path.string() + " has " +
+                                        std::to_string(entry.image.channels()) + " channels and cannot be matched to " +
+                                        std::to_string(channels) + ": " + e.what();
+            for (LoadedEntry& other : loaded) {
+                if (other.loaded) stbi_image_free(other.image.get_data());
+                other.loaded = false;
+            }
+            throw std::runtime_error(message);
+        }
+    }
+}
+
+/**
+ * @details Merges the cached statistics of every slice; a lazy volume is streamed rather than fully loaded.
+ * @author Zhikang Dong
+ */
+ImageStatistics Volume::statistics() const {
+    ImageStatistics stats;
+    for (int z = 0; z < depth(); ++z) {
+        Histogram::merge(stats, at(z)->statistics());
+    }
+    return stats;
+}
+
+/**
+ * @details Finds all the files in the specified directory and returns them in natural order.
  * @author Shengzhi Tian
  */
 std::vector<fs::directory_entry> Volume::getFileEntries(const std::string& directoryPath) {
     std::vector<fs::directory_entry> entries;
-    // Ensure the path exists and is a directory
-        // Iterate over directory contents and store them in a vector
-    for (const auto& entry : fs::directory_iterator(directoryPath)) {
-        entries.push_back(entry);
+    for (const IndexEntry& file : DirectoryIndex::open(directoryPath)->entries()) {
+        entries.emplace_back(file.path);
     }
     return entries;
 }
@@ -81,38 +230,45 @@ std::vector<fs::directory_entry> Volume::getFileEntries(const std::string& direc
  * The images are loaded in sorted order based on filenames.
  * @author Yunting Tao
  */
-Volume::Volume(const std::string& directoryPath, int z1, int z2, int desiredChannels) {
+Volume::Volume(const std::string& directoryPath, int z1, int z2, int desiredChannels)
+    : Volume(directoryPath, z1, z2, LoadOptions::with_channels(desiredChannels)) {
+}
+
+/**
+ * @details Constructs a slab of Volume object from the images within the specified range in the directory,
+ * applying load options.
+ * @author Yunting Tao
+ * @author Zhikang Dong
+ */
+Volume::Volume(const std::string& directoryPath, int z1, int z2, const LoadOptions& options) {
     try {
         // Ensure the path exists and is a directory
         if (fs::exists(directoryPath) && fs::is_directory(directoryPath)) {
-            std::vector<fs::directory_entry> entries;
-
-            entries = getFileEntries(directoryPath);
-
-            // Sort the entries based on filenames
-            sortFilenames(entries);
+            // The cached index of the directory, so a slab does not list and sort it again
+            std::shared_ptr<const DirectoryIndex> index = DirectoryIndex::open(directoryPath);
+            const std::vector<IndexEntry>& entries = index->entries();
 
             // Ensure that z1 and z2 are within the range of image indices
             if (z1 < 1 || z1 > entries.size() || z2 < 1 || z2 > entries.size() || z1 >z2) {
                 throw std::invalid_argument("Invalid z range");
             }
+            if (options.lazy || options.compressed) {
+                openLazy(index, z1 - 1, z2, options);
+                return;
+            }
 
-            // Load images in sorted order
-            int i = 0;
-            for (int i = z1 - 1; i < z2 && i <= entries.size(); ++i) {
+            // Load images in parallel, then keep them in sorted order
+            std::vector<LoadedEntry> loaded = loadEntries(entries, z1 - 1, z2, options);
+            for (int i = z1 - 1; i < z2; ++i) {
                 const auto& entry = entries[i];
-                // Check if the entry is a file
-                if (entry.is_regular_file()) {
-                    // Load the image
-                    try {
-                        Image img(entry.path().string(), desiredChannels);
-                        images.push_back(img); // Move img into the vector
-                    }
-                    catch (const std::exception& e) {
-                        std::cerr << "Failed to load image " << entry.path() << ": " << e.what() << std::endl;
-                    }
+                const LoadedEntry& result = loaded[i - (z1 - 1)];
+                if (result.loaded) {
+                    images.push_back(result.image);
+                }
+                else if (!result.error.empty()) {
+                    std::cerr << "Failed to load image " << entry.path << ": " << result.error << std::endl;
                 }
-                std::cout << i << " number loaded" << entry.path() << std::endl;
+                std::cout << i << " number loaded" << entry.path << std::endl;
             }
         }
         else {
@@ -128,6 +284,9 @@ Volume::Volume(const std::string& directoryPath, int z1, int z2, int desiredChan
 }
 
 
+Volume::Volume(std::vector<Image> slices) : images(std::move(slices)) {
+}
+
 Volume::~Volume()
 {
     for (auto img : images)
@@ -137,39 +296,73 @@ Volume::~Volume()
     
 }
 
+Volume::Volume(Volume&& other) noexcept {
+    *this = std::move(other);
+}
+
+/**
+ * @details The other volume's lazy state is taken under its lock, so it cannot be loaded halfway through the move.
+ * @author Zhikang Dong
+ */
+Volume& Volume::operator=(Volume&& other) noexcept {
+    if (this == &other) return *this;
+    for (auto img : images) {
+        stbi_image_free(img.get_data());
+    }
+    std::scoped_lock guard(pyramidLock, other.pyramidLock, lazyLock, other.lazyLock);
+    images = std::move(other.images);
+    other.images.clear();
+    lazySlices = std::move(other.lazySlices);
+    pyramid = std::move(other.pyramid);
+    pyramidLevels = other.pyramidLevels;
+    pyramidFilter = other.pyramidFilter;
+    pyramidRevisions = std::move(other.pyramidRevisions);
+    brickGrid = std::move(other.brickGrid);
+    return *this;
+}
+
 
 /**
  * @details Retrieves the images in the volume.
  * @author Yunting Tao
  */
-std::vector<Image> Volume::getImages() const {
+std::vector<Image> Volume::getImages() {
+    materialise();
     return images;
 }
 
 /**
  * @details Saves the volume to the specified directory.
- * The images are saved as PNG files with filenames image0.png, image1.png, etc.
- * The images are saved in the order they were loaded.
+ * The images are saved as PNG files with filenames image0.png, image1.png, etc., or with the given prefix.
+ * The images are encoded in parallel, one slice per task, and a summary is printed once they are all written.
  * If the directory does not exist, an error message is printed to the console.
  * If an image fails to save, an error message is printed to the console.
  * @author Shengzhi Tian
  */
-void Volume::save(const std::string& directoryPath) {
+void Volume::save(const std::string& directoryPath, const std::string& prefix) {
     try {
         // Ensure the path exists and is a directory
         if (fs::exists(directoryPath) && fs::is_directory(directoryPath)) {
-            // Iterate over images
-            for (size_t i = 0; i < images.size(); ++i) {
-                // Construct the file path
-                std::string filePath = directoryPath + "/image" + std::to_string(i) + ".png";
-                // Save the image
-                try {
-                    images[i].save(filePath);
-                }
-                catch (const std::exception& e) {
-                    std::cerr << "Failed to save image " << i << ": " << e.what() << std::endl;
+            // Slices are fetched through at(), so a lazy volume only holds the ones being encoded
+            std::mutex reportLock;
+            int saved = 0;
+            Parallel::for_range(0, depth(), [&](int z0, int z1) {
+                for (int i = z0; i < z1; ++i) {
+                    // Construct the file path
+                    std::string filePath = directoryPath + "/" + prefix + std::to_string(i) + ".png";
+                    // Save the image
+                    try {
+                        at(i)->save(filePath, false);
+                        std::lock_guard<std::mutex> guard(reportLock);
+                        ++saved;
+                    }
+                    catch (const std::exception& e) {
+                        std::lock_guard<std::mutex> guard(reportLock);
+                        std::cerr << "Failed to save image " << i << ": " << e.what() << std::endl;
+                    }
                 }
-            }
+            }, 1);
+            std::cout << "Saved " << saved << " images to " << directoryPath << std::endl;
         }
         else {
             std::cerr << "Directory does not exist or is not a directory: " << directoryPath << std::endl;
@@ -184,56 +377,372 @@ void Volume::save(const std::string& directoryPath) {
 }
 
 /**
- * @brief Swaps the values of two variables.
- * @tparam T The type of the variables to swap.
- * @param a The first variable.
- * @param b The second variable.
+ * @brief The decode-on-demand state of a lazy volume.
+ * @details alive[z] tracks the decoded pixels of slice z for as long as anyone holds them, so a slice evicted
+ * from the LRU list but still in use is shared rather than decoded twice; slotLocks[z] guards it and makes
+ * concurrent requests for the same slice decode it once. held, order and position form the LRU list of the
+ * slices the volume itself keeps, guarded by lock.
+ */
+struct Volume::LazySlices {
+    std::vector<fs::path> paths;                     /**< The file of each slice. */
+    LoadOptions options;                             /**< The decode options, with any automatic window resolved. */
+    size_t limit = 0;                                /**< The most slices held, or 0 for no limit. */
+    int w = 0, h = 0, c = 0;                         /**< The size of every slice, from the headers. */
+    PixelType type = PixelType::UInt8;               /**< The sample type of every slice. */
+    std::unique_ptr<std::mutex[]> slotLocks;         /**< One lock per slice. */
+    std::vector<std::weak_ptr<Image>> alive;         /**< The decoded slices still in use anywhere. */
+    std::mutex lock;                                 /**< Guards held, order and position. */
+    std::vector<std::shared_ptr<Image>> held;        /**< The slices kept by the volume. */
+    std::list<int> order;                            /**< The held slices, most recently used first. */
+    std::vector<std::list<int>::iterator> position;  /**< The place of each held slice in order. */
+    std::vector<std::vector<unsigned char>> packed;  /**< The compressed slices, or empty to read the files. */
+};
+
+/**
+ * @details Takes the geometry from the headers in the directory index and skips entries stb cannot read. An
+ * automatic window is resolved up front from WINDOW_SAMPLES slices, so every slice decoded later gets the same
+ * mapping.
+ * @author Zhikang Dong
+ */
+void Volume::openLazy(const std::shared_ptr<const DirectoryIndex>& index, size_t first, size_t last,
+                      const LoadOptions& options) {
+    require_one_pixel_type(index->entries(), first, last);
+    auto state = std::make_shared<LazySlices>();
+    state->options = options;
+    state->options.collapseGray = false;
+    state->limit = (options.compressed && options.maxResident == 0) ? COMPRESSED_RESIDENT : options.maxResident;
+
+    for (size_t i = first; i < last; ++i) {
+        const IndexEntry& entry = (*index)[i];
+        if (!entry.image) {
+            std::cerr << "Failed to read the header of " << entry.path << std::endl;
+            continue;
+        }
+        if (state->paths.empty()) {
+            state->w = entry.width;
+            state->h = entry.height;
+            state->c = options.desiredChannels ? options.desiredChannels : entry.channels;
+            state->type = options.window ? PixelType::UInt8 : file_pixel_type(entry);
+        }
+        state->paths.push_back(entry.path);
+    }
+
+    const size_t count = state->paths.size();
+    if (options.window && options.window->automatic() && count > 0) {
+        const size_t step = std::max<size_t>(1, (count + WINDOW_SAMPLES - 1) / WINDOW_SAMPLES);
+        LoadOptions raw = options;
+        raw.window.reset();
+        std::vector<uint64_t> histogram;
+        PixelType type = PixelType::UInt8;
+        for (size_t i = 0; i < count; i += step) {
+            Image sample(state->paths[i].string(), raw);
+            Window::accumulate(sample, histogram);
+            type = sample.pixel_type();
+            stbi_image_free(sample.get_data());
+        }
+        state->options.window = Window::resolve(*options.window, histogram, type);
+    }
+
+    if (options.compressed) {
+        // Each slice is decoded and packed by one thread, so only one decoded slice per thread is alive
+        std::vector<std::vector<unsigned char>> packed(count);
+        Parallel::for_range(0, static_cast<int>(count), [&](int z0, int z1) {
+            for (int z = z0; z < z1; ++z) {
+                Image decoded = decodeSlice(*state, z);
+                packed[z] = SliceCodec::encode(decoded);
+#ifndef NDEBUG
+                // Debug builds check that every slice comes back byte for byte
+                const size_t bytes = static_cast<size_t>(state->w) * state->h * state->c * decoded.bytes_per_sample();
+                Image check(LargeBuffer::allocate(state->h, bytes / state->h), state->w, state->h, state->c, state->type);
+                SliceCodec::decode(packed[z], check);
+                assert(std::memcmp(check.get_data(), decoded.get_data(), bytes) == 0 && "SliceCodec must be lossless");
+                stbi_image_free(check.get_data());
+#endif
+                stbi_image_free(decoded.get_data());
+            }
+        }, 1);
+        state->packed = std::move(packed);
+    }
+
+    state->slotLocks = std::make_unique<std::mutex[]>(count);
+    state->alive.resize(count);
+    state->held.resize(count);
+    state->position.resize(count);
+    std::lock_guard<std::mutex> guard(lazyLock);
+    lazySlices = state;
+}
+
+/**
+ * @details The slice is decoded under its own lock only, so different slices decode in parallel; the LRU
+ * list is updated afterwards under the shared lock, evicting from the back past the limit.
+ * @author Zhikang Dong
  */
-template <typename T>
-void custom_swap(T& a, T& b) {
-    T temp = a;
-    a = b;
-    b = temp;
+std::shared_ptr<Image> Volume::at(int z) const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    if (!state) {
+        return std::make_shared<Image>(images[z]);
+    }
+
+    std::shared_ptr<Image> img;
+    {
+        std::lock_guard<std::mutex> guard(state->slotLocks[z]);
+        img = state->alive[z].lock();
+        if (!img) {
+            Image decoded = decodeSlice(*state, z);
+            img = std::shared_ptr<Image>(new Image(decoded), [](Image* owned) {
+                stbi_image_free(owned->get_data());
+                delete owned;
+            });
+            state->alive[z] = img;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(state->lock);
+    if (state->held[z]) {
+        state->order.splice(state->order.begin(), state->order, state->position[z]);
+    } else {
+        state->order.push_front(z);
+        state->position[z] = state->order.begin();
+        state->held[z] = img;
+        while (state->limit > 0 && state->order.size() > state->limit) {
+            state->held[state->order.back()].reset();
+            state->order.pop_back();
+        }
+    }
+    return img;
 }
 
 /**
- * @details Helper function that partitions the directory entries for quicksort.
- * This function is used by the quicksort function to sort the directory entries based on filenames.
- * @author Shengzhi Tian
+ * @details A compressed slice is unpacked into a new buffer; otherwise the file is decoded and checked against
+ * the size and sample type taken from the headers, as the typed filters index the pixels by them.
+ * @author Zhikang Dong
  */
-size_t Volume::partition(std::vector<fs::directory_entry>& entries, size_t low, size_t high) {
-    std::string pivot = entries[high].path().filename().string();
-    size_t i = low - 1;
-    for (size_t j = low; j < high; ++j) {
-        if (entries[j].path().filename().string() < pivot) {
-            ++i;
-            custom_swap(entries[i], entries[j]);
+Image Volume::decodeSlice(const LazySlices& state, int z) {
+    if (!state.packed.empty()) {
+        const size_t row = static_cast<size_t>(state.w) * state.c * Image::bytes_per_sample(state.type);
+        Image img(LargeBuffer::allocate(state.h, row), state.w, state.h, state.c, state.type);
+        SliceCodec::decode(state.packed[z], img);
+        return img;
+    }
+    Image decoded(state.paths[z].string(), state.options);
+    if (decoded.width() != state.w || decoded.height() != state.h || decoded.channels() != state.c ||
+        decoded.pixel_type() != state.type) {
+        stbi_image_free(decoded.get_data());
+        throw std::runtime_error("Slice " + state.paths[z].string() + " does not match the volume size or bit depth.");
+    }
+    return decoded;
+}
+
+/**
+ * @details Slices still in use are copied so the volume owns its buffers; the rest are decoded in parallel.
+ * The images are in place before the lazy state is dropped under lazyLock, so a concurrent at() sees either
+ * the lazy state or the finished images.
+ * @author Zhikang Dong
+ */
+void Volume::materialise() {
+    std::shared_ptr<LazySlices> state = lazyState();
+    if (!state) return;
+    if (!state->packed.empty()) {
+        throw std::runtime_error("A compressed volume is not loaded whole; filter a copy() of it, or load it "
+                                 "without LoadOptions::compressed.");
+    }
+
+    std::vector<Image> loaded(state->paths.size());
+    Parallel::for_range(0, static_cast<int>(loaded.size()), [&](int z0, int z1) {
+        for (int z = z0; z < z1; ++z) {
+            std::shared_ptr<Image> img;
+            {
+                std::lock_guard<std::mutex> guard(state->slotLocks[z]);
+                img = state->alive[z].lock();
+            }
+            if (img) {
+                const size_t row = static_cast<size_t>(img->width()) * img->channels() * img->bytes_per_sample();
+                unsigned char* copy = LargeBuffer::allocate(img->height(), row);
+                std::memcpy(copy, img->get_data(), row * img->height());
+                loaded[z] = Image(copy, img->width(), img->height(), img->channels(), img->pixel_type());
+            } else {
+                loaded[z] = decodeSlice(*state, z);
+            }
+        }
+    }, 1);
+    {
+        std::lock_guard<std::mutex> guard(lazyLock);
+        if (lazySlices != state) {
+            // Another call loaded the volume meanwhile
+            for (Image& img : loaded) stbi_image_free(img.get_data());
+            return;
         }
+        images = std::move(loaded);
+        lazySlices.reset();
     }
-    custom_swap(entries[i + 1], entries[high]);
-    return i + 1;
+    // The pixels are unchanged, so the pyramid stays valid for the new images
+    std::lock_guard<std::mutex> guard(pyramidLock);
+    if (!pyramid.empty()) pyramidRevisions = sliceRevisions();
 }
 
 /**
- * @details Helper function that sorts the filenames of directory entries.
- * This function implements the quicksort algorithm to sort the directory entries based on filenames.
- * @author Shengzhi Tian
+ * @details The slices are copied in parallel, each from the volume's own buffer or, if lazy, from at().
+ * @author Zhikang Dong
  */
-void Volume::quicksort(std::vector<fs::directory_entry>& entries, size_t low, size_t high) {
-    if (low < high) {
-        size_t pi = partition(entries, low, high);
-        if (pi > 0) {
-            quicksort(entries, low, pi - 1);
+Volume Volume::copy() const {
+    std::vector<Image> slices(depth());
+    Parallel::for_range(0, static_cast<int>(slices.size()), [&](int z0, int z1) {
+        for (int z = z0; z < z1; ++z) {
+            std::shared_ptr<Image> img = at(z);
+            const size_t row = static_cast<size_t>(img->width()) * img->channels() * img->bytes_per_sample();
+            unsigned char* data = LargeBuffer::copy(img->get_data(), img->height(), row);
+            slices[z] = Image(data, img->width(), img->height(), img->channels(), img->pixel_type());
         }
-        quicksort(entries, pi + 1, high);
+    }, 1);
+    return Volume(std::move(slices));
+}
+
+std::shared_ptr<Volume::LazySlices> Volume::lazyState() const {
+    std::lock_guard<std::mutex> guard(lazyLock);
+    return lazySlices;
+}
+
+int Volume::depth() const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    return state ? static_cast<int>(state->paths.size()) : static_cast<int>(images.size());
+}
+
+int Volume::width() const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    return state ? state->w : (images.empty() ? 0 : images[0].width());
+}
+
+int Volume::height() const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    return state ? state->h : (images.empty() ? 0 : images[0].height());
+}
+
+int Volume::channels() const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    return state ? state->c : (images.empty() ? 0 : images[0].channels());
+}
+
+PixelType Volume::pixel_type() const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    return state ? state->type : (images.empty() ? PixelType::UInt8 : images[0].pixel_type());
+}
+
+size_t Volume::compressed_bytes() const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    if (!state) return 0;
+    size_t bytes = 0;
+    for (const auto& slice : state->packed) bytes += slice.size();
+    return bytes;
+}
+
+bool Volume::lazy() const {
+    return lazyState() != nullptr;
+}
+
+size_t Volume::resident_limit() const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    return state ? state->limit : 0;
+}
+
+size_t Volume::resident() const {
+    std::shared_ptr<LazySlices> state = lazyState();
+    if (!state) return images.size();
+    std::lock_guard<std::mutex> guard(state->lock);
+    return state->order.size();
+}
+
+/**
+ * @details Each level is made from the one before it, so the cost of the whole pyramid is about a seventh
+ * of one pass over the volume. Building stops early once every axis has reached 1.
+ * @author Zhikang Dong
+ */
+void Volume::build_pyramid(int levels, PyramidFilter filter) {
+    if (levels < 0) {
+        throw std::invalid_argument("The number of pyramid levels cannot be negative");
     }
+    std::lock_guard<std::mutex> guard(pyramidLock);
+    pyramidLevels = levels;
+    pyramidFilter = filter;
+    buildLevels();
+}
+
+void Volume::buildLevels() {
+    pyramid.clear();
+    pyramidRevisions = sliceRevisions();
+    const Volume* source = this;
+    while (source->depth() > 0 && (pyramidLevels == 0 || static_cast<int>(pyramid.size()) < pyramidLevels)) {
+        const bool single = source->width() <= 1 && source->height() <= 1;
+        if (single && (pyramidLevels == 0 || source->depth() <= 1)) break;
+        pyramid.push_back(std::shared_ptr<Volume>(new Volume(Pyramid::downsample(*source, pyramidFilter))));
+        source = pyramid.back().get();
+    }
+}
+
+std::vector<uint64_t> Volume::sliceRevisions() const {
+    if (lazy()) return std::vector<uint64_t>(depth(), 0);
+    std::vector<uint64_t> revisions(images.size());
+    for (size_t z = 0; z < images.size(); ++z) revisions[z] = images[z].revision();
+    return revisions;
 }
 
 /**
- * @details Helper function that sorts the filenames of directory entries.
- * @author Shengzhi Tian
+ * @details The slices keep their size, so the same levels are made again and each is moved into the Volume
+ * already handed out for it.
+ * @author Zhikang Dong
  */
-void Volume::sortFilenames(std::vector<fs::directory_entry>& entries) {
-    quicksort(entries, 0, entries.size() - 1);
+void Volume::refreshLevels() const {
+    pyramidRevisions = sliceRevisions();
+    const Volume* source = this;
+    for (const std::shared_ptr<Volume>& next : pyramid) {
+        *next = Volume(Pyramid::downsample(*source, pyramidFilter));
+        source = next.get();
+    }
 }
 
+void Volume::clear_pyramid() {
+    std::lock_guard<std::mutex> guard(pyramidLock);
+    pyramid.clear();
+    pyramidRevisions.clear();
+}
+
+int Volume::levels() const {
+    std::lock_guard<std::mutex> guard(pyramidLock);
+    return 1 + static_cast<int>(pyramid.size());
+}
+
+Volume& Volume::level(int k) {
+    return const_cast<Volume&>(static_cast<const Volume&>(*this).level(k));
+}
+
+/**
+ * @details The 3D filters mark the slices they change, so a pyramid made before filtering the volume in place
+ * is rebuilt here rather than going on showing the unfiltered slices. The check and the rebuild are one step
+ * under pyramidLock, so threads asking for a level at once rebuild it only once.
+ * @author Zhikang Dong
+ */
+const Volume& Volume::level(int k) const {
+    if (k == 0) return *this;
+    std::lock_guard<std::mutex> guard(pyramidLock);
+    if (k < 0 || k > static_cast<int>(pyramid.size())) {
+        throw std::out_of_range("Pyramid level " + std::to_string(k) + " has not been built");
+    }
+    if (sliceRevisions() != pyramidRevisions) refreshLevels();
+    return *pyramid[k - 1];
+}
+
+void Volume::build_bricks(int size) {
+    brickGrid = std::make_shared<BrickGrid>(*this, size);
+}
+
+void Volume::clear_bricks() {
+    brickGrid.reset();
+}
+
+/**
+ * @details The 3D filters mark the slices they change, so the grid catches up here on the next use.
+ * @author Zhikang Dong
+ */
+const BrickGrid* Volume::bricks() const {
+    if (brickGrid) brickGrid->update(*this);
+    return brickGrid.get();
+}
@@ -0,0 +1,162 @@
+/**
+* @file window.cpp
+* @brief this file contains the implementation of the window/level mapping of 16-bit and float images down to 8-bit.
+* @author Shengzhi Tian (edsml-st1123)
+* @author Berat Yildizgorer (asce-by1123)
+* @author Georgia Ray (edsml-ger23)
+* @author Zhikang Dong (acse-zd1420)
+* @author Yunting Tao (acse-yt2323)
+* @author Chuhan Li (edsml-ll423)
+* @date 19/03/2024
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <type_traits>
+#include "window.h"
+#include "Image.h"
+#include "largebuffer.h"
+#include "parallel.h"
+
+/**
+ * @brief Maps v through the window [low, high] onto [0, 255], rounding to the nearest value.
+ */
+static unsigned char window_value(double v, double low, double high) {
+    const double t = (high > low) ? (v - low) / (high - low) : (v >= high ? 1.0 : 0.0);
+    return static_cast<unsigned char>(std::round(std::clamp(t, 0.0, 1.0) * 255.0));
+}
+
+/**
+ * @brief Whether channel c of an nc channel image is alpha, which is rescaled rather than windowed.
+ */
+static bool is_alpha(int c, int nc) {
+    return (nc == 2 || nc == 4) && c == nc - 1;
+}
+
+WindowLevel WindowLevel::manual(double center, double width) {
+    WindowLevel window;
+    window.center = center;
+    window.width = width;
+    return window;
+}
+
+WindowLevel WindowLevel::percentile(double low, double high) {
+    WindowLevel window;
+    window.lowPercentile = low;
+    window.highPercentile = high;
+    return window;
+}
+
+/**
+ * @details Each thread counts its rows into a private histogram, merged under a lock at the end.
+ * @author Zhikang Dong
+ */
+void Window::accumulate(const Image& img, std::vector<uint64_t>& histogram) {
+    histogram.resize(BINS, 0);
+    const int w = img.width(), nc = img.channels();
+    std::mutex lock;
+    visit_pixel_type(img.pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        const T* data = img.pixels<T>();
+        Parallel::for_range(0, img.height(), [&](int y0, int y1) {
+            std::vector<uint64_t> local(BINS, 0);
+            for (size_t i = static_cast<size_t>(y0) * w * nc; i < static_cast<size_t>(y1) * w * nc; ++i) {
+                if (is_alpha(static_cast<int>(i % nc), nc)) continue;
+                if constexpr (std::is_floating_point_v<T>) {
+                    local[static_cast<int>(std::round(std::clamp(static_cast<double>(data[i]), 0.0, 1.0) * (BINS - 1)))]++;
+                } else {
+                    local[data[i]]++;
+                }
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            for (int b = 0; b < BINS; ++b) histogram[b] += local[b];
+        }, 64);
+    });
+}
+
+/**
+ * @details The window spans the first bins at which the cumulative count reaches each percentile.
+ * @author Zhikang Dong
+ */
+WindowLevel Window::resolve(const WindowLevel& window, const std::vector<uint64_t>& histogram, PixelType type) {
+    if (!window.automatic()) return window;
+
+    uint64_t total = 0;
+    for (uint64_t count : histogram) total += count;
+    const double full = (type == PixelType::Float32) ? 1.0 : (type == PixelType::UInt16 ? 65535.0 : 255.0);
+    if (total == 0) return WindowLevel::manual(0.5 * full, full);
+
+    auto bin_at = [&](double percentile) {
+        const double target = std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(total);
+        uint64_t sum = 0;
+        for (size_t b = 0; b < histogram.size(); ++b) {
+            sum += histogram[b];
+            if (static_cast<double>(sum) >= target && sum > 0) return static_cast<double>(b);
+        }
+        return static_cast<double>(histogram.size() - 1);
+    };
+    // A flat image still gets a window one bin wide, as a width of 0 would mean automatic
+    double low = bin_at(window.lowPercentile), high = std::max(bin_at(window.highPercentile), low + 1.0);
+    if (type == PixelType::Float32) {
+        low /= BINS - 1;
+        high /= BINS - 1;
+    }
+    return WindowLevel::manual(0.5 * (low + high), high - low);
+}
+
+/**
+ * @details Entry v holds the window applied to sample value v.
+ * @author Zhikang Dong
+ */
+std::vector<unsigned char> Window::lut(const WindowLevel& window, PixelType type) {
+    const int size = (type == PixelType::UInt16) ? BINS : 256;
+    const double low = window.center - 0.5 * window.width, high = window.center + 0.5 * window.width;
+    std::vector<unsigned char> table(size);
+    for (int v = 0; v < size; ++v) {
+        table[v] = window_value(v, low, high);
+    }
+    return table;
+}
+
+/**
+ * @details Integer samples are mapped through lut(); the alpha channel keeps its full range.
+ * @author Zhikang Dong
+ */
+Image Window::apply(const Image& img, const WindowLevel& window) {
+    WindowLevel resolved = window;
+    if (window.automatic()) {
+        std::vector<uint64_t> histogram;
+        accumulate(img, histogram);
+        resolved = resolve(window, histogram, img.pixel_type());
+    }
+
+    const int w = img.width(), h = img.height(), nc = img.channels();
+    const size_t row = static_cast<size_t>(w) * nc;
+    unsigned char* out = LargeBuffer::allocate(h, row);
+    visit_pixel_type(img.pixel_type(), [&](auto sample) {
+        using T = decltype(sample);
+        const T* data = img.pixels<T>();
+        if constexpr (std::is_floating_point_v<T>) {
+            const double low = resolved.center - 0.5 * resolved.width, high = resolved.center + 0.5 * resolved.width;
+            Parallel::for_range(0, h, [&](int y0, int y1) {
+                for (size_t i = y0 * row; i < y1 * row; ++i) {
+                    out[i] = is_alpha(static_cast<int>(i % nc), nc) ? window_value(data[i], 0.0, 1.0)
+                                                                    : window_value(data[i], low, high);
+                }
+            }, 16);
+        } else {
+            const std::vector<unsigned char> table = lut(resolved, img.pixel_type());
+            const std::vector<unsigned char> alpha = lut(WindowLevel::manual(0.5 * PixelTraits<T>::max,
+                                                                             PixelTraits<T>::max), img.pixel_type());
+            const bool hasAlpha = (nc == 2 || nc == 4);
+            Parallel::for_range(0, h, [&](int y0, int y1) {
+                for (size_t i = y0 * row; i < y1 * row; ++i) out[i] = table[data[i]];
+                if (hasAlpha) {
+                    for (size_t i = y0 * row + nc - 1; i < y1 * row; i += nc) out[i] = alpha[data[i]];
+                }
+            }, 16);
+        }
+    });
+    return {out, w, h, nc};
+}